@@ -0,0 +1,287 @@
+/* session arena:size class pools with per class free lists */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "arena.h"
+
+/* pools grow by slabs of at least this size */
+#define ARENA_SLAB_SIZE (64 * 1024)
+
+#define ARENA_MAGIC 0x61726e61
+#define ARENA_LARGE ARENA_CLASSES
+
+/* in front of every buffer,keeps the payload 16 bytes aligned */
+struct arena_hdr {
+	uint32_t cls;
+	uint32_t magic;
+	uint64_t size;		/* large buffers only */
+};
+
+struct arena_slab {
+	struct arena_slab *next;
+	uint64_t pad;
+};
+
+struct arena_pool {
+	pthread_mutex_t lock;
+	void *free;		/* free items,linked through the payload */
+	struct arena_slab *slabs;
+	struct arena_class_stats st;
+};
+
+static struct arena_pool pools[ARENA_CLASSES];
+static pthread_once_t pools_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t large_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t large_allocs;
+static uint64_t reserved;
+
+static void arena_init(void)
+{
+	int i;
+	for(i = 0;i < ARENA_CLASSES;i++){
+		pthread_mutex_init(&pools[i].lock,NULL);
+		pools[i].st.size = 1u << (i + ARENA_MIN_SHIFT);
+	}
+}
+
+static int arena_class(size_t size)
+{
+	int cls = 0;
+	while(cls < ARENA_CLASSES && ((size_t)1 << (cls + ARENA_MIN_SHIFT)) < size)
+		cls++;
+	return cls;
+}
+
+/* pool locked:carve a new slab into free items */
+static int arena_grow(struct arena_pool *p, int cls)
+{
+	size_t stride = sizeof(struct arena_hdr) + p->st.size;
+	size_t n = ARENA_SLAB_SIZE / stride;
+	size_t i;
+	struct arena_slab *s;
+	char *item;
+
+	if(n == 0)
+		n = 1;
+	s = malloc(sizeof(struct arena_slab) + n * stride);
+	if(s == NULL)
+		return -1;
+	s->next = p->slabs;
+	p->slabs = s;
+	p->st.mallocs++;
+	__atomic_add_fetch(&reserved,sizeof(struct arena_slab) + n * stride,__ATOMIC_RELAXED);
+
+	item = (char *)(s + 1);
+	for(i = 0;i < n;i++,item += stride){
+		struct arena_hdr *h = (struct arena_hdr *)item;
+		h->cls = cls;
+		h->magic = ARENA_MAGIC;
+		h->size = 0;
+		*(void **)(h + 1) = p->free;
+		p->free = h + 1;
+	}
+	return 0;
+}
+
+void *arena_alloc(size_t size)
+{
+	struct arena_pool *p;
+	struct arena_hdr *h;
+	void *r;
+	int cls;
+
+	pthread_once(&pools_once,arena_init);
+	cls = arena_class(size);
+	if(cls == ARENA_LARGE){
+		h = malloc(sizeof(struct arena_hdr) + size);
+		if(h == NULL)
+			return NULL;
+		h->cls = ARENA_LARGE;
+		h->magic = ARENA_MAGIC;
+		h->size = size;
+		pthread_mutex_lock(&large_lock);
+		large_allocs++;
+		pthread_mutex_unlock(&large_lock);
+		return h + 1;
+	}
+
+	p = &pools[cls];
+	pthread_mutex_lock(&p->lock);
+	if(p->free == NULL && arena_grow(p,cls) != 0){
+		pthread_mutex_unlock(&p->lock);
+		return NULL;
+	}
+	r = p->free;
+	p->free = *(void **)r;
+	p->st.allocs++;
+	if(++p->st.in_use > p->st.peak)
+		p->st.peak = p->st.in_use;
+	pthread_mutex_unlock(&p->lock);
+	return r;
+}
+
+void *arena_calloc(size_t n, size_t size)
+{
+	void *r;
+
+	if(size && n > SIZE_MAX / size)
+		return NULL;
+	r = arena_alloc(n * size);
+	if(r != NULL)
+		memset(r,0,n * size);
+	return r;
+}
+
+void arena_free(void *ptr)
+{
+	struct arena_hdr *h;
+	struct arena_pool *p;
+
+	if(ptr == NULL)
+		return;
+	h = (struct arena_hdr *)ptr - 1;
+	if(h->magic != ARENA_MAGIC){
+		fprintf(stderr,"arena_free:%p not from the arena\n",ptr);
+		abort();
+	}
+	if(h->cls == ARENA_LARGE){
+		free(h);
+		return;
+	}
+
+	p = &pools[h->cls];
+	pthread_mutex_lock(&p->lock);
+	*(void **)ptr = p->free;
+	p->free = ptr;
+	p->st.in_use--;
+	pthread_mutex_unlock(&p->lock);
+}
+
+void *arena_realloc(void *ptr, size_t size)
+{
+	struct arena_hdr *h;
+	size_t old;
+	void *r;
+
+	if(ptr == NULL)
+		return arena_alloc(size);
+	if(size == 0){
+		arena_free(ptr);
+		return NULL;
+	}
+
+	h = (struct arena_hdr *)ptr - 1;
+	if(h->cls == ARENA_LARGE){
+		if(arena_class(size) == ARENA_LARGE){
+			h = realloc(h,sizeof(struct arena_hdr) + size);
+			if(h == NULL)
+				return NULL;
+			h->size = size;
+			return h + 1;
+		}
+		old = h->size;
+	}
+	else {
+		old = pools[h->cls].st.size;
+		if(size <= old)
+			return ptr;
+	}
+
+	r = arena_alloc(size);
+	if(r == NULL)
+		return NULL;
+	memcpy(r,ptr,old < size ? old : size);
+	arena_free(ptr);
+	return r;
+}
+
+void arena_get_stats(struct arena_stats *st)
+{
+	int i;
+
+	pthread_once(&pools_once,arena_init);
+	for(i = 0;i < ARENA_CLASSES;i++){
+		pthread_mutex_lock(&pools[i].lock);
+		st->cls[i] = pools[i].st;
+		pthread_mutex_unlock(&pools[i].lock);
+	}
+	pthread_mutex_lock(&large_lock);
+	st->large_allocs = large_allocs;
+	pthread_mutex_unlock(&large_lock);
+	st->reserved = __atomic_load_n(&reserved,__ATOMIC_RELAXED);
+}
+
+void arena_print_stats(void)
+{
+	struct arena_stats st;
+	uint64_t allocs = 0,mallocs = 0;
+	int i;
+
+	arena_get_stats(&st);
+	for(i = 0;i < ARENA_CLASSES;i++){
+		allocs += st.cls[i].allocs;
+		mallocs += st.cls[i].mallocs;
+	}
+	fprintf(stderr,"arena:%llu allocations,%llu malloc calls(%llu KiB pooled),%llu large\n",
+		(unsigned long long)allocs,(unsigned long long)mallocs,
+		(unsigned long long)st.reserved / 1024,(unsigned long long)st.large_allocs);
+	fprintf(stderr,"  %8s %12s %8s %8s %8s\n","size","allocs","mallocs","in use","peak");
+	for(i = 0;i < ARENA_CLASSES;i++){
+		if(!st.cls[i].allocs)
+			continue;
+		fprintf(stderr,"  %8u %12llu %8llu %8u %8u\n",st.cls[i].size,
+			(unsigned long long)st.cls[i].allocs,
+			(unsigned long long)st.cls[i].mallocs,
+			st.cls[i].in_use,st.cls[i].peak);
+	}
+}
+
+int arena_fini(void)
+{
+	struct arena_slab *s;
+	int i,busy = 0;
+
+	pthread_once(&pools_once,arena_init);
+	for(i = 0;i < ARENA_CLASSES;i++){
+		pthread_mutex_lock(&pools[i].lock);
+		busy |= pools[i].st.in_use != 0;
+	}
+	/* a buffer still out would point into a freed slab */
+	for(i = 0;i < ARENA_CLASSES;i++){
+		while(!busy && (s = pools[i].slabs) != NULL){
+			pools[i].slabs = s->next;
+			free(s);
+		}
+		if(!busy)
+			pools[i].free = NULL;
+		pthread_mutex_unlock(&pools[i].lock);
+	}
+	if(busy)
+		return -1;
+	__atomic_store_n(&reserved,0,__ATOMIC_RELAXED);
+	return 0;
+}
+
+/* lwext4 allocations(CONFIG_USE_USER_MALLOC) */
+void *ext4_user_malloc(size_t size)
+{
+	return arena_alloc(size);
+}
+
+void *ext4_user_calloc(size_t n, size_t size)
+{
+	return arena_calloc(n,size);
+}
+
+void *ext4_user_realloc(void *ptr, size_t size)
+{
+	return arena_realloc(ptr,size);
+}
+
+void ext4_user_free(void *ptr)
+{
+	arena_free(ptr);
+}
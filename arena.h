@@ -0,0 +1,45 @@
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Session arena:fixed size pools(size classes,powers of two from 32 bytes
+ * to 1MB) for the buffers of the hot paths:usb escape/frame buffers,stream
+ * buffers and,through CONFIG_USE_USER_MALLOC,every lwext4 allocation(block
+ * cache blocks and descriptors included).A freed buffer goes back to its
+ * pool,so once the pools are warm a session does no malloc at all.
+ * Bigger requests are passed to malloc(and counted). */
+
+#define ARENA_MIN_SHIFT 5
+#define ARENA_MAX_SHIFT 20
+#define ARENA_CLASSES (ARENA_MAX_SHIFT - ARENA_MIN_SHIFT + 1)
+
+struct arena_class_stats {
+	uint32_t size;		/* item size */
+	uint64_t allocs;	/* buffers handed out */
+	uint64_t mallocs;	/* malloc calls to grow the pool */
+	uint32_t in_use;
+	uint32_t peak;
+};
+
+struct arena_stats {
+	struct arena_class_stats cls[ARENA_CLASSES];
+	uint64_t large_allocs;	/* bigger than the largest class */
+	uint64_t reserved;	/* bytes held by the pools */
+};
+
+void *arena_alloc(size_t size);
+void *arena_calloc(size_t n, size_t size);
+void *arena_realloc(void *p, size_t size);
+void arena_free(void *p);
+
+void arena_get_stats(struct arena_stats *st);
+/* to stderr:stdout may carry a tar archive or cat data */
+void arena_print_stats(void);
+
+/* end of session(syberusb_close):give the pooled memory back,the counts
+ * are kept.-1:a buffer is still in use,nothing freed */
+int arena_fini(void);
+
+#endif /* __ARENA_H */
@@ -0,0 +1,799 @@
+/* one session backup and restore of the partitions(syber_usb backup,
+ * syber_usb restore),see backup.h */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "main.h"
+#include "protocol.h"
+#include "stats.h"
+#include "backup.h"
+#include "frames.h"
+#include "ext4_types.h"
+#include "ext4_crc32.h"
+
+/* the usb thread reads chunks of windows,the host worker checksums and
+ * writes them,BACKUP_DEPTH chunks in between */
+#define BACKUP_CHUNK (SPRD_READ_WINDOW * 64)	//768k
+#define BACKUP_DEPTH 8
+#define BACKUP_BLOCK 4096			//zero blocks are left as holes
+
+struct backup_chunk {
+	uint8_t *buf;
+	uint32_t off;
+	uint32_t len;
+};
+
+struct backup_part {
+	const char *name;
+	uint32_t size;
+	int fd;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct backup_chunk ring[BACKUP_DEPTH];
+	int head,tail,cnt;
+	int done;		/* no more chunks */
+	int err;		/* worker:errno of a failed write */
+	/* worker results */
+	uint32_t crc;
+	uint32_t sum;
+	uint64_t zero;
+};
+
+static double backup_now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static int backup_is_zero(const uint8_t *p, size_t len)
+{
+	const uint64_t *q = (const uint64_t *)p;
+	size_t i;
+
+	for(i = 0;i < len / 8;i++)
+		if(q[i])
+			return 0;
+	return 1;
+}
+
+/* checksums,then the data blocks at their offset:zero blocks stay holes
+ * of the file sized up front */
+static int backup_chunk_write(struct backup_part *p, struct backup_chunk *c)
+{
+	uint32_t i,run,n;
+	uint32_t sum = 0;
+	ssize_t r;
+
+	p->crc = ext4_crc32c(p->crc,c->buf,c->len);
+	for(i = 0;i < c->len;i++)
+		sum += c->buf[i];
+	p->sum += sum;
+
+	STATS_T0(t_write);
+	for(i = 0;i < c->len;i = run){
+		n = c->len - i < BACKUP_BLOCK ? c->len - i : BACKUP_BLOCK;
+		if(n % 8 == 0 && backup_is_zero(c->buf + i,n)){
+			p->zero += n;
+			run = i + n;
+			continue;
+		}
+		/* a run of data blocks,one write */
+		for(run = i + n;run < c->len;run += n){
+			n = c->len - run < BACKUP_BLOCK ? c->len - run : BACKUP_BLOCK;
+			if(n % 8 == 0 && backup_is_zero(c->buf + run,n))
+				break;
+		}
+		r = pwrite(p->fd,c->buf + i,run - i,(off_t)c->off + i);
+		if(r != (ssize_t)(run - i))
+			return r == -1 ? errno : EIO;
+	}
+	STATS_ADD(STATS_FILE_WRITE,t_write,c->len);
+	return 0;
+}
+
+static void *backup_worker(void *arg)
+{
+	struct backup_part *p = arg;
+	struct backup_chunk *c;
+	int r;
+
+	for(;;){
+		pthread_mutex_lock(&p->lock);
+		while(p->cnt == 0 && !p->done)
+			pthread_cond_wait(&p->cond,&p->lock);
+		if(p->cnt == 0){
+			pthread_mutex_unlock(&p->lock);
+			break;
+		}
+		c = &p->ring[p->tail];
+		pthread_mutex_unlock(&p->lock);
+
+		r = p->err ? 0 : backup_chunk_write(p,c);
+
+		pthread_mutex_lock(&p->lock);
+		if(r != 0)
+			p->err = r;
+		p->tail = (p->tail + 1) % BACKUP_DEPTH;
+		p->cnt--;
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->lock);
+	}
+	return NULL;
+}
+
+static uint32_t backup_le32(const uint8_t *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* partition size from the ext4 superblock it holds,0 if none */
+static uint64_t backup_probe_ext4(const char *name, const uint8_t *sb)
+{
+	uint64_t blocks;
+	uint32_t log_bs,incompat;
+
+	sb += 1024;
+	if((sb[56] | sb[57] << 8) != 0xef53)
+		return 0;
+	log_bs = backup_le32(sb + 24);
+	incompat = backup_le32(sb + 96);
+	blocks = backup_le32(sb + 4);
+	if(incompat & 0x80)	//64bit
+		blocks |= (uint64_t)backup_le32(sb + 0x150) << 32;
+	if(log_bs > 6)
+		return 0;
+	sprd_log("%s:ext4,%llu blocks of %u Bytes\n",name,(unsigned long long)blocks,1024 << log_bs);
+	return blocks << (10 + log_bs);
+}
+
+/* FAT volume(internalsd,as sprd_read_camera mounts it with FatFs):total
+ * sectors x bytes per sector of the boot sector,without a boot sector at 0
+ * the end of the last primary partition of the MBR,0 if neither */
+static uint64_t backup_probe_fat(const char *name, const uint8_t *bs)
+{
+	uint64_t end = 0,e;
+	uint32_t bps,sectors;
+	int i;
+
+	if(bs[510] != 0x55 || bs[511] != 0xaa)
+		return 0;
+	bps = bs[11] | bs[12] << 8;
+	sectors = bs[19] | bs[20] << 8;
+	if(sectors == 0)
+		sectors = backup_le32(bs + 32);
+	if((bs[0] == 0xeb || bs[0] == 0xe9) && bps >= 512 && bps <= 4096 &&
+	   (bps & (bps - 1)) == 0 && sectors != 0){
+		sprd_log("%s:fat,%u sectors of %u Bytes\n",name,sectors,bps);
+		return (uint64_t)sectors * bps;
+	}
+	for(i = 0;i < 4;i++){
+		const uint8_t *pe = bs + 446 + i * 16;
+		if(pe[4] == 0)
+			continue;
+		e = (uint64_t)backup_le32(pe + 8) + backup_le32(pe + 12);
+		if(e > end)
+			end = e;
+	}
+	if(end)
+		sprd_log("%s:mbr,partitions end at sector %llu\n",name,(unsigned long long)end);
+	return end * 512;
+}
+
+/* size of an unsized partition(part_size 0) from the filesystem it holds */
+static uint64_t backup_probe(const char *name)
+{
+	uint8_t sb[2048];
+	uint64_t size;
+
+	if(sprd_read_flash(sb,sizeof(sb),0) != 0)
+		return 0;
+	size = backup_probe_ext4(name,sb);
+	if(size == 0)
+		size = backup_probe_fat(name,sb);
+	return size;
+}
+
+/* usb side:windows into free chunks,full chunks to the worker */
+static int backup_read(struct backup_part *p)
+{
+	struct backup_chunk *c;
+	uint32_t off = 0,len,w,i;
+	int r = 0;
+
+	while(off < p->size){
+		pthread_mutex_lock(&p->lock);
+		while(p->cnt == BACKUP_DEPTH && !p->err)
+			pthread_cond_wait(&p->cond,&p->lock);
+		r = p->err;
+		c = &p->ring[p->head];
+		pthread_mutex_unlock(&p->lock);
+		if(r != 0){
+			sprd_log("backup:write %s.img error:%d\n",p->name,r);
+			break;
+		}
+
+		len = p->size - off < BACKUP_CHUNK ? p->size - off : BACKUP_CHUNK;
+		for(i = 0;i < len;i += w){
+			w = len - i < SPRD_READ_WINDOW ? len - i : SPRD_READ_WINDOW;
+			r = sprd_read_flash(c->buf + i,w,off + i);
+			if(r != 0){
+				sprd_log("backup:%s read flash error:%d\n",p->name,r);
+				return r;
+			}
+		}
+		c->off = off;
+		c->len = len;
+		off += len;
+
+		pthread_mutex_lock(&p->lock);
+		p->head = (p->head + 1) % BACKUP_DEPTH;
+		p->cnt++;
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->lock);
+
+		if(sprd_progress(p->name,off,p->size) != 0){
+			sprd_log("backup:canceled\n");
+			return ECANCELED;
+		}
+	}
+	return r;
+}
+
+static int backup_part(const char *dir, const char *name, uint64_t size, FILE *manifest, uint64_t *total)
+{
+	struct backup_part p;
+	pthread_t th;
+	char path[PATH_MAX];
+	double t0,sec;
+	int i,r,r2;
+
+	r = sprd_read_start(name);
+	if(r != 0)
+		return r;
+	if(size == 0){
+		size = backup_probe(name);
+		if(size == 0){
+			sprd_log("backup:%s size unknown(no ext4 or fat found):give %s=size or exclude it with -%s\n",
+				name,name,name);
+			sprd_read_end();
+			return -1;
+		}
+	}
+	/* READ_FLASH_MIDST offsets are 32 bit */
+	if(size > UINT32_MAX - BACKUP_BLOCK + 1){
+		sprd_log("backup:%s is %llu Bytes,the first 4g only\n",name,(unsigned long long)size);
+		size = UINT32_MAX - BACKUP_BLOCK + 1;
+	}
+
+	memset(&p,0,sizeof(p));
+	p.name = name;
+	p.size = size;
+	p.crc = EXT4_CRC32_INIT;
+	snprintf(path,sizeof(path),"%s/%s.img",dir,name);
+	p.fd = open(path,O_CREAT|O_WRONLY|O_TRUNC,0666);
+	if(p.fd == -1){
+		sprd_log("backup:open or create %s error:%d\n",path,errno);
+		sprd_read_end();
+		return -1;
+	}
+	if(ftruncate(p.fd,p.size) != 0){
+		sprd_log("backup:%s size %u error:%d\n",path,p.size,errno);
+		close(p.fd);
+		sprd_read_end();
+		return -1;
+	}
+	for(i = 0;i < BACKUP_DEPTH;i++){
+		p.ring[i].buf = malloc(BACKUP_CHUNK);
+		if(p.ring[i].buf == NULL){
+			while(i--)
+				free(p.ring[i].buf);
+			close(p.fd);
+			sprd_read_end();
+			return ENOMEM;
+		}
+	}
+	pthread_mutex_init(&p.lock,NULL);
+	pthread_cond_init(&p.cond,NULL);
+
+	sprd_log("Saving partition:'%s'(size=0x%x) to '%s'\n",name,p.size,path);
+	t0 = backup_now();
+	r = pthread_create(&th,NULL,backup_worker,&p);
+	if(r == 0){
+		r = backup_read(&p);
+		pthread_mutex_lock(&p.lock);
+		p.done = 1;
+		pthread_cond_broadcast(&p.cond);
+		pthread_mutex_unlock(&p.lock);
+		pthread_join(th,NULL);
+		if(r == 0)
+			r = p.err;
+	}
+	sec = backup_now() - t0;
+	if(close(p.fd) != 0 && r == 0)
+		r = errno;
+	for(i = 0;i < BACKUP_DEPTH;i++)
+		free(p.ring[i].buf);
+	pthread_mutex_destroy(&p.lock);
+	pthread_cond_destroy(&p.cond);
+
+	r2 = sprd_read_end();
+	if(r == 0)
+		r = r2;
+	if(r != 0)
+		return r;
+	p.crc = ~p.crc;
+	sprd_log("%u Bytes in %.2fs(%.2f MB/s),%llu Bytes zero(holes),crc32c %08x\n",
+		p.size,sec,sec > 0 ? p.size / 1e6 / sec : 0.0,(unsigned long long)p.zero,p.crc);
+	fprintf(manifest,"%-14s %10u %08x %08x %s.img\n",name,p.size,p.crc,p.sum,name);
+	fflush(manifest);
+	*total += p.size;
+	return 0;
+}
+
+static int backup_known(const char *name)
+{
+	int i;
+
+	for(i = 0;part_table[i][0] != '\0';i++)
+		if(strcmp(name,part_table[i]) == 0)
+			return 1;
+	return 0;
+}
+
+/* -name among parts */
+static int backup_excluded(const char *name, const char *const *parts)
+{
+	int j;
+
+	for(j = 0;parts != NULL && parts[j] != NULL;j++)
+		if(parts[j][0] == '-' && strcmp(parts[j] + 1,name) == 0)
+			return 1;
+	return 0;
+}
+
+int sprd_backup(const char *dir, const char *const *parts)
+{
+	const char *arg;
+	char path[PATH_MAX],name[16];
+	const char *eq;
+	FILE *manifest;
+	uint64_t size,total = 0;
+	double t0,sec;
+	int i,j,k,n,r = 0,all = 1;
+
+	if(parts != NULL && parts[0] == NULL)
+		parts = NULL;
+	/* only exclusions:every other partition */
+	for(j = 0;parts != NULL && parts[j] != NULL;j++){
+		if(parts[j][0] != '-')
+			all = 0;
+		else if(!backup_known(parts[j] + 1)){
+			sprd_log("backup:partition %s error\n",parts[j]);
+			return -1;
+		}
+	}
+	if(mkdir(dir,0777) != 0 && errno != EEXIST){
+		sprd_log("backup:mkdir %s error:%d\n",dir,errno);
+		return -1;
+	}
+	snprintf(path,sizeof(path),"%s/%s",dir,BACKUP_MANIFEST);
+	manifest = fopen(path,"w");
+	if(manifest == NULL){
+		sprd_log("backup:open or create %s error:%d\n",path,errno);
+		return -1;
+	}
+	fprintf(manifest,"%s\n",BACKUP_MANIFEST_HEAD);
+
+	t0 = backup_now();
+	for(n = 0,k = 0;;k++){
+		/* name,name=size or -name */
+		arg = all ? part_table[k] : parts[k];
+		if(arg == NULL || arg[0] == '\0')
+			break;
+		if(arg[0] == '-' || (all && backup_excluded(arg,parts)))
+			continue;
+		eq = strchr(arg,'=');
+		j = eq ? eq - arg : (int)strlen(arg);
+		snprintf(name,sizeof(name),"%.*s",j,arg);
+		for(i = 0;part_table[i][0] != '\0';i++)
+			if(strcmp(name,part_table[i]) == 0)
+				break;
+		if(part_table[i][0] == '\0' || (eq && (sprd_parse_size(eq + 1,&size) != 0 || size == 0))){
+			sprd_log("backup:partition %s error\n",arg);
+			r = -1;
+			break;
+		}
+		if(eq == NULL)
+			size = part_size[i];
+		n++;
+		r = backup_part(dir,part_table[i],size,manifest,&total);
+		if(r != 0)
+			break;
+	}
+	sec = backup_now() - t0;
+	if(fclose(manifest) != 0 && r == 0)
+		r = -1;
+	sprd_log("backup:%d partitions,%llu Bytes in %.2fs(%.2f MB/s)%s\n",n,(unsigned long long)total,
+		sec,sec > 0 ? total / 1e6 / sec : 0.0,r ? ",not complete" : "");
+	sprd_link_report();
+	return r;
+}
+
+/* restore:a worker reads the image and builds the escaped MIDST_DATA
+ * frames RESTORE_DEPTH windows ahead,the usb thread only sends them */
+#define RESTORE_WINDOW 0x5000	//20k,as write
+#define RESTORE_DEPTH 32
+#define RESTORE_CRC_CHUNK (1024 * 1024)
+
+struct restore_frame {
+	char *buf;		/* escaped frame */
+	int cnt;
+	uint32_t size;		/* data bytes */
+};
+
+struct restore_part {
+	const char *name;
+	uint32_t size;
+	int fd;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct restore_frame ring[RESTORE_DEPTH];
+	int head,tail,cnt;
+	int stop;		/* usb side gave up */
+	int err;		/* worker:errno of a failed read */
+	uint8_t *raw;		/* worker frame before escaping */
+};
+
+/* one line of the manifest */
+struct backup_entry {
+	char name[16];
+	uint32_t size;
+	uint32_t crc;
+	uint32_t sum;
+	char file[PATH_MAX];
+	/* restore results */
+	int skip;		/* not among the partitions given */
+	double sec;
+	uint32_t crc_sent;
+	int crc_bad;		/* image differs from the manifest,not written */
+	int r;
+};
+
+static void *restore_worker(void *arg)
+{
+	struct restore_part *p = arg;
+	struct restore_frame *f;
+	uint32_t off = 0,n;
+	ssize_t r;
+	int stop;
+
+	while(off < p->size){
+		pthread_mutex_lock(&p->lock);
+		while(p->cnt == RESTORE_DEPTH && !p->stop)
+			pthread_cond_wait(&p->cond,&p->lock);
+		f = &p->ring[p->head];
+		stop = p->stop;
+		pthread_mutex_unlock(&p->lock);
+		if(stop)
+			break;
+
+		n = p->size - off < RESTORE_WINDOW ? p->size - off : RESTORE_WINDOW;
+		STATS_T0(t_read);
+		r = pread(p->fd,p->raw + SPRD_FRAME_DATA_OFF,n,off);
+		STATS_ADD(STATS_FILE_READ,t_read,r > 0 ? r : 0);
+		if(r != (ssize_t)n){
+			pthread_mutex_lock(&p->lock);
+			p->err = r == -1 ? errno : EIO;
+			pthread_cond_broadcast(&p->cond);
+			pthread_mutex_unlock(&p->lock);
+			break;
+		}
+		f->cnt = sprd_write_frame(f->buf,p->raw,n);
+		f->size = n;
+		off += n;
+
+		pthread_mutex_lock(&p->lock);
+		p->head = (p->head + 1) % RESTORE_DEPTH;
+		p->cnt++;
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->lock);
+	}
+	return NULL;
+}
+
+static int restore_send(struct restore_part *p)
+{
+	struct restore_frame *f;
+	uint32_t off = 0;
+	int r = 0;
+
+	while(off < p->size){
+		pthread_mutex_lock(&p->lock);
+		while(p->cnt == 0 && !p->err)
+			pthread_cond_wait(&p->cond,&p->lock);
+		r = p->cnt ? 0 : p->err;
+		f = &p->ring[p->tail];
+		pthread_mutex_unlock(&p->lock);
+		if(r != 0){
+			sprd_log("restore:read %s image error:%d\n",p->name,r);
+			break;
+		}
+
+		r = sprd_write_send(f->buf,f->cnt,f->size);
+		if(r != 0)
+			break;
+		off += f->size;
+
+		pthread_mutex_lock(&p->lock);
+		p->tail = (p->tail + 1) % RESTORE_DEPTH;
+		p->cnt--;
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->lock);
+
+		if(sprd_progress(p->name,off,p->size) != 0){
+			sprd_log("restore:canceled\n");
+			r = ECANCELED;
+			break;
+		}
+	}
+	/* let the worker go */
+	pthread_mutex_lock(&p->lock);
+	p->stop = 1;
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->lock);
+	return r;
+}
+
+/* crc32c of the whole image before START_DATA:once MIDST_DATA is sent the
+ * fdl has written it,a changed image must not get that far.The pass also
+ * leaves the image in the page cache for the worker */
+static int restore_crc(int fd, uint32_t size, uint32_t *crc)
+{
+	uint8_t *buf;
+	uint32_t off,n;
+	ssize_t r;
+
+	buf = malloc(RESTORE_CRC_CHUNK);
+	if(buf == NULL)
+		return ENOMEM;
+	*crc = EXT4_CRC32_INIT;
+	for(off = 0;off < size;off += n){
+		n = size - off < RESTORE_CRC_CHUNK ? size - off : RESTORE_CRC_CHUNK;
+		r = pread(fd,buf,n,off);
+		if(r != (ssize_t)n){
+			free(buf);
+			return r == -1 ? errno : EIO;
+		}
+		*crc = ext4_crc32c(*crc,buf,n);
+	}
+	*crc = ~*crc;
+	free(buf);
+	return 0;
+}
+
+static int restore_part(struct backup_entry *e)
+{
+	struct restore_part p;
+	struct stat sb;
+	pthread_t th;
+	double t0;
+	int i,r;
+
+	memset(&p,0,sizeof(p));
+	p.name = e->name;
+	p.size = e->size;
+	p.fd = open(e->file,O_RDONLY);
+	if(p.fd == -1){
+		sprd_log("restore:open %s error:%d\n",e->file,errno);
+		return -1;
+	}
+	if(fstat(p.fd,&sb) != 0 || sb.st_size != e->size){
+		sprd_log("restore:%s is not %u Bytes as in the manifest\n",e->file,e->size);
+		close(p.fd);
+		return -1;
+	}
+	/* same image to many phones:sent from its frame cache */
+	if(frames_enabled()){
+		struct frames fc;
+		if(frames_open(&fc,e->file,RESTORE_WINDOW) == 0){
+			close(p.fd);
+			e->crc_sent = fc.hdr.crc;
+			if(fc.hdr.crc != e->crc){
+				sprd_log("restore:%s crc32c %08x,manifest %08x:not written\n",e->file,fc.hdr.crc,e->crc);
+				e->crc_bad = 1;
+				frames_close(&fc);
+				return -1;
+			}
+			sprd_log("Writing file:'%s'(size=0x%x) to partition '%s'\n",e->file,e->size,e->name);
+			t0 = backup_now();
+			r = sprd_write_frames(e->name,&fc,e->name);
+			e->sec = backup_now() - t0;
+			frames_close(&fc);
+			return r;
+		}
+		sprd_log("frames:no cache for '%s',framing as it goes\n",e->file);
+	}
+	r = restore_crc(p.fd,p.size,&e->crc_sent);
+	if(r != 0){
+		sprd_log("restore:read %s error:%d\n",e->file,r);
+		close(p.fd);
+		return r;
+	}
+	if(e->crc_sent != e->crc){
+		sprd_log("restore:%s crc32c %08x,manifest %08x:not written\n",e->file,e->crc_sent,e->crc);
+		e->crc_bad = 1;
+		close(p.fd);
+		return -1;
+	}
+	p.raw = malloc(RESTORE_WINDOW + 8);
+	for(i = 0;i < RESTORE_DEPTH;i++)
+		p.ring[i].buf = malloc(SPRD_ESCAPE_SIZE(RESTORE_WINDOW));
+	for(i = 0;i < RESTORE_DEPTH && p.ring[i].buf != NULL;i++);
+	if(p.raw == NULL || i < RESTORE_DEPTH){
+		r = ENOMEM;
+		goto out;
+	}
+	pthread_mutex_init(&p.lock,NULL);
+	pthread_cond_init(&p.cond,NULL);
+
+	sprd_log("Writing file:'%s'(size=0x%x) to partition '%s'\n",e->file,e->size,e->name);
+	t0 = backup_now();
+	/* the first frames are built during the START handshake */
+	r = pthread_create(&th,NULL,restore_worker,&p);
+	if(r == 0){
+		r = sprd_write_start(e->name,e->size,e->sum);
+		if(r == 0){
+			r = restore_send(&p);
+			if(r == 0)
+				r = sprd_write_end();
+		}
+		else {
+			pthread_mutex_lock(&p.lock);
+			p.stop = 1;
+			pthread_cond_broadcast(&p.cond);
+			pthread_mutex_unlock(&p.lock);
+		}
+		pthread_join(th,NULL);
+	}
+	e->sec = backup_now() - t0;
+	pthread_mutex_destroy(&p.lock);
+	pthread_cond_destroy(&p.cond);
+out:
+	close(p.fd);
+	free(p.raw);
+	for(i = 0;i < RESTORE_DEPTH;i++)
+		free(p.ring[i].buf);
+	return r;
+}
+
+static int restore_manifest(const char *manifest, struct backup_entry **v, int *cnt)
+{
+	struct backup_entry *e;
+	char line[PATH_MAX + 64],file[PATH_MAX],dir[PATH_MAX];
+	const char *slash;
+	unsigned long long size;
+	int i,n = 0,cap = 0,ln = 0;
+	FILE *fp;
+
+	fp = fopen(manifest,"r");
+	if(fp == NULL){
+		sprd_log("restore:open %s error:%d\n",manifest,errno);
+		return -1;
+	}
+	/* files are relative to the manifest */
+	slash = strrchr(manifest,'/');
+	snprintf(dir,sizeof(dir),"%.*s",slash ? (int)(slash - manifest) : 1,slash ? manifest : ".");
+	*v = NULL;
+	while(fgets(line,sizeof(line),fp) != NULL){
+		ln++;
+		if(line[0] == '#' || line[0] == '\n')
+			continue;
+		if(n == cap){
+			cap = cap ? cap * 2 : 32;
+			e = realloc(*v,cap * sizeof(*e));
+			if(e == NULL)
+				goto error;
+			*v = e;
+		}
+		e = &(*v)[n];
+		memset(e,0,sizeof(*e));
+		if(sscanf(line,"%15s %llu %x %x %4095s",e->name,&size,&e->crc,&e->sum,file) != 5 ||
+		   size == 0 || size > UINT32_MAX){
+			sprd_log("restore:%s line %d not correct\n",manifest,ln);
+			goto error;
+		}
+		for(i = 0;part_table[i][0] != '\0';i++)
+			if(strcmp(e->name,part_table[i]) == 0)
+				break;
+		if(part_table[i][0] == '\0'){
+			sprd_log("restore:%s line %d:partition name %s error\n",manifest,ln,e->name);
+			goto error;
+		}
+		e->size = size;
+		if(snprintf(e->file,sizeof(e->file),"%s%s%s",file[0] == '/' ? "" : dir,
+			file[0] == '/' ? "" : "/",file) >= (int)sizeof(e->file)){
+			sprd_log("restore:%s line %d:path too long\n",manifest,ln);
+			goto error;
+		}
+		n++;
+	}
+	fclose(fp);
+	*cnt = n;
+	return 0;
+error:
+	fclose(fp);
+	free(*v);
+	*v = NULL;
+	return -1;
+}
+
+int sprd_restore(const char *manifest, const char *const *parts)
+{
+	struct backup_entry *v,*e;
+	uint64_t total = 0;
+	double t0,sec;
+	int i,j,n,r = 0;
+
+	if(restore_manifest(manifest,&v,&n) != 0)
+		return -1;
+	/* only the partitions given,in manifest order */
+	if(parts != NULL && parts[0] != NULL){
+		for(j = 0;parts[j] != NULL;j++){
+			for(i = 0;i < n && strcmp(v[i].name,parts[j]) != 0;i++);
+			if(i == n){
+				sprd_log("restore:partition %s not in %s\n",parts[j],manifest);
+				free(v);
+				return -1;
+			}
+		}
+		for(i = 0;i < n;i++){
+			for(j = 0;parts[j] != NULL && strcmp(v[i].name,parts[j]) != 0;j++);
+			v[i].skip = parts[j] == NULL;
+		}
+	}
+
+	t0 = backup_now();
+	for(i = 0;i < n;i++){
+		e = &v[i];
+		if(e->skip)
+			continue;
+		e->r = restore_part(e);
+		if(e->r != 0){
+			r = e->r;
+			break;
+		}
+		total += e->size;
+	}
+	sec = backup_now() - t0;
+
+	/* a partition is written only when its image is the data the backup
+	 * read */
+	sprd_log("restore:%-14s %10s %8s %8s %s\n","partition","Bytes","MB/s","crc32c","result");
+	for(j = 0;j < n && j <= i;j++){
+		e = &v[j];
+		if(e->skip)
+			continue;
+		if(e->crc_bad)
+			sprd_log("restore:%-14s %10u %8s %08x crc differs from the manifest\n",e->name,e->size,"-",e->crc_sent);
+		else if(e->r != 0)
+			sprd_log("restore:%-14s %10u %8s %8s error %d\n",e->name,e->size,"-","-",e->r);
+		else
+			sprd_log("restore:%-14s %10u %8.2f %08x ok\n",e->name,e->size,
+				e->sec > 0 ? e->size / 1e6 / e->sec : 0.0,e->crc_sent);
+	}
+	sprd_log("restore:%llu Bytes in %.2fs(%.2f MB/s)%s\n",(unsigned long long)total,sec,
+		sec > 0 ? total / 1e6 / sec : 0.0,r ? ",not complete" : "");
+	sprd_link_report();
+	free(v);
+	return r;
+}
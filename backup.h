@@ -0,0 +1,29 @@
+#ifndef __BACKUP_H
+#define __BACKUP_H
+
+/* Full device backup in one session(syber_usb backup).
+ * Every partition of part_table(or the ones given,or all but the -name
+ * ones) is read to {dir}/{partition}.img,sizes from part_size or the
+ * ext4 superblock/fat boot sector of the partition,a partition of unknown
+ * size fails the backup.The usb thread only reads windows:checksums and the file
+ * writes run on a worker thread,all-zero 4k blocks are left as holes of
+ * a sparse file.{dir}/manifest lists what was saved,one line per
+ * partition:
+ *   name size crc32c sum file
+ * size decimal,crc32c and sum(byte sum,START_DATA of l_fixnv1) hex. */
+
+#define BACKUP_MANIFEST "manifest"
+#define BACKUP_MANIFEST_HEAD "# syber_usb backup:partition size crc32c sum file"
+
+/* parts:NULL terminated "name","name=size" or "-name",NULL:every partition */
+int sprd_backup(const char *dir, const char *const *parts);
+
+/* Restore of a backup in one session(syber_usb restore):the partitions
+ * of a manifest(or the ones given) are written in manifest order.A
+ * worker reads each image and builds the escaped frames ahead of the usb
+ * thread,which only sends them and waits for the acks.Each image is
+ * checked against the manifest crc32c before START_DATA,a changed image
+ * is not written. */
+int sprd_restore(const char *manifest, const char *const *parts);
+
+#endif /* __BACKUP_H */
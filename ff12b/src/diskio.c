@@ -268,26 +268,26 @@ int USB_disk_initialize(void)
         debug_print_hex(internalsd_partition,sizeof(internalsd_partition)); 
 	r = sprd_usb_transfer(internalsd_partition,sizeof(internalsd_partition));
 	if(r != 0){
-		printf("USB_disk_initialize:sprd usb transfer error:%d\n",r);
+		sprd_log("USB_disk_initialize:sprd usb transfer error:%d\n",r);
 		return r;
 	}
         for(i = 5;i ;i--){
-                r = sprd_usb_receive(ack_buffer,&cnt);
+                r = sprd_usb_receive_max(ack_buffer,sizeof(ack_buffer),&cnt);
                 if(r) continue;else break;
         }
         if(!i){
-                printf("USB_disk_initialize:sprd usb receive error:%d\n",r);
+                sprd_log("USB_disk_initialize:sprd usb receive error:%d\n",r);
                 return r;
         }
         debug_print_hex(ack_buffer,cnt); 
 
         if(sprd_verify_frame(ack_buffer,cnt) != 0){
-                printf("USB_disk_initialize:sprd verify frame error\n");
+                sprd_log("USB_disk_initialize:sprd verify frame error\n");
                 return 1;
         }
         if(ack_buffer[SPRD_FRAME_TYPE_OFF] == BSL_REP_DOWN_SIZE_ERROR){
 #ifdef SPRD_DEBUG
-                printf("USB_disk_initialize:partition size error(not care!)\n");
+                sprd_log("USB_disk_initialize:partition size error(not care!)\n");
 #endif
         }
 	
@@ -301,71 +301,23 @@ int USB_disk_status(void)
 
 int USB_disk_read(BYTE* buff, DWORD sector, UINT count)
 {
-	int r;int i;int cnt;
-	uint8_t com_buffer[84];
-	int win_size = 0x3000; //12k default:
-	uint32_t buff_offset = 0;
-
-	uint16_t crc;
+	int r;
         uint32_t up_size = _MAX_SS * count;
 	uint32_t start_offset = _MAX_SS * sector;
         uint32_t offset = 0;
         uint32_t s_size = 0;
 
-	char *s_buffer = malloc(win_size*2);
         while(up_size){
-                s_size = (up_size > win_size) ? win_size:up_size;
-                com_buffer[SPRD_FRAME_START_OFF] = SPRD_START_BYTE;
-                com_buffer[1] = 0x00;
-                com_buffer[SPRD_FRAME_TYPE_OFF] = BSL_CMD_READ_FLASH_MIDST;
-                com_buffer[SPRD_FRAME_DATA_SIZE_OFF] = 0x08>>8;
-                com_buffer[SPRD_FRAME_DATA_SIZE_OFF+1] = 0x08;
-                ((uint32_t*)(com_buffer+SPRD_FRAME_DATA_OFF))[0] = s_size;
-                ((uint32_t*)(com_buffer+SPRD_FRAME_DATA_OFF))[1] = offset + start_offset;
-                crc = checksum(checksum_type,com_buffer+1,16-4);
-                com_buffer[16-3] = crc>>8;
-                com_buffer[16-2] = crc;
-                com_buffer[16-1] = SPRD_END_BYTE;                       
-        
-
-                cnt = sprd_frame_exchange(s_buffer,com_buffer,16,0);
-                r = sprd_usb_transfer(s_buffer,cnt);
-                debug_print_hex(s_buffer,cnt);
+                s_size = (up_size > SPRD_READ_WINDOW) ? SPRD_READ_WINDOW:up_size;
+                r = sprd_read_flash(buff + offset,s_size,offset + start_offset);
                 if(r != 0){
-                        printf("USB_disk_read:sprd usb transfer error:%d\n",r);
+                        sprd_log("USB_disk_read:sprd read flash error:%d\n",r);
                         return r;
                 }
-                int i_temp = 0;
-                for(cnt = 0;cnt != s_size + 8;){
-                        i = 0;
-                        do{
-                                r = sprd_usb_receive(s_buffer+i,&i_temp);
-                                if(r != 0){
-                                        printf("USB_disk_read:sprd usb receive error:%d\n",r);
-                                        return r;
-                                }
-                                i += i_temp;
-                        }while(s_buffer[i-1] == 0x7d);//last byte maybe 0x7d
-                        debug_print_hex(s_buffer,i);
-                        i = sprd_frame_exchange(data_buffer+cnt,s_buffer,i,1);
-                        cnt += i;
-                }
-                if(sprd_verify_frame(data_buffer,cnt) != 0 || data_buffer[SPRD_FRAME_TYPE_OFF] != BSL_REP_READ_FLASH){
-                        printf("USB_disk_read:sprd verify frame error\n");
-                        return -1;
-                }
-                //write to buff         cnt = frame_size data_buffer = frame_pointer
-		//memcpy(buff,data_buffer+5,cnt-8);
-		cnt -= 8;
-		for(i = 0;i < cnt;i++){
-			buff[buff_offset++] = data_buffer[i+5];
-		}
-
                 offset += s_size;
                 up_size -= s_size;
         }
 
-        free(s_buffer);
 	return 0;
 }
 
@@ -379,17 +331,17 @@ int USB_disk_ioctl (BYTE cmd, void* buff)
 	int r;int cnt;
         r = sprd_com_nodata(BSL_CMD_READ_FLASH_END);
         if(r != 0){
-                printf("USB_disk_ioctl:sprd com nodata error:%d\n",r);
+                sprd_log("USB_disk_ioctl:sprd com nodata error:%d\n",r);
                 return r;
         }
         r = sprd_usb_receive(data_buffer,&cnt);
         if(r != 0){
-                printf("USB_disk_ioctl:sprd usb receive error:%d\n",r);
+                sprd_log("USB_disk_ioctl:sprd usb receive error:%d\n",r);
                 return r;
         }
         debug_print_hex(data_buffer,cnt);
         if(sprd_verify_frame(data_buffer,cnt) != 0 || data_buffer[SPRD_FRAME_TYPE_OFF] != BSL_REP_ACK){
-                printf("USB_disk_ioctl:sprd ack error\n");
+                sprd_log("USB_disk_ioctl:sprd ack error\n");
                 return 1;
         }
 	
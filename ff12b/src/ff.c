@@ -20,6 +20,9 @@
 
 #include "ff.h"			/* Declarations of FatFs API */
 #include "diskio.h"		/* Declarations of device I/O functions */
+#if _USE_FATCACHE
+#include <stdlib.h>		/* malloc() and free() for the FAT cache */
+#endif
 
 
 /*--------------------------------------------------------------------------
@@ -32,6 +35,10 @@
 #error Wrong include file (ff.h).
 #endif
 
+#if _USE_FATCACHE && (!_USE_FASTSEEK || !_FS_READONLY)
+#error _USE_FATCACHE needs _USE_FASTSEEK = 1 and _FS_READONLY = 1
+#endif
+
 
 #define	ABORT(fs, res)		{ fp->err = (BYTE)(res); LEAVE_FF(fs, res); }
 
@@ -920,6 +927,70 @@ FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERROR */
 
 
 
+#if _USE_FATCACHE
+/*-----------------------------------------------------------------------*/
+/* FAT cache - Allocate/Release the cache of the volume                  */
+/*-----------------------------------------------------------------------*/
+
+static
+void fatcache_free (
+	FATFS* fs		/* File system object */
+)
+{
+	free(fs->fcache);
+	free(fs->fcvalid);
+	fs->fcache = 0;
+	fs->fcvalid = 0;
+}
+
+
+static
+void fatcache_init (	/* The cache is left disabled if the memory is short */
+	FATFS* fs		/* File system object */
+)
+{
+	DWORD nblk = (fs->fsize + _FATCACHE_SECT - 1) / _FATCACHE_SECT;
+
+
+	fs->fcache = malloc((size_t)fs->fsize * SS(fs));
+	fs->fcvalid = calloc(nblk, 1);
+	if (!fs->fcache || !fs->fcvalid) fatcache_free(fs);
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* FAT cache - Make a byte of the FAT appear in fs->fcache[]             */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT fatcache_load (	/* Returns FR_OK or FR_DISK_ERROR */
+	FATFS* fs,		/* File system object */
+	DWORD bofs		/* Byte offset in the FAT */
+)
+{
+	DWORD blk, sect;
+	UINT cnt;
+
+
+	blk = bofs / SS(fs) / _FATCACHE_SECT;
+	if (!fs->fcvalid[blk]) {	/* Load the whole block in a single disk access */
+		sect = blk * _FATCACHE_SECT;
+		cnt = (fs->fsize - sect > _FATCACHE_SECT) ? _FATCACHE_SECT : (UINT)(fs->fsize - sect);
+		if (disk_read(fs->drv, fs->fcache + sect * SS(fs), fs->fatbase + sect, cnt) != RES_OK) {
+			return FR_DISK_ERR;
+		}
+		fs->fcvalid[blk] = 1;
+	}
+	return FR_OK;
+}
+
+#endif	/* _USE_FATCACHE */
+
+
+
+
 #if !_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* Synchronize file system and strage device                             */
@@ -1002,6 +1073,14 @@ DWORD get_fat (	/* 0xFFFFFFFF:Disk error, 1:Internal error, 2..0x7FFFFFFF:Cluste
 		switch (fs->fs_type) {
 		case FS_FAT12 :
 			bc = (UINT)clst; bc += bc / 2;
+#if _USE_FATCACHE
+			if (fs->fcache) {
+				if (fatcache_load(fs, bc) != FR_OK || fatcache_load(fs, bc + 1) != FR_OK) break;
+				wc = fs->fcache[bc] | fs->fcache[bc + 1] << 8;
+				val = (clst & 1) ? (wc >> 4) : (wc & 0xFFF);
+				break;
+			}
+#endif
 			if (move_window(fs, fs->fatbase + (bc / SS(fs))) != FR_OK) break;
 			wc = fs->win[bc++ % SS(fs)];
 			if (move_window(fs, fs->fatbase + (bc / SS(fs))) != FR_OK) break;
@@ -1010,11 +1089,25 @@ DWORD get_fat (	/* 0xFFFFFFFF:Disk error, 1:Internal error, 2..0x7FFFFFFF:Cluste
 			break;
 
 		case FS_FAT16 :
+#if _USE_FATCACHE
+			if (fs->fcache) {
+				if (fatcache_load(fs, clst * 2) != FR_OK) break;
+				val = ld_word(fs->fcache + clst * 2);
+				break;
+			}
+#endif
 			if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 2))) != FR_OK) break;
 			val = ld_word(fs->win + clst * 2 % SS(fs));
 			break;
 
 		case FS_FAT32 :
+#if _USE_FATCACHE
+			if (fs->fcache) {
+				if (fatcache_load(fs, clst * 4) != FR_OK) break;
+				val = ld_dword(fs->fcache + clst * 4) & 0x0FFFFFFF;
+				break;
+			}
+#endif
 			if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 4))) != FR_OK) break;
 			val = ld_dword(fs->win + clst * 4 % SS(fs)) & 0x0FFFFFFF;
 			break;
@@ -1419,6 +1512,50 @@ DWORD clmt_clust (	/* <2:Error, >=2:Cluster number */
 
 
 
+#if _USE_FATCACHE
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Build the link map table of the whole cluster chain    */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT create_clmt (	/* FR_OK(0): succeeded or no memory (file left in normal mode), !=0: error */
+	FIL* fp				/* Pointer to the file object, sclust != 0 */
+)
+{
+	FRESULT res;
+	DWORD cl, pcl, nfrag, *tbl;
+	FATFS *fs = fp->obj.fs;
+
+
+	nfrag = 0;					/* Count the fragments (the FAT blocks are loaded here in bulk) */
+	cl = fp->obj.sclust;
+	do {
+		nfrag++;
+		do {
+			pcl = cl;
+			cl = get_fat(&fp->obj, cl);
+			if (cl <= 1) return FR_INT_ERR;
+			if (cl == 0xFFFFFFFF) return FR_DISK_ERR;
+		} while (cl == pcl + 1);
+	} while (cl < fs->n_fatent);
+
+	tbl = malloc((nfrag * 2 + 2) * sizeof (DWORD));
+	if (!tbl) return FR_OK;		/* Fall back to following the FAT chain */
+	*tbl = nfrag * 2 + 2;		/* Table size */
+	fp->clmt = fp->cltbl = tbl;
+	res = f_lseek(fp, CREATE_LINKMAP);	/* Fill the table from the FAT cache */
+	if (res != FR_OK) {
+		free(tbl);
+		fp->clmt = fp->cltbl = 0;
+	}
+	return res;
+}
+
+#endif	/* _USE_FATCACHE */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Directory handling - Set directory index                              */
 /*-----------------------------------------------------------------------*/
@@ -2980,6 +3117,9 @@ FRESULT find_volume (	/* FR_OK(0): successful, !=0: any error occurred */
 	/* The file system object is not valid. */
 	/* Following code attempts to mount the volume. (analyze BPB and initialize the fs object) */
 
+#if _USE_FATCACHE
+	fatcache_free(fs);					/* Discard the FAT cache of the old volume */
+#endif
 	fs->fs_type = 0;					/* Clear the file system object */
 	fs->drv = LD2PD(vol);				/* Bind the logical drive and a physical drive */
 	stat = disk_initialize(fs->drv);	/* Initialize the physical drive */
@@ -3148,6 +3288,9 @@ FRESULT find_volume (	/* FR_OK(0): successful, !=0: any error occurred */
 #endif
 #if _FS_LOCK != 0		/* Clear file lock semaphores */
 	clear_lock(fs);
+#endif
+#if _USE_FATCACHE
+	if (fmt != FS_EXFAT) fatcache_init(fs);	/* Create the FAT cache (exFAT has its own chain status) */
 #endif
 	return FR_OK;
 }
@@ -3219,10 +3362,17 @@ FRESULT f_mount (
 		if (!ff_del_syncobj(cfs->sobj)) return FR_INT_ERR;
 #endif
 		cfs->fs_type = 0;				/* Clear old fs object */
+#if _USE_FATCACHE
+		fatcache_free(cfs);				/* Release the FAT cache of the old fs object */
+#endif
 	}
 
 	if (fs) {
 		fs->fs_type = 0;				/* Clear new fs object */
+#if _USE_FATCACHE
+		fs->fcache = 0;					/* No FAT cache until the volume is mounted */
+		fs->fcvalid = 0;
+#endif
 #if _FS_REENTRANT						/* Create sync object for the new volume */
 		if (!ff_cre_syncobj((BYTE)vol, &fs->sobj)) return FR_INT_ERR;
 #endif
@@ -3400,6 +3550,10 @@ FRESULT f_open (
 			fp->err = 0;			/* Clear error flag */
 			fp->sect = 0;			/* Invalidate current data sector */
 			fp->fptr = 0;			/* Set file pointer top of the file */
+#if _USE_FATCACHE
+			fp->clmt = 0;
+			if (fs->fcache && fp->obj.sclust) res = create_clmt(fp);	/* Map the whole cluster chain */
+#endif
 #if !_FS_READONLY
 #if !_FS_TINY
 			mem_set(fp->buf, 0, _MAX_SS);	/* Clear sector buffer */
@@ -3761,6 +3915,11 @@ FRESULT f_close (
 			if (res == FR_OK)
 #endif
 			{
+#if _USE_FATCACHE
+				free(fp->clmt);			/* Release the cluster link map table */
+				fp->clmt = 0;
+				fp->cltbl = 0;
+#endif
 				fp->obj.fs = 0;			/* Invalidate file object */
 			}
 #if _FS_REENTRANT
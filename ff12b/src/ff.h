@@ -130,6 +130,10 @@ typedef struct {
 	DWORD	database;		/* Data base sector */
 	DWORD	winsect;		/* Current sector appearing in the win[] */
 	BYTE	win[_MAX_SS];	/* Disk access window for Directory, FAT (and file data at tiny cfg) */
+#if _USE_FATCACHE
+	BYTE*	fcache;			/* FAT cache (whole FAT, filled on demand, 0:disabled) */
+	BYTE*	fcvalid;		/* FAT cache block status (1:loaded) */
+#endif
 } FATFS;
 
 
@@ -172,6 +176,9 @@ typedef struct {
 #if _USE_FASTSEEK
 	DWORD*	cltbl;			/* Pointer to the cluster link map table (nulled on open, set by application) */
 #endif
+#if _USE_FATCACHE
+	DWORD*	clmt;			/* Cluster link map table allocated by f_open() (freed by f_close()) */
+#endif
 #if !_FS_TINY
 	BYTE	buf[_MAX_SS];	/* File private data read/write window */
 #endif
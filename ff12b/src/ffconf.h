@@ -43,10 +43,20 @@
 /* This option switches f_mkfs() function. (0:Disable or 1:Enable) */
 
 
-#define	_USE_FASTSEEK	0
+#define	_USE_FASTSEEK	1
 /* This option switches fast seek function. (0:Disable or 1:Enable) */
 
 
+#define	_USE_FATCACHE	1
+#define	_FATCACHE_SECT	64
+/* This option switches the in-memory FAT cache. (0:Disable or 1:Enable)
+/  The whole FAT of the mounted volume is mirrored on the heap and filled on
+/  demand in blocks of _FATCACHE_SECT sectors, so get_fat() does not touch the
+/  disk once the block is loaded. f_open() also builds the cluster link map
+/  table of the file automatically, so f_read() and f_lseek() never follow the
+/  FAT chain. Requires _USE_FASTSEEK = 1 and _FS_READONLY = 1. */
+
+
 #define	_USE_EXPAND		0
 /* This option switches f_expand function. (0:Disable or 1:Enable) */
 
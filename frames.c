@@ -0,0 +1,199 @@
+/* pre-framed image cache,see frames.h */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "main.h"
+#include "protocol.h"
+#include "checksum.h"
+#include "frames.h"
+#include "ext4_types.h"
+#include "ext4_crc32.h"
+
+static int frames_on;
+
+void frames_enable(int on)
+{
+	frames_on = on;
+}
+
+int frames_enabled(void)
+{
+	return frames_on;
+}
+
+static int frames_valid(const struct frames_hdr *h, const struct stat *sb, uint32_t win)
+{
+	return memcmp(h->magic,FRAMES_MAGIC,sizeof(h->magic)) == 0 &&
+		h->version == FRAMES_VERSION && h->win == win &&
+		h->checksum_type == checksum_type && h->size == (uint64_t)sb->st_size &&
+		h->ino == sb->st_ino &&
+		h->mtime_ns == (int64_t)sb->st_mtim.tv_sec * 1000000000 + sb->st_mtim.tv_nsec;
+}
+
+static int frames_map(struct frames *f, const char *path, const struct stat *sb, uint32_t win)
+{
+	struct stat cs;
+	void *p;
+	int fd;
+
+	fd = open(path,O_RDONLY);
+	if(fd == -1)
+		return -1;
+	if(fstat(fd,&cs) != 0 || cs.st_size < (off_t)sizeof(f->hdr)){
+		close(fd);
+		return -1;
+	}
+	p = mmap(NULL,cs.st_size,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if(p == MAP_FAILED)
+		return -1;
+	memcpy(&f->hdr,p,sizeof(f->hdr));
+	if(!frames_valid(&f->hdr,sb,win) ||
+	   sizeof(f->hdr) + (f->hdr.count + 1) * sizeof(uint64_t) > (size_t)cs.st_size){
+		munmap(p,cs.st_size);
+		return -1;
+	}
+	f->map = p;
+	f->map_size = cs.st_size;
+	f->index = (const uint64_t *)(f->map + sizeof(f->hdr));
+	if(f->index[f->hdr.count] != (uint64_t)cs.st_size){
+		frames_close(f);
+		return -1;
+	}
+	madvise(p,cs.st_size,MADV_SEQUENTIAL);
+	return 0;
+}
+
+/* frame the image into path.tmp,then rename:a reader never maps a half
+ * written cache */
+static int frames_build(int src, const char *path, const struct stat *sb, uint32_t win)
+{
+	struct frames_hdr h;
+	char tmp[PATH_MAX];
+	uint64_t *index;
+	uint8_t *raw;
+	char *esc;
+	uint64_t off = 0,pos;
+	uint32_t i,n,crc = EXT4_CRC32_INIT,sum = 0;
+	ssize_t r;
+	int fd,cnt,ret = -1;
+
+	memset(&h,0,sizeof(h));
+	memcpy(h.magic,FRAMES_MAGIC,sizeof(h.magic));
+	h.version = FRAMES_VERSION;
+	h.win = win;
+	h.checksum_type = checksum_type;
+	h.count = (sb->st_size + win - 1) / win;
+	h.size = sb->st_size;
+	h.ino = sb->st_ino;
+	h.mtime_ns = (int64_t)sb->st_mtim.tv_sec * 1000000000 + sb->st_mtim.tv_nsec;
+
+	if(snprintf(tmp,sizeof(tmp),"%s.tmp",path) >= (int)sizeof(tmp)){
+		sprd_log("frames:%s.tmp error:%d\n",path,ENAMETOOLONG);
+		return -1;
+	}
+	fd = open(tmp,O_CREAT|O_WRONLY|O_TRUNC,0666);
+	if(fd == -1){
+		sprd_log("frames:open or create %s error:%d\n",tmp,errno);
+		return -1;
+	}
+	index = malloc((h.count + 1) * sizeof(uint64_t));
+	raw = malloc(win + 8);
+	esc = malloc(SPRD_ESCAPE_SIZE(win));
+	if(index == NULL || raw == NULL || esc == NULL)
+		goto out;
+
+	pos = sizeof(h) + (h.count + 1) * sizeof(uint64_t);
+	for(i = 0;i < h.count;i++){
+		n = h.size - off < win ? h.size - off : win;
+		r = pread(src,raw + SPRD_FRAME_DATA_OFF,n,off);
+		if(r != (ssize_t)n){
+			sprd_log("frames:read image error:%d\n",r == -1 ? errno : EIO);
+			goto out;
+		}
+		crc = ext4_crc32c(crc,raw + SPRD_FRAME_DATA_OFF,n);
+		for(r = 0;r < n;r++)
+			sum += raw[SPRD_FRAME_DATA_OFF + r];
+		cnt = sprd_write_frame(esc,raw,n);
+		if(pwrite(fd,esc,cnt,pos) != cnt){
+			sprd_log("frames:write %s error:%d\n",tmp,errno);
+			goto out;
+		}
+		index[i] = pos;
+		pos += cnt;
+		off += n;
+	}
+	index[h.count] = pos;
+	h.crc = ~crc;
+	h.sum = sum;
+	if(pwrite(fd,&h,sizeof(h),0) != sizeof(h) ||
+	   pwrite(fd,index,(h.count + 1) * sizeof(uint64_t),sizeof(h)) != (ssize_t)((h.count + 1) * sizeof(uint64_t))){
+		sprd_log("frames:write %s error:%d\n",tmp,errno);
+		goto out;
+	}
+	if(close(fd) == 0 && rename(tmp,path) == 0)
+		ret = 0;
+	fd = -1;
+out:
+	if(fd != -1)
+		close(fd);
+	if(ret != 0)
+		unlink(tmp);
+	free(index);
+	free(raw);
+	free(esc);
+	return ret;
+}
+
+int frames_open(struct frames *f, const char *image, uint32_t win)
+{
+	char path[PATH_MAX];
+	struct stat sb;
+	int src,r;
+
+	memset(f,0,sizeof(*f));
+	if(snprintf(path,sizeof(path),"%s.frames",image) >= (int)sizeof(path))
+		return -1;
+	src = open(image,O_RDONLY);
+	if(src == -1 || fstat(src,&sb) != 0 || sb.st_size == 0){
+		if(src != -1)
+			close(src);
+		return -1;
+	}
+	if(frames_map(f,path,&sb,win) == 0){
+		close(src);
+		sprd_log("frames:%s,%u frames\n",path,f->hdr.count);
+		return 0;
+	}
+	/* one builder per image,the others wait and map its result */
+	flock(src,LOCK_EX);
+	r = frames_map(f,path,&sb,win);
+	if(r != 0){
+		sprd_log("frames:building %s\n",path);
+		r = frames_build(src,path,&sb,win);
+		if(r == 0)
+			r = frames_map(f,path,&sb,win);
+	}
+	flock(src,LOCK_UN);
+	close(src);
+	if(r == 0)
+		sprd_log("frames:%s,%u frames\n",path,f->hdr.count);
+	return r;
+}
+
+void frames_close(struct frames *f)
+{
+	if(f->map != NULL)
+		munmap((void *)f->map,f->map_size);
+	f->map = NULL;
+	f->index = NULL;
+}
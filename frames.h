@@ -0,0 +1,56 @@
+#ifndef __FRAMES_H
+#define __FRAMES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Pre-framed image cache(--frame-cache).
+ * The MIDST_DATA frames of an image(header,checksum,escaping,trailer)
+ * are the same for every phone at a given window size and checksum type:
+ * they are built once into {image}.frames and sent straight from the
+ * mapping,concurrent sessions share the page cache.
+ *   struct frames_hdr,index(count + 1 file offsets,frame i is
+ *   index[i]..index[i + 1]),frames
+ * The cache is valid while the image keeps its size,inode and mtime;a
+ * stale or missing cache is rebuilt under a lock on the image,so parallel
+ * flashes of one image build it once. */
+
+#define FRAMES_MAGIC "SPRDFRMS"
+#define FRAMES_VERSION 1
+
+struct frames_hdr {
+	char magic[8];
+	uint32_t version;
+	uint32_t win;		/* data bytes per frame */
+	uint32_t checksum_type;
+	uint32_t count;		/* frames */
+	uint64_t size;		/* image */
+	uint64_t ino;
+	int64_t mtime_ns;
+	uint32_t crc;		/* crc32c of the image */
+	uint32_t sum;		/* byte sum(START_DATA of l_fixnv1) */
+};
+
+struct frames {
+	const uint8_t *map;
+	size_t map_size;
+	const uint64_t *index;
+	struct frames_hdr hdr;
+};
+
+/* cache for the partition writes,0 off */
+void frames_enable(int on);
+int frames_enabled(void);
+
+/* map the frames of image at win bytes per frame,building them if needed */
+int frames_open(struct frames *f, const char *image, uint32_t win);
+void frames_close(struct frames *f);
+
+/* frame i,escaped,*len bytes */
+static inline const uint8_t *frames_get(const struct frames *f, uint32_t i, int *len)
+{
+	*len = (int)(f->index[i + 1] - f->index[i]);
+	return f->map + f->index[i];
+}
+
+#endif /* __FRAMES_H */
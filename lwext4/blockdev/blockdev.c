@@ -31,6 +31,8 @@
 #include <ext4_blockdev.h>
 #include <ext4_errno.h>
 
+#include <pthread.h>
+
 #include "main.h"
 #include "protocol.h"
 #include "checksum.h"
@@ -51,11 +53,15 @@ static int blockdev_unlock(struct ext4_blockdev *bdev);
 /******************************************************************************/
 EXT4_BLOCKDEV_STATIC_INSTANCE(syberfsdev, EXT4_BLOCKDEV_BSIZE, EXT4_BLOCKDEV_BCNT, blockdev_open,
 			      blockdev_bread, blockdev_bwrite, blockdev_close,
-			      0, 0);
+			      blockdev_lock, blockdev_unlock);
 
 EXT4_BLOCKDEV_STATIC_INSTANCE(datadev, EXT4_BLOCKDEV_BSIZE, EXT4_BLOCKDEV_BCNT, blockdev_open,
 			      blockdev_bread, blockdev_bwrite, blockdev_close,
-			      0, 0);
+			      blockdev_lock, blockdev_unlock);
+
+/*One usb link (and data_buffer) behind both partitions: a read is a
+ *request/response exchange and must not interleave with another thread's.*/
+static pthread_mutex_t usb_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /******************************************************************************/
 static int blockdev_open(struct ext4_blockdev *bdev)
@@ -99,31 +105,31 @@ static int blockdev_open(struct ext4_blockdev *bdev)
 	        debug_print_hex(data_partition,sizeof(data_partition)); 
 		r = sprd_usb_transfer(data_partition,sizeof(data_partition));
 	}else{
-		printf("blockdev_open:bdev error\n");
+		sprd_log("blockdev_open:bdev error\n");
 		return 1;
 	}
 
 	if(r != 0){
-		printf("blockdev_open:sprd usb transfer error:%d\n",r);
+		sprd_log("blockdev_open:sprd usb transfer error:%d\n",r);
 		return r;
 	}
         for(i = 5;i ;i--){
-                r = sprd_usb_receive(ack_buffer,&cnt);
+                r = sprd_usb_receive_max(ack_buffer,sizeof(ack_buffer),&cnt);
                 if(r) continue;else break;
         }
         if(!i){
-                printf("blockdev_open:sprd usb receive error:%d\n",r);
+                sprd_log("blockdev_open:sprd usb receive error:%d\n",r);
                 return r;
         }
         debug_print_hex(ack_buffer,cnt); 
 
         if(sprd_verify_frame(ack_buffer,cnt) != 0){
-                printf("blockdev_open:sprd verify frame error\n");
+                sprd_log("blockdev_open:sprd verify frame error\n");
                 return 1;
         }
         if(ack_buffer[SPRD_FRAME_TYPE_OFF] == BSL_REP_DOWN_SIZE_ERROR){
 #ifdef SPRD_DEBUG
-                printf("blockdev_open:partition size error(not care!)\n");
+                sprd_log("blockdev_open:partition size error(not care!)\n");
 #endif
         }
 
@@ -135,12 +141,7 @@ static int blockdev_open(struct ext4_blockdev *bdev)
 static int blockdev_bread(struct ext4_blockdev *bdev, void *buf, uint64_t blk_id,
 			 uint32_t blk_cnt)
 {
-        int r;int i;int cnt;
-        uint8_t com_buffer[84];
-        int win_size = 0x3000; //12k default:
-        uint32_t buf_offset = 0;
-
-        uint16_t crc;
+        int r;
         uint32_t up_size = EXT4_BLOCKDEV_BSIZE * blk_cnt;
         uint32_t start_offset = EXT4_BLOCKDEV_BSIZE * blk_id;
         uint32_t offset = 0;
@@ -148,65 +149,21 @@ static int blockdev_bread(struct ext4_blockdev *bdev, void *buf, uint64_t blk_id
 
 	/*blockdev_bread: skeleton*/
 	if(bdev != &syberfsdev && bdev != &datadev){
-		printf("blockdev_bread:bdev error\n");
+		sprd_log("blockdev_bread:bdev error\n");
 		return 1;
 	}
-		
-        char *s_buffer = malloc(win_size*2);
-        while(up_size){
-                s_size = (up_size > win_size) ? win_size:up_size;
-                com_buffer[SPRD_FRAME_START_OFF] = SPRD_START_BYTE;
-                com_buffer[1] = 0x00;
-                com_buffer[SPRD_FRAME_TYPE_OFF] = BSL_CMD_READ_FLASH_MIDST;
-                com_buffer[SPRD_FRAME_DATA_SIZE_OFF] = 0x08>>8;
-                com_buffer[SPRD_FRAME_DATA_SIZE_OFF+1] = 0x08;
-                ((uint32_t*)(com_buffer+SPRD_FRAME_DATA_OFF))[0] = s_size;
-                ((uint32_t*)(com_buffer+SPRD_FRAME_DATA_OFF))[1] = offset + start_offset;
-                crc = checksum(checksum_type,com_buffer+1,16-4);
-                com_buffer[16-3] = crc>>8;
-                com_buffer[16-2] = crc;
-                com_buffer[16-1] = SPRD_END_BYTE;    
-    
 
-                cnt = sprd_frame_exchange(s_buffer,com_buffer,16,0);
-                r = sprd_usb_transfer(s_buffer,cnt);
-                debug_print_hex(s_buffer,cnt);
-                if(r != 0){ 
-                        printf("blockdev_bread:sprd usb transfer error:%d\n",r);
+        while(up_size){
+                s_size = (up_size > SPRD_READ_WINDOW) ? SPRD_READ_WINDOW:up_size;
+                r = sprd_read_flash((char *)buf + offset,s_size,offset + start_offset);
+                if(r != 0){
+                        sprd_log("blockdev_bread:sprd read flash error:%d\n",r);
                         return r;
                 }
-                int i_temp = 0;
-                for(cnt = 0;cnt != s_size + 8;){
-                        i = 0;
-                        do{
-                                r = sprd_usb_receive(s_buffer+i,&i_temp);
-                                if(r != 0){ 
-                                        printf("blockdev_bread:sprd usb receive error:%d\n",r);
-                                        return r;
-                                }
-                                i += i_temp;
-                        }while(s_buffer[i-1] == 0x7d);//last byte maybe 0x7d
-                        debug_print_hex(s_buffer,i);
-                        i = sprd_frame_exchange(data_buffer+cnt,s_buffer,i,1);
-                        cnt += i;
-                }
-                if(sprd_verify_frame(data_buffer,cnt) != 0 || data_buffer[SPRD_FRAME_TYPE_OFF] != BSL_REP_READ_FLASH){
-                        printf("USB_disk_read:sprd verify frame error\n");
-                        return -1; 
-                }
-                //write to buff         cnt = frame_size data_buffer = frame_pointer
-                //memcpy(buff,data_buffer+5,cnt-8);
-                cnt -= 8;
-                for(i = 0;i < cnt;i++){
-                        ((char*)buf)[buf_offset++] = data_buffer[i+5];
-                }
-
                 offset += s_size;
                 up_size -= s_size;
         }
 
-        free(s_buffer);
-		
 	return EOK;
 }
 
@@ -225,17 +182,17 @@ static int blockdev_close(struct ext4_blockdev *bdev)
         int r;int cnt;
         r = sprd_com_nodata(BSL_CMD_READ_FLASH_END);
         if(r != 0){ 
-                printf("blockdev_close:sprd com nodata error:%d\n",r);
+                sprd_log("blockdev_close:sprd com nodata error:%d\n",r);
                 return r;
         }   
         r = sprd_usb_receive(data_buffer,&cnt);
         if(r != 0){ 
-                printf("blockdev_close:sprd usb receive error:%d\n",r);
+                sprd_log("blockdev_close:sprd usb receive error:%d\n",r);
                 return r;
         }   
         debug_print_hex(data_buffer,cnt);
         if(sprd_verify_frame(data_buffer,cnt) != 0 || data_buffer[SPRD_FRAME_TYPE_OFF] != BSL_REP_ACK){
-                printf("blockdev_close:sprd ack error\n");
+                sprd_log("blockdev_close:sprd ack error\n");
                 return 1;
         }  
 	return EOK;
@@ -243,14 +200,14 @@ static int blockdev_close(struct ext4_blockdev *bdev)
 
 static int blockdev_lock(struct ext4_blockdev *bdev)
 {
-	/*blockdev_lock: skeleton*/
-	return EOK;
+	/*blockdev_lock: serialize usb exchanges*/
+	return pthread_mutex_lock(&usb_lock);
 }
 
 static int blockdev_unlock(struct ext4_blockdev *bdev)
 {
-	/*blockdev_unlock: skeleton*/
-	return EOK;
+	/*blockdev_unlock: serialize usb exchanges*/
+	return pthread_mutex_unlock(&usb_lock);
 }
 
 /******************************************************************************/
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2016 Duo Jia (jiaduo@syberos.com)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _LARGEFILE64_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include <ext4_config.h>
+#include <ext4_types.h>
+#include <ext4_blockdev.h>
+#include <ext4_super.h>
+#include <ext4_errno.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "imagedev.h"
+
+#define EXT4_IMAGEDEV_BSIZE 512
+
+/**@brief   Dump file name.*/
+static const char *fname = "image.bin";
+
+/**@brief   Dump file descriptor.*/
+static int dev_fd = -1;
+
+/**@brief   Dump statistics. Reads are pread based and may run
+ *          concurrently, the zero fill counters are locked.*/
+static struct ext4_imagedev_stats stats;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**********************BLOCKDEV INTERFACE**************************************/
+static int imagedev_open(struct ext4_blockdev *bdev);
+static int imagedev_bread(struct ext4_blockdev *bdev, void *buf, uint64_t blk_id,
+			 uint32_t blk_cnt);
+static int imagedev_bwrite(struct ext4_blockdev *bdev, const void *buf,
+			  uint64_t blk_id, uint32_t blk_cnt);
+static int imagedev_close(struct ext4_blockdev *bdev);
+
+/******************************************************************************/
+EXT4_BLOCKDEV_STATIC_INSTANCE(imagedev, EXT4_IMAGEDEV_BSIZE, 0, imagedev_open,
+			      imagedev_bread, imagedev_bwrite, imagedev_close,
+			      0, 0);
+
+/******************************************************************************/
+static int imagedev_open(struct ext4_blockdev *bdev)
+{
+	struct stat st;
+	struct ext4_sblock sb;
+	uint64_t fs_size;
+
+	dev_fd = open(fname, O_RDONLY);
+	if (dev_fd < 0)
+		return EIO;
+
+	if (fstat(dev_fd, &st) ||
+	    pread(dev_fd, &sb, sizeof(sb), EXT4_SUPERBLOCK_OFFSET) != sizeof(sb)) {
+		close(dev_fd);
+		dev_fd = -1;
+		return EIO;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	stats.image_size = st.st_size;
+	stats.dev_size = st.st_size;
+
+	/*The superblock knows the real partition size.*/
+	if (ext4_get16(&sb, magic) == EXT4_SUPERBLOCK_MAGIC) {
+		fs_size = ext4_sb_get_blocks_cnt(&sb) *
+			  ext4_sb_get_block_size(&sb);
+		if (fs_size > stats.dev_size)
+			stats.dev_size = fs_size;
+	}
+
+	imagedev.part_offset = 0;
+	imagedev.part_size = stats.dev_size;
+	imagedev.bdif->ph_bcnt = stats.dev_size / imagedev.bdif->ph_bsize;
+
+	return EOK;
+}
+
+/******************************************************************************/
+static int imagedev_bread(struct ext4_blockdev *bdev, void *buf, uint64_t blk_id,
+			 uint32_t blk_cnt)
+{
+	uint64_t off = blk_id * bdev->bdif->ph_bsize;
+	uint64_t len = (uint64_t)blk_cnt * bdev->bdif->ph_bsize;
+	uint64_t avail = 0;
+	uint64_t zero;
+	ssize_t r;
+
+	if (off < stats.image_size)
+		avail = stats.image_size - off;
+	if (avail > len)
+		avail = len;
+
+	while (avail) {
+		r = pread(dev_fd, buf, avail, off);
+		if (r <= 0)
+			return EIO;
+
+		buf = (char *)buf + r;
+		off += r;
+		len -= r;
+		avail -= r;
+	}
+
+	if (!len)
+		return EOK;
+
+	/*Past the end of the dump.*/
+	memset(buf, 0, len);
+
+	zero = (len + bdev->bdif->ph_bsize - 1) / bdev->bdif->ph_bsize;
+	pthread_mutex_lock(&stats_lock);
+	stats.zero_blocks += zero;
+	if (bdev->bdif->bread_meta) {
+		if (!stats.zero_meta_blocks)
+			stats.first_zero_meta = off / bdev->bdif->ph_bsize;
+		stats.zero_meta_blocks += zero;
+	}
+	pthread_mutex_unlock(&stats_lock);
+
+	return EOK;
+}
+
+/******************************************************************************/
+static int imagedev_bwrite(struct ext4_blockdev *bdev, const void *buf,
+			  uint64_t blk_id, uint32_t blk_cnt)
+{
+	/*Dumps are evidence, never modify them.*/
+	return EROFS;
+}
+
+/******************************************************************************/
+static int imagedev_close(struct ext4_blockdev *bdev)
+{
+	close(dev_fd);
+	dev_fd = -1;
+	return EOK;
+}
+
+/******************************************************************************/
+struct ext4_blockdev *ext4_imagedev_get(void)
+{
+	return &imagedev;
+}
+
+void ext4_imagedev_filename(const char *n)
+{
+	fname = n;
+}
+
+void ext4_imagedev_stats(struct ext4_imagedev_stats *st)
+{
+	pthread_mutex_lock(&stats_lock);
+	*st = stats;
+	pthread_mutex_unlock(&stats_lock);
+}
+/******************************************************************************/
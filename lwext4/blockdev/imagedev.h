@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2016 Duo Jia (jiaduo@syberos.com)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IMAGEDEV_H_
+#define IMAGEDEV_H_
+
+#include <ext4_config.h>
+#include <ext4_blockdev.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**@brief   Partition dump statistics.*/
+struct ext4_imagedev_stats {
+	/**@brief   Bytes present in the dump file.*/
+	uint64_t image_size;
+
+	/**@brief   Device size claimed by the superblock (bytes).*/
+	uint64_t dev_size;
+
+	/**@brief   Physical blocks served as zeros (past the dump end).*/
+	uint64_t zero_blocks;
+
+	/**@brief   Of those, blocks read as filesystem metadata.*/
+	uint64_t zero_meta_blocks;
+
+	/**@brief   First metadata physical block served as zeros.*/
+	uint64_t first_zero_meta;
+};
+
+/**@brief   Read only blockdev over a (possibly truncated) partition dump.
+ *          The device size is taken from the ext4 superblock, blocks past
+ *          the end of the dump read as zeros.*/
+struct ext4_blockdev *ext4_imagedev_get(void);
+
+/**@brief   Set the dump file name (before mount).*/
+void ext4_imagedev_filename(const char *n);
+
+/**@brief   Get dump statistics.*/
+void ext4_imagedev_stats(struct ext4_imagedev_stats *st);
+
+#endif /* IMAGEDEV_H_ */
@@ -35,6 +35,8 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 /**@brief   Default filename.*/
 static const char *fname = "ext2";
@@ -42,8 +44,9 @@ static const char *fname = "ext2";
 /**@brief   Image block size.*/
 #define EXT4_FILEDEV_BSIZE 512
 
-/**@brief   Image file descriptor.*/
-static FILE *dev_file;
+/**@brief   Image file descriptor. Positional I/O only, so concurrent
+ *          readers need no device lock.*/
+static int dev_fd = -1;
 
 #define DROP_LINUXCACHE_BUFFERS 0
 
@@ -62,19 +65,21 @@ EXT4_BLOCKDEV_STATIC_INSTANCE(_filedev, EXT4_FILEDEV_BSIZE, 0, filedev_open,
 /******************************************************************************/
 static int filedev_open(struct ext4_blockdev *bdev)
 {
-	dev_file = fopen(fname, "r+b");
+	off_t size;
 
-	if (!dev_file)
+	dev_fd = open(fname, O_RDWR);
+	if (dev_fd < 0)
 		return EIO;
 
-	/*No buffering at file.*/
-	setbuf(dev_file, 0);
-
-	if (fseeko(dev_file, 0, SEEK_END))
+	size = lseek(dev_fd, 0, SEEK_END);
+	if (size < 0) {
+		close(dev_fd);
+		dev_fd = -1;
 		return EFAULT;
+	}
 
 	_filedev.part_offset = 0;
-	_filedev.part_size = ftello(dev_file);
+	_filedev.part_size = size;
 	_filedev.bdif->ph_bcnt = _filedev.part_size / _filedev.bdif->ph_bsize;
 
 	return EOK;
@@ -85,12 +90,18 @@ static int filedev_open(struct ext4_blockdev *bdev)
 static int filedev_bread(struct ext4_blockdev *bdev, void *buf, uint64_t blk_id,
 			 uint32_t blk_cnt)
 {
-	if (fseeko(dev_file, blk_id * bdev->bdif->ph_bsize, SEEK_SET))
-		return EIO;
-	if (!blk_cnt)
-		return EOK;
-	if (!fread(buf, bdev->bdif->ph_bsize * blk_cnt, 1, dev_file))
-		return EIO;
+	size_t len = (size_t)bdev->bdif->ph_bsize * blk_cnt;
+	off_t off = blk_id * bdev->bdif->ph_bsize;
+	ssize_t r;
+
+	while (len) {
+		r = pread(dev_fd, buf, len, off);
+		if (r <= 0)
+			return EIO;
+		buf = (uint8_t *)buf + r;
+		off += r;
+		len -= r;
+	}
 
 	return EOK;
 }
@@ -112,12 +123,18 @@ static void drop_cache(void)
 static int filedev_bwrite(struct ext4_blockdev *bdev, const void *buf,
 			  uint64_t blk_id, uint32_t blk_cnt)
 {
-	if (fseeko(dev_file, blk_id * bdev->bdif->ph_bsize, SEEK_SET))
-		return EIO;
-	if (!blk_cnt)
-		return EOK;
-	if (!fwrite(buf, bdev->bdif->ph_bsize * blk_cnt, 1, dev_file))
-		return EIO;
+	size_t len = (size_t)bdev->bdif->ph_bsize * blk_cnt;
+	off_t off = blk_id * bdev->bdif->ph_bsize;
+	ssize_t r;
+
+	while (len) {
+		r = pwrite(dev_fd, buf, len, off);
+		if (r <= 0)
+			return EIO;
+		buf = (const uint8_t *)buf + r;
+		off += r;
+		len -= r;
+	}
 
 	drop_cache();
 	return EOK;
@@ -125,7 +142,8 @@ static int filedev_bwrite(struct ext4_blockdev *bdev, const void *buf,
 /******************************************************************************/
 static int filedev_close(struct ext4_blockdev *bdev)
 {
-	fclose(dev_file);
+	close(dev_fd);
+	dev_fd = -1;
 	return EOK;
 }
 
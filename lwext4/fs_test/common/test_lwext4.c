@@ -41,6 +41,12 @@ static struct ext4_blockdev *bd;
 /**@brief   Block cache handle.*/
 static struct ext4_bcache *bc;
 
+/**@brief   Mount warm-up regions (EXT4_WARMUP_*).*/
+static uint32_t warmup = EXT4_WARMUP_GDT;
+
+/**@brief   Message output, printf unless redirected.*/
+static int (*test_printf)(const char *fmt, ...) = printf;
+
 static char *entry_to_str(uint8_t type)
 {
 	switch (type) {
@@ -66,6 +72,11 @@ static char *entry_to_str(uint8_t type)
 	return "[???]";
 }
 
+void test_lwext4_set_printf(int (*fn)(const char *fmt, ...))
+{
+	test_printf = fn ? fn : printf;
+}
+
 static long int get_ms(void) { return tim_get_ms(); }
 
 static void printf_io_timings(long int diff)
@@ -74,10 +85,10 @@ static void printf_io_timings(long int diff)
 	if (!stats)
 		return;
 
-	printf("io_timings:\n");
-	printf("  io_read: %.3f%%\n", (double)stats->io_read);
-	printf("  io_write: %.3f%%\n", (double)stats->io_write);
-	printf("  io_cpu: %.3f%%\n", (double)stats->cpu);
+	test_printf("io_timings:\n");
+	test_printf("  io_read: %.3f%%\n", (double)stats->io_read);
+	test_printf("  io_write: %.3f%%\n", (double)stats->io_write);
+	test_printf("  io_cpu: %.3f%%\n", (double)stats->cpu);
 }
 
 void test_lwext4_dir_ls(const char *path)
@@ -87,16 +98,19 @@ void test_lwext4_dir_ls(const char *path)
 	const ext4_direntry *de;
 
 #ifdef SPRD_DEBUG
-	printf("ls %s [partition dir]\n", path);
+	test_printf("ls %s [partition dir]\n", path);
 #endif
 
-	ext4_dir_open(&d, path);
+	if (ext4_dir_open(&d, path) != EOK) {
+		test_printf("ext4_dir_open: %s error\n", path);
+		return;
+	}
 	de = ext4_dir_entry_next(&d);
 
 	while (de) {
 		memcpy(sss, de->name, de->name_length);
 		sss[de->name_length] = 0;
-		printf("  %s%s\n", entry_to_str(de->inode_type), sss);
+		test_printf("  %s%s\n", entry_to_str(de->inode_type), sss);
 		de = ext4_dir_entry_next(&d);
 	}
 	ext4_dir_close(&d);
@@ -107,19 +121,19 @@ void test_lwext4_mp_stats(void)
 	struct ext4_mount_stats stats;
 	ext4_mount_point_stats("/", &stats);
 
-	printf("********************\n");
-	printf("ext4_mount_point_stats\n");
-	printf("inodes_count = %" PRIu32 "\n", stats.inodes_count);
-	printf("free_inodes_count = %" PRIu32 "\n", stats.free_inodes_count);
-	printf("blocks_count = %" PRIu32 "\n", (uint32_t)stats.blocks_count);
-	printf("free_blocks_count = %" PRIu32 "\n",
+	test_printf("********************\n");
+	test_printf("ext4_mount_point_stats\n");
+	test_printf("inodes_count = %" PRIu32 "\n", stats.inodes_count);
+	test_printf("free_inodes_count = %" PRIu32 "\n", stats.free_inodes_count);
+	test_printf("blocks_count = %" PRIu32 "\n", (uint32_t)stats.blocks_count);
+	test_printf("free_blocks_count = %" PRIu32 "\n",
 	       (uint32_t)stats.free_blocks_count);
-	printf("block_size = %" PRIu32 "\n", stats.block_size);
-	printf("block_group_count = %" PRIu32 "\n", stats.block_group_count);
-	printf("blocks_per_group= %" PRIu32 "\n", stats.blocks_per_group);
-	printf("inodes_per_group = %" PRIu32 "\n", stats.inodes_per_group);
-	printf("volume_name = %s\n", stats.volume_name);
-	printf("********************\n");
+	test_printf("block_size = %" PRIu32 "\n", stats.block_size);
+	test_printf("block_group_count = %" PRIu32 "\n", stats.block_group_count);
+	test_printf("blocks_per_group= %" PRIu32 "\n", stats.blocks_per_group);
+	test_printf("inodes_per_group = %" PRIu32 "\n", stats.inodes_per_group);
+	test_printf("volume_name = %s\n", stats.volume_name);
+	test_printf("********************\n");
 }
 
 void test_lwext4_block_stats(void)
@@ -127,18 +141,18 @@ void test_lwext4_block_stats(void)
 	if (!bd)
 		return;
 
-	printf("********************\n");
-	printf("ext4 blockdev stats\n");
-	printf("bdev->bread_ctr = %" PRIu32 "\n", bd->bdif->bread_ctr);
-	printf("bdev->bwrite_ctr = %" PRIu32 "\n", bd->bdif->bwrite_ctr);
+	test_printf("********************\n");
+	test_printf("ext4 blockdev stats\n");
+	test_printf("bdev->bread_ctr = %" PRIu32 "\n", bd->bdif->bread_ctr);
+	test_printf("bdev->bwrite_ctr = %" PRIu32 "\n", bd->bdif->bwrite_ctr);
 
-	printf("bcache->ref_blocks = %" PRIu32 "\n", bd->bc->ref_blocks);
-	printf("bcache->max_ref_blocks = %" PRIu32 "\n", bd->bc->max_ref_blocks);
-	printf("bcache->lru_ctr = %" PRIu32 "\n", bd->bc->lru_ctr);
+	test_printf("bcache->ref_blocks = %" PRIu32 "\n", bd->bc->ref_blocks);
+	test_printf("bcache->max_ref_blocks = %" PRIu32 "\n", bd->bc->max_ref_blocks);
+	test_printf("bcache->lru_ctr = %" PRIu32 "\n", bd->bc->lru_ctr);
 
-	printf("\n");
+	test_printf("\n");
 
-	printf("********************\n");
+	test_printf("********************\n");
 }
 
 bool test_lwext4_dir_test(int len)
@@ -151,23 +165,23 @@ bool test_lwext4_dir_test(int len)
 	long int stop;
 	long int start;
 
-	printf("test_lwext4_dir_test: %d\n", len);
+	test_printf("test_lwext4_dir_test: %d\n", len);
 	io_timings_clear();
 	start = get_ms();
 
-	printf("directory create: /dir1\n");
+	test_printf("directory create: /dir1\n");
 	r = ext4_dir_mk("/dir1");
 	if (r != EOK) {
-		printf("ext4_dir_mk: rc = %d\n", r);
+		test_printf("ext4_dir_mk: rc = %d\n", r);
 		return false;
 	}
 
-	printf("add files to: /dir1\n");
+	test_printf("add files to: /dir1\n");
 	for (i = 0; i < len; ++i) {
 		sprintf(path, "/dir1/f%d", i);
 		r = ext4_fopen(&f, path, "wb");
 		if (r != EOK) {
-			printf("ext4_fopen: rc = %d\n", r);
+			test_printf("ext4_fopen: rc = %d\n", r);
 			return false;
 		}
 	}
@@ -175,8 +189,8 @@ bool test_lwext4_dir_test(int len)
 	stop = get_ms();
 	diff = stop - start;
 	test_lwext4_dir_ls("/dir1");
-	printf("test_lwext4_dir_test: time: %d ms\n", (int)diff);
-	printf("test_lwext4_dir_test: av: %d ms/entry\n", (int)diff / (len + 1));
+	test_printf("test_lwext4_dir_test: time: %d ms\n", (int)diff);
+	test_printf("test_lwext4_dir_test: av: %d ms/entry\n", (int)diff / (len + 1));
 	printf_io_timings(diff);
 	return true;
 }
@@ -205,9 +219,9 @@ bool test_lwext4_file_test(uint8_t *rw_buff, uint32_t rw_size, uint32_t rw_count
 
 	ext4_file f;
 
-	printf("file_test:\n");
-	printf("  rw size: %" PRIu32 "\n", rw_size);
-	printf("  rw count: %" PRIu32 "\n", rw_count);
+	test_printf("file_test:\n");
+	test_printf("  rw size: %" PRIu32 "\n", rw_size);
+	test_printf("  rw count: %" PRIu32 "\n", rw_count);
 
 	/*Add hello world file.*/
 	r = ext4_fopen(&f, "/hello.txt", "wb");
@@ -218,11 +232,11 @@ bool test_lwext4_file_test(uint8_t *rw_buff, uint32_t rw_size, uint32_t rw_count
 	start = get_ms();
 	r = ext4_fopen(&f, "/test1", "wb");
 	if (r != EOK) {
-		printf("ext4_fopen ERROR = %d\n", r);
+		test_printf("ext4_fopen ERROR = %d\n", r);
 		return false;
 	}
 
-	printf("ext4_write: %" PRIu32 " * %" PRIu32 " ...\n", rw_size,
+	test_printf("ext4_write: %" PRIu32 " * %" PRIu32 " ...\n", rw_size,
 	       rw_count);
 	for (i = 0; i < rw_count; ++i) {
 
@@ -235,7 +249,7 @@ bool test_lwext4_file_test(uint8_t *rw_buff, uint32_t rw_size, uint32_t rw_count
 	}
 
 	if (i != rw_count) {
-		printf("  file_test: rw_count = %" PRIu32 "\n", i);
+		test_printf("  file_test: rw_count = %" PRIu32 "\n", i);
 		return false;
 	}
 
@@ -244,8 +258,8 @@ bool test_lwext4_file_test(uint8_t *rw_buff, uint32_t rw_size, uint32_t rw_count
 	size_bytes = rw_size * rw_count;
 	size_bytes = (size_bytes * 1000) / 1024;
 	kbps = (size_bytes) / (diff + 1);
-	printf("  write time: %d ms\n", (int)diff);
-	printf("  write speed: %" PRIu32 " KB/s\n", kbps);
+	test_printf("  write time: %d ms\n", (int)diff);
+	test_printf("  write speed: %" PRIu32 " KB/s\n", kbps);
 	printf_io_timings(diff);
 	r = ext4_fclose(&f);
 
@@ -253,11 +267,11 @@ bool test_lwext4_file_test(uint8_t *rw_buff, uint32_t rw_size, uint32_t rw_count
 	start = get_ms();
 	r = ext4_fopen(&f, "/test1", "r+");
 	if (r != EOK) {
-		printf("ext4_fopen ERROR = %d\n", r);
+		test_printf("ext4_fopen ERROR = %d\n", r);
 		return false;
 	}
 
-	printf("ext4_read: %" PRIu32 " * %" PRIu32 " ...\n", rw_size, rw_count);
+	test_printf("ext4_read: %" PRIu32 " * %" PRIu32 " ...\n", rw_size, rw_count);
 
 	for (i = 0; i < rw_count; ++i) {
 		r = ext4_fread(&f, rw_buff, rw_size, &size);
@@ -270,7 +284,7 @@ bool test_lwext4_file_test(uint8_t *rw_buff, uint32_t rw_size, uint32_t rw_count
 	}
 
 	if (i != rw_count) {
-		printf("  file_test: rw_count = %" PRIu32 "\n", i);
+		test_printf("  file_test: rw_count = %" PRIu32 "\n", i);
 		return false;
 	}
 
@@ -279,8 +293,8 @@ bool test_lwext4_file_test(uint8_t *rw_buff, uint32_t rw_size, uint32_t rw_count
 	size_bytes = rw_size * rw_count;
 	size_bytes = (size_bytes * 1000) / 1024;
 	kbps = (size_bytes) / (diff + 1);
-	printf("  read time: %d ms\n", (int)diff);
-	printf("  read speed: %d KB/s\n", (int)kbps);
+	test_printf("  read time: %d ms\n", (int)diff);
+	test_printf("  read speed: %d KB/s\n", (int)kbps);
 	printf_io_timings(diff);
 
 	r = ext4_fclose(&f);
@@ -293,31 +307,36 @@ void test_lwext4_cleanup(void)
 	long int diff;
 	int r;
 
-	printf("\ncleanup:\n");
+	test_printf("\ncleanup:\n");
 	r = ext4_fremove("/hello.txt");
 	if (r != EOK && r != ENOENT) {
-		printf("ext4_fremove error: rc = %d\n", r);
+		test_printf("ext4_fremove error: rc = %d\n", r);
 	}
 
-	printf("remove /test1\n");
+	test_printf("remove /test1\n");
 	r = ext4_fremove("/test1");
 	if (r != EOK && r != ENOENT) {
-		printf("ext4_fremove error: rc = %d\n", r);
+		test_printf("ext4_fremove error: rc = %d\n", r);
 	}
 
-	printf("remove /dir1\n");
+	test_printf("remove /dir1\n");
 	io_timings_clear();
 	start = get_ms();
 	r = ext4_dir_rm("/dir1");
 	if (r != EOK && r != ENOENT) {
-		printf("ext4_fremove ext4_dir_rm: rc = %d\n", r);
+		test_printf("ext4_fremove ext4_dir_rm: rc = %d\n", r);
 	}
 	stop = get_ms();
 	diff = stop - start;
-	printf("cleanup: time: %d ms\n", (int)diff);
+	test_printf("cleanup: time: %d ms\n", (int)diff);
 	printf_io_timings(diff);
 }
 
+void test_lwext4_mount_warmup(uint32_t flags)
+{
+	warmup = flags;
+}
+
 bool test_lwext4_mount(struct ext4_blockdev *bdev, struct ext4_bcache *bcache)
 {
 	int r;
@@ -326,7 +345,7 @@ bool test_lwext4_mount(struct ext4_blockdev *bdev, struct ext4_bcache *bcache)
 	bd = bdev;
 
 	if (!bd) {
-		printf("test_lwext4_mount: no block device\n");
+		test_printf("test_lwext4_mount: no block device\n");
 		return false;
 	}
 #ifdef SPRD_DEBUG
@@ -335,25 +354,33 @@ bool test_lwext4_mount(struct ext4_blockdev *bdev, struct ext4_bcache *bcache)
 
 	r = ext4_device_register(bd, bc ? bc : 0, "ext4_fs");
 	if (r != EOK) {
-		printf("ext4_device_register: rc = %d\n", r);
+		test_printf("ext4_device_register: rc = %d\n", r);
 		return false;
 	}
 
 	r = ext4_mount("ext4_fs", "/", true);
 	if (r != EOK) {
-		printf("ext4_mount: rc = %d\n", r);
+		test_printf("ext4_mount: rc = %d\n", r);
 		return false;
 	}
 
+	/* only a cache fill, a failure here is not fatal */
+	if (warmup) {
+		r = ext4_mount_warmup("/", warmup);
+		if (r != EOK)
+			test_printf("warning:ext4_mount_warmup: rc = %d\n", r);
+	}
+
+	/* read only mount: an unreadable journal (e.g. beyond the end of
+	 * a truncated dump) leaves the last checkpointed state */
 	r = ext4_recover("/");
 	if (r != EOK && r != ENOTSUP) {
-		printf("ext4_recover: rc = %d\n", r);
-		return false;
+		test_printf("warning:ext4_recover: rc = %d,journal not replayed\n", r);
 	}
 
 	r = ext4_journal_start("/");
 	if (r != EOK) {
-		printf("ext4_journal_start: rc = %d\n", r);
+		test_printf("ext4_journal_start: rc = %d\n", r);
 		return false;
 	}
 
@@ -369,13 +396,13 @@ bool test_lwext4_umount(void)
 
 	r = ext4_journal_stop("/");
 	if (r != EOK) {
-		printf("ext4_journal_stop: fail %d", r);
+		test_printf("ext4_journal_stop: fail %d", r);
 		return false;
 	}
 
 	r = ext4_umount("/");
 	if (r != EOK) {
-		printf("ext4_umount: fail %d", r);
+		test_printf("ext4_umount: fail %d", r);
 		return false;
 	}
 	return true;
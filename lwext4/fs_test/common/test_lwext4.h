@@ -33,6 +33,9 @@
 #include <stdbool.h>
 #include <ext4.h>
 
+/**@brief   Redirect the messages of these tests (NULL: printf).*/
+void test_lwext4_set_printf(int (*fn)(const char *fmt, ...));
+
 void test_lwext4_dir_ls(const char *path);
 void test_lwext4_mp_stats(void);
 void test_lwext4_block_stats(void);
@@ -40,6 +43,7 @@ bool test_lwext4_dir_test(int len);
 bool test_lwext4_file_test(uint8_t *rw_buff, uint32_t rw_size, uint32_t rw_count);
 void test_lwext4_cleanup(void);
 
+void test_lwext4_mount_warmup(uint32_t flags);
 bool test_lwext4_mount(struct ext4_blockdev *bdev, struct ext4_bcache *bcache);
 bool test_lwext4_umount(void);
 
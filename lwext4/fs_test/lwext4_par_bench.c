@@ -0,0 +1,242 @@
+/*
+ * Parallel read benchmark: mounts an ext4 image read only, collects every
+ * regular file and streams them all with 1..N threads sharing the mount
+ * point (CONFIG_THREAD_SAFE_READ). An optional per request latency makes
+ * the image behave like a slow (usb) device, where the win is overlapping
+ * the round trips rather than spreading the cpu work.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <ext4.h>
+#include <ext4_blockdev.h>
+#include <ext4_filedev.h>
+
+/**@brief   Bounce buffer of each worker.*/
+#define BENCH_STREAM_SIZE (256u * 1024u)
+
+#define BENCH_MAX_JOBS 64
+
+static const char *mp_name = "/mp/";
+
+static char **files;
+static uint32_t files_cnt;
+static uint32_t files_cap;
+
+/**@brief   Next file to read, shared by the workers.*/
+static uint32_t next_file;
+
+static uint32_t latency_us;
+static int (*dev_bread)(struct ext4_blockdev *bdev, void *buf, uint64_t blk_id,
+			uint32_t blk_cnt);
+
+struct bench_job {
+	pthread_t thread;
+	uint64_t bytes;
+	uint32_t files;
+	int err;
+};
+
+static uint64_t get_ns(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/**@brief   Image read with an artificial request latency.*/
+static int slow_bread(struct ext4_blockdev *bdev, void *buf, uint64_t blk_id,
+		      uint32_t blk_cnt)
+{
+	usleep(latency_us);
+	return dev_bread(bdev, buf, blk_id, blk_cnt);
+}
+
+static int null_sink(void *arg, const void *buf, size_t len)
+{
+	return 0;
+}
+
+static bool add_file(const char *path)
+{
+	if (files_cnt == files_cap) {
+		uint32_t cap = files_cap ? files_cap * 2 : 256;
+		char **n = realloc(files, cap * sizeof(char *));
+		if (!n)
+			return false;
+		files = n;
+		files_cap = cap;
+	}
+	files[files_cnt] = strdup(path);
+	return files[files_cnt++] != NULL;
+}
+
+static bool collect(const char *path)
+{
+	char sub[1024];
+	const ext4_direntry *de;
+	ext4_dir d;
+
+	if (ext4_dir_open(&d, path) != EOK)
+		return false;
+
+	while ((de = ext4_dir_entry_next(&d)) != NULL) {
+		if (!strcmp((char *)de->name, ".") ||
+		    !strcmp((char *)de->name, ".."))
+			continue;
+
+		snprintf(sub, sizeof(sub), "%s%.*s", path, de->name_length,
+			 (char *)de->name);
+		if (de->inode_type == EXT4_DE_DIR) {
+			strncat(sub, "/", sizeof(sub) - strlen(sub) - 1);
+			if (!collect(sub))
+				break;
+		} else if (de->inode_type == EXT4_DE_REG_FILE) {
+			if (!add_file(sub))
+				break;
+		}
+	}
+	ext4_dir_close(&d);
+	return true;
+}
+
+static void *worker(void *arg)
+{
+	struct bench_job *job = arg;
+	uint64_t cnt;
+	uint32_t i;
+	ext4_file f;
+	void *buf = malloc(BENCH_STREAM_SIZE);
+
+	if (!buf) {
+		job->err = ENOMEM;
+		return NULL;
+	}
+
+	while ((i = __atomic_fetch_add(&next_file, 1, __ATOMIC_RELAXED)) <
+	       files_cnt) {
+		job->err = ext4_fopen(&f, files[i], "rb");
+		if (job->err != EOK)
+			break;
+
+		job->err = ext4_fstream(&f, ext4_fsize(&f), buf,
+					BENCH_STREAM_SIZE, null_sink, NULL,
+					&cnt);
+		ext4_fclose(&f);
+		if (job->err != EOK)
+			break;
+
+		job->bytes += cnt;
+		job->files++;
+	}
+
+	free(buf);
+	return NULL;
+}
+
+static bool run(uint32_t jobs, double *mbs)
+{
+	struct bench_job job[BENCH_MAX_JOBS];
+	uint64_t start, diff, bytes = 0;
+	uint32_t i, nfiles = 0;
+	bool ok = true;
+
+	memset(job, 0, sizeof(job));
+	next_file = 0;
+
+	start = get_ns();
+	for (i = 0; i < jobs; i++)
+		pthread_create(&job[i].thread, NULL, worker, &job[i]);
+	for (i = 0; i < jobs; i++) {
+		pthread_join(job[i].thread, NULL);
+		bytes += job[i].bytes;
+		nfiles += job[i].files;
+		if (job[i].err != EOK)
+			ok = false;
+	}
+	diff = get_ns() - start + 1;
+
+	*mbs = (double)bytes * 1000.0 / diff;
+	printf("  %-8" PRIu32 "%10" PRIu32 "%14" PRIu64 "%12.1f MB/s", jobs,
+	       nfiles, bytes, *mbs);
+	return ok && nfiles == files_cnt;
+}
+
+int main(int argc, char **argv)
+{
+	struct ext4_blockdev *bd;
+	uint32_t jobs[16] = {1, 2, 4, 8};
+	uint32_t njobs = 4;
+	double mbs, base = 0;
+	bool ok = true;
+	uint32_t i;
+	int c, r;
+
+	while ((c = getopt(argc, argv, "l:")) != -1) {
+		if (c == 'l') {
+			latency_us = strtoul(optarg, NULL, 0);
+			continue;
+		}
+		goto Usage;
+	}
+	if (optind >= argc)
+		goto Usage;
+
+	if (optind + 1 < argc) {
+		for (njobs = 0; optind + 1 + njobs < argc && njobs < 16; njobs++)
+			jobs[njobs] = strtoul(argv[optind + 1 + njobs], NULL, 0);
+	}
+	for (i = 0; i < njobs; i++)
+		if (!jobs[i] || jobs[i] > BENCH_MAX_JOBS)
+			goto Usage;
+
+	ext4_filedev_filename(argv[optind]);
+	bd = ext4_filedev_get();
+	if (latency_us) {
+		dev_bread = bd->bdif->bread;
+		bd->bdif->bread = slow_bread;
+	}
+
+	r = ext4_device_register(bd, 0, "ext4_fs");
+	if (r == EOK)
+		r = ext4_mount("ext4_fs", mp_name, true);
+	if (r != EOK) {
+		printf("mount error: %d\n", r);
+		return EXIT_FAILURE;
+	}
+
+	if (!collect(mp_name) || !files_cnt) {
+		printf("no regular files found\n");
+		ext4_umount(mp_name);
+		return EXIT_FAILURE;
+	}
+
+	printf("parallel read, %" PRIu32 " files, latency %" PRIu32 " us:\n",
+	       files_cnt, latency_us);
+	printf("  %-8s%10s%14s%17s%10s\n", "jobs", "files", "bytes",
+	       "throughput", "scaling");
+	for (i = 0; i < njobs; i++) {
+		if (!run(jobs[i], &mbs))
+			ok = false;
+		if (!i)
+			base = mbs;
+		printf("%9.2fx%s\n", mbs / base, ok ? "" : " ERROR");
+	}
+
+	ext4_umount(mp_name);
+	for (i = 0; i < files_cnt; i++)
+		free(files[i]);
+	free(files);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+
+Usage:
+	printf("usage: %s [-l latency_us] image [jobs ...]\n", argv[0]);
+	return EXIT_FAILURE;
+}
@@ -84,6 +84,12 @@ typedef struct ext4_file {
 
 	/**@brief   File position*/
 	uint64_t fpos;
+
+	/**@brief   Extent status cache: last resolved extent.*/
+	uint32_t es_lblk;
+	uint32_t es_len;
+	uint64_t es_pblk;
+	uint32_t es_gen;
 } ext4_file;
 
 /*****************************DIRECTORY DESCRIPTOR***************************/
@@ -131,6 +137,22 @@ int ext4_mount(const char *dev_name,
 	       const char *mount_point,
 	       bool read_only);
 
+/**@brief   Mount warm-up: group descriptor table (the superblock next to
+ *          it is read by the mount itself).*/
+#define EXT4_WARMUP_GDT 0x01
+
+/**@brief   Mount warm-up: head of the group 0 inode table (root, journal
+ *          and the first inodes of the filesystem).*/
+#define EXT4_WARMUP_ITABLE 0x02
+
+/**@brief   Pull the metadata every mount touches first into the block
+ *          cache with one large device request per region, instead of a
+ *          small request per block. Call it right after @ref ext4_mount.
+ * @param   mount_point mount point name
+ * @param   flags EXT4_WARMUP_* regions
+ * @return  standard error code */
+int ext4_mount_warmup(const char *mount_point, uint32_t flags);
+
 /**@brief   Umount operation.
  * @param   mount_point mount name
  * @return  standard error code */
@@ -156,7 +178,9 @@ int ext4_journal_start(const char *mount_point);
  * @return  standard error code */
 int ext4_journal_stop(const char *mount_point);
 
-/**@brief   Journal recovery.
+/**@brief   Journal recovery. On a read only mount committed transactions
+ *          are replayed into an in-memory overlay of the block device
+ *          instead, the device is never written.
  * @param   mount_point mount point
  * @warning Must be called after @ref ext4_mount
  * @return standard error code */
@@ -184,7 +208,10 @@ struct ext4_mount_stats {
 int ext4_mount_point_stats(const char *mount_point,
 			   struct ext4_mount_stats *stats);
 
-/**@brief   Setup OS lock routines.
+/**@brief   Setup OS lock routines. Not needed for a read only mount
+ *          shared by several threads when CONFIG_THREAD_SAFE_READ is
+ *          set: each thread uses its own file/dir handles, block cache
+ *          shards and dentry cache lock themselves.
  * @param   mount_point mount path
  * @param   locks - lock and unlock functions
  * @return  standard error code */
@@ -294,6 +321,18 @@ int ext4_fclose(ext4_file *f);
 int ext4_fill_raw_inode(const char *path, uint32_t *ret_ino,
 			struct ext4_inode *inode);
 
+/**@brief   Read a batch of inodes with few device requests. Inodes missing
+ *          in the inode cache are sorted by inode table block, each run
+ *          of neighbouring table blocks is fetched with one direct read
+ *          and the inodes are decoded from memory (and cached).
+ * @param   mount_point mount point name
+ * @param   ino inode numbers
+ * @param   cnt number of inodes
+ * @param   inodes output, inodes[i] is inode ino[i] (NULL: only cache)
+ * @return  standard error code*/
+int ext4_inodes_prefetch(const char *mount_point, const uint32_t *ino,
+			 uint32_t cnt, struct ext4_inode *inodes);
+
 /**@brief   File truncate function.
  * @param   f file handle
  * @param   new file size
@@ -308,6 +347,35 @@ int ext4_ftruncate(ext4_file *f, uint64_t size);
  * @return  standard error code*/
 int ext4_fread(ext4_file *f, void *buf, size_t size, size_t *rcnt);
 
+/**@brief   Stream file data to a sink, one physical extent at a time.
+ *          Each contiguous run is fetched with a single direct read of up
+ *          to bufsize bytes, holes are zero filled. Starts at the current
+ *          file position and advances it.
+ * @param   f file handle
+ * @param   length bytes to stream (clamped to the file size)
+ * @param   buf bounce buffer, at least one filesystem block
+ * @param   bufsize bounce buffer size
+ * @param   sink consumer of the data (must not reenter this mount point),
+ *          a non zero return value stops the stream and is returned
+ * @param   arg sink argument
+ * @param   scnt bytes streamed (may be NULL)
+ * @return  standard error code*/
+int ext4_fstream(ext4_file *f, uint64_t length, void *buf, size_t bufsize,
+		 int (*sink)(void *arg, const void *data, size_t len),
+		 void *arg, uint64_t *scnt);
+
+/**@brief   Map file data at the current position to the block device.
+ *          Lets a caller copy a run straight from the device (image file)
+ *          instead of reading it through the filesystem.
+ * @param   f file handle
+ * @param   dev_off byte offset of the run on the block device interface,
+ *          0 for a hole (reads as zeros)
+ * @param   len run length (bytes), contiguous on the device and clamped
+ *          to the file size, 0 at end of file
+ * @return  standard error code, ENOTSUP if the data is not a plain
+ *          device range (inline symlink, journal read overlay)*/
+int ext4_fmap(ext4_file *f, uint64_t *dev_off, uint64_t *len);
+
 /**@brief   Write data to file.
  * @param   f file handle
  * @param   buf data to write
@@ -48,6 +48,10 @@ extern "C" {
 #include "misc/tree.h"
 #include "misc/queue.h"
 
+#if CONFIG_THREAD_SAFE_READ
+#include <pthread.h>
+#endif
+
 #define EXT4_BLOCK_ZERO() 	\
 	{.lb_id = 0, .data = 0}
 
@@ -146,8 +150,21 @@ struct ext4_bcache {
 
 	/**@brief   A singly-linked list holding dirty buffers*/
 	SLIST_HEAD(ext4_buf_dirty, ext4_buf) dirty_list;
+
+#if CONFIG_THREAD_SAFE_READ
+	/**@brief   Cache (shard) lock, recursive*/
+	pthread_mutex_t lock;
+#endif
 };
 
+#if CONFIG_THREAD_SAFE_READ
+#define ext4_bcache_lock(bc) pthread_mutex_lock(&(bc)->lock)
+#define ext4_bcache_unlock(bc) pthread_mutex_unlock(&(bc)->lock)
+#else
+#define ext4_bcache_lock(bc)
+#define ext4_bcache_unlock(bc)
+#endif
+
 /**@brief buffer state bits
  *
  *  - BC♡UPTODATE: Buffer contains valid data.
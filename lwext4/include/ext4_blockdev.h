@@ -97,6 +97,23 @@ struct ext4_blockdev_iface {
 
 	/**@brief   Physical write counter*/
 	uint32_t bwrite_ctr;
+
+	/**@brief   Set while a block cache (metadata) read is in progress.
+	 *          Approximate with concurrent readers.*/
+	bool bread_meta;
+};
+
+/**@brief   Read overlay block. Logical block image shadowing the device
+ *          contents (replayed journal data on a read only mount).*/
+struct ext4_overlay_block {
+	/**@brief   Byte offset of the block on the device interface.*/
+	uint64_t off;
+
+	/**@brief   Overlay tree node.*/
+	RB_ENTRY(ext4_overlay_block) node;
+
+	/**@brief   Block data (lg_bsize bytes).*/
+	uint8_t data[];
 };
 
 /**@brief   Definition of the simple block device.*/
@@ -110,9 +127,12 @@ struct ext4_blockdev {
 	/**@brief Part size in bdif. For multi partition mode.*/
 	uint64_t part_size;
 
-	/**@brief   Block cache.*/
+	/**@brief   Block cache (array of bc_shards caches).*/
 	struct ext4_bcache *bc;
 
+	/**@brief   Block cache shard count.*/
+	uint32_t bc_shards;
+
 	/**@brief   Block size (bytes) logical*/
 	uint32_t lg_bsize;
 
@@ -125,6 +145,9 @@ struct ext4_blockdev {
 	/**@brief   The filesystem this block device belongs to. */
 	struct ext4_fs *fs;
 
+	/**@brief   Read overlay, never written to the device.*/
+	RB_HEAD(ext4_overlay, ext4_overlay_block) overlay;
+
 	void *journal;
 };
 
@@ -162,6 +185,32 @@ int ext4_block_init(struct ext4_blockdev *bdev);
  * @return  standard error code*/
 int ext4_block_bind_bcache(struct ext4_blockdev *bdev, struct ext4_bcache *bc);
 
+/**@brief   Binds an array of bcache shards to block device. Block lba
+ *          is cached in shard lba % cnt.
+ * @param   bdev block device descriptor
+ * @param   bc block cache array
+ * @param   cnt shard count
+ * @return  standard error code*/
+int ext4_block_bind_bcache_shards(struct ext4_blockdev *bdev,
+				  struct ext4_bcache *bc, uint32_t cnt);
+
+/**@brief   Block cache (shard) of given lba.
+ * @param   bdev block device descriptor
+ * @param   lba logical block address
+ * @return  block cache*/
+static inline struct ext4_bcache *ext4_block_bcache(struct ext4_blockdev *bdev,
+						    uint64_t lba)
+{
+	return bdev->bc + (bdev->bc_shards > 1 ? lba % bdev->bc_shards : 0);
+}
+
+/**@brief   Invalidate cached blocks of the lba range in every shard.
+ * @param   bdev block device descriptor
+ * @param   from first logical block address
+ * @param   cnt block count*/
+void ext4_block_invalidate_lba(struct ext4_blockdev *bdev, uint64_t from,
+			       uint32_t cnt);
+
 /**@brief   Close block device
  * @param   bdev block device descriptor
  * @return  standard error code*/
@@ -202,12 +251,41 @@ int ext4_block_get_noread(struct ext4_blockdev *bdev, struct ext4_block *b,
 int ext4_block_get(struct ext4_blockdev *bdev, struct ext4_block *b,
 		   uint64_t lba);
 
+/**@brief   Read a run of blocks with a single device request and put
+ *          them into the block cache, so later gets of these blocks don't
+ *          touch the device. The run is clipped to half of the cache.
+ * @param   bdev block device descriptor
+ * @param   lba first logical block address
+ * @param   cnt block count
+ * @return  standard error code*/
+int ext4_block_prefetch(struct ext4_blockdev *bdev, uint64_t lba,
+			uint32_t cnt);
+
 /**@brief   Block set procedure (through cache).
  * @param   bdev block device descriptor
  * @param   b block descriptor
  * @return  standard error code*/
 int ext4_block_set(struct ext4_blockdev *bdev, struct ext4_block *b);
 
+/**@brief   Put a block image into the read overlay. Subsequent reads of
+ *          this block return the overlay copy, the device is not touched.
+ * @param   bdev block device descriptor
+ * @param   lba logical block id
+ * @param   data block data (lg_bsize bytes)
+ * @return  standard error code*/
+int ext4_block_overlay_set(struct ext4_blockdev *bdev, uint64_t lba,
+			   const void *data);
+
+/**@brief   Get the overlay copy of a block.
+ * @param   bdev block device descriptor
+ * @param   lba logical block id
+ * @return  overlay data, NULL if the block is not in the overlay*/
+uint8_t *ext4_block_overlay_get(struct ext4_blockdev *bdev, uint64_t lba);
+
+/**@brief   Drop the read overlay of the block device.
+ * @param   bdev block device descriptor*/
+void ext4_block_overlay_drop(struct ext4_blockdev *bdev);
+
 /**@brief   Block read procedure (without cache)
  * @param   bdev block device descriptor
  * @param   buf output buffer
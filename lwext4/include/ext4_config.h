@@ -123,6 +123,29 @@ extern "C" {
 #define CONFIG_BLOCK_DEV_CACHE_SIZE 8
 #endif
 
+/**@brief   Thread safe read path. Block cache shards and the dentry cache
+ *          are locked (pthreads), so a read only mount may be used by
+ *          several threads without mount point locks.*/
+#ifndef CONFIG_THREAD_SAFE_READ
+#define CONFIG_THREAD_SAFE_READ 0
+#endif
+
+/**@brief   Block cache shards, each holding CONFIG_BLOCK_DEV_CACHE_SIZE
+ *          blocks. Blocks are spread over shards by their address.*/
+#ifndef CONFIG_BCACHE_SHARDS
+#define CONFIG_BCACHE_SHARDS 1
+#endif
+
+/**@brief   Dentry cache size (entries per mount point, 0 - disabled).*/
+#ifndef CONFIG_DCACHE_DENTRIES
+#define CONFIG_DCACHE_DENTRIES 1024
+#endif
+
+/**@brief   Inode cache size (inodes per mount point, 0 - disabled).*/
+#ifndef CONFIG_DCACHE_INODES
+#define CONFIG_DCACHE_INODES 256
+#endif
+
 /**@brief   Maximum block device count*/
 #ifndef CONFIG_EXT4_BLOCKDEVS_COUNT
 #define CONFIG_EXT4_BLOCKDEVS_COUNT 2
@@ -145,6 +168,11 @@ extern "C" {
 #endif
 
 
+/**@brief Use cpu crc32c instructions (SSE4.2, ARMv8 CRC) when present*/
+#ifndef CONFIG_CRC32C_HW
+#define CONFIG_CRC32C_HW 1
+#endif
+
 /**@brief Unaligned access switch on/off*/
 #ifndef CONFIG_UNALIGNED_ACCESS
 #define CONFIG_UNALIGNED_ACCESS 0
@@ -46,6 +46,13 @@ extern "C" {
 #include "ext4_config.h"
 
 #include <stdint.h>
+#include <stdbool.h>
+
+/**@brief	CRC32/CRC32C implementation descriptor.*/
+struct ext4_crc32_impl {
+	const char *name;
+	uint32_t (*crc)(uint32_t crc, const void *buf, uint32_t size);
+};
 
 /**@brief	CRC32 algorithm.
  * @param	crc input feed
@@ -61,6 +68,23 @@ uint32_t ext4_crc32(uint32_t crc, const void *buf, uint32_t size);
  * @return	updated crc32c value*/
 uint32_t ext4_crc32c(uint32_t crc, const void *buf, uint32_t size);
 
+/**@brief	CRC32C of a buffer with a hole hashed as zero bytes. Lets a
+ *		checksum field be skipped without clearing it in place.
+ * @param	crc input feed
+ * @param 	buf input buffer
+ * @param	size input buffer length (bytes)
+ * @param	hole hole offset (bytes)
+ * @param	hole_len hole length (bytes, at most 8)
+ * @return	updated crc32c value*/
+uint32_t ext4_crc32c_hole(uint32_t crc, const void *buf, uint32_t size,
+			  uint32_t hole, uint32_t hole_len);
+
+/**@brief	Implementations usable on this cpu (benchmarks, self tests).
+ * @param	castagnoli true for CRC32C, false for CRC32
+ * @param	cnt output number of implementations
+ * @return	implementation table, ext4_crc32(c) uses the fastest one*/
+const struct ext4_crc32_impl *ext4_crc32_impls(bool castagnoli, uint32_t *cnt);
+
 #ifdef __cplusplus
 }
 #endif
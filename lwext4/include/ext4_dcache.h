@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2016 Duo Jia (jiaduo@syberos.com)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup lwext4
+ * @{
+ */
+/**
+ * @file  ext4_dcache.h
+ * @brief Directory entry (parent inode + name -> inode) and inode caches.
+ */
+
+#ifndef EXT4_DCACHE_H_
+#define EXT4_DCACHE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ext4_config.h"
+#include "ext4_types.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if CONFIG_THREAD_SAFE_READ
+#include <pthread.h>
+#endif
+
+/**@brief   Associativity of both caches.*/
+#define EXT4_DCACHE_WAYS 4
+
+/**@brief   Cached directory entry.*/
+struct ext4_dcache_dentry {
+	/**@brief   Parent directory inode (0 - free slot).*/
+	uint32_t parent;
+
+	/**@brief   Inode the name resolves to.*/
+	uint32_t ino;
+
+	/**@brief   Inode mode type (EXT4_INODE_MODE_*).*/
+	uint32_t imode;
+
+	/**@brief   LRU id.*/
+	uint32_t lru_id;
+
+	uint8_t name_len;
+	char name[EXT4_DIRECTORY_FILENAME_LEN];
+};
+
+/**@brief   Cached decoded inode.*/
+struct ext4_dcache_inode {
+	/**@brief   Inode number (0 - free slot).*/
+	uint32_t ino;
+
+	/**@brief   LRU id.*/
+	uint32_t lru_id;
+
+	struct ext4_inode inode;
+};
+
+/**@brief   Per mount point dentry & inode cache.*/
+struct ext4_dcache {
+	struct ext4_dcache_dentry *dentries;
+	struct ext4_dcache_inode *inodes;
+
+	/**@brief   Slot counts (multiple of EXT4_DCACHE_WAYS, 0 - disabled).*/
+	uint32_t dentry_cnt;
+	uint32_t inode_cnt;
+
+	/**@brief   LRU counter.*/
+	uint32_t lru_ctr;
+
+	/**@brief   Statistics.*/
+	uint32_t dentry_hits;
+	uint32_t dentry_misses;
+	uint32_t inode_hits;
+	uint32_t inode_misses;
+
+#if CONFIG_THREAD_SAFE_READ
+	pthread_mutex_t lock;
+#endif
+};
+
+/**@brief   Allocate the caches. On failure the cache stays disabled.
+ * @param   dc dcache descriptor
+ * @param   dentry_cnt dentry slots (rounded down to a power of two)
+ * @param   inode_cnt inode slots (rounded down to a power of two)
+ * @return  standard error code*/
+int ext4_dcache_init(struct ext4_dcache *dc, uint32_t dentry_cnt,
+		     uint32_t inode_cnt);
+
+/**@brief   Free the caches.
+ * @param   dc dcache descriptor*/
+void ext4_dcache_fini(struct ext4_dcache *dc);
+
+/**@brief   Drop all cached entries (any write to the mount point).
+ * @param   dc dcache descriptor*/
+void ext4_dcache_invalidate(struct ext4_dcache *dc);
+
+/**@brief   Lookup a directory entry.
+ * @param   dc dcache descriptor
+ * @param   parent parent directory inode
+ * @param   name entry name
+ * @param   len entry name length
+ * @param   ino output inode number
+ * @param   imode output inode mode type
+ * @return  true if found*/
+bool ext4_dcache_lookup(struct ext4_dcache *dc, uint32_t parent,
+			const char *name, uint32_t len, uint32_t *ino,
+			uint32_t *imode);
+
+/**@brief   Insert a directory entry.
+ * @param   dc dcache descriptor
+ * @param   parent parent directory inode
+ * @param   name entry name
+ * @param   len entry name length
+ * @param   ino inode number
+ * @param   imode inode mode type*/
+void ext4_dcache_add(struct ext4_dcache *dc, uint32_t parent,
+		     const char *name, uint32_t len, uint32_t ino,
+		     uint32_t imode);
+
+/**@brief   Lookup a decoded inode.
+ * @param   dc dcache descriptor
+ * @param   ino inode number
+ * @param   inode output copy of the cached inode
+ * @return  true if found*/
+bool ext4_dcache_inode_get(struct ext4_dcache *dc, uint32_t ino,
+			   struct ext4_inode *inode);
+
+/**@brief   Insert a decoded inode.
+ * @param   dc dcache descriptor
+ * @param   ino inode number
+ * @param   inode inode to copy
+ * @param   size valid bytes of inode (on disk inode size)*/
+void ext4_dcache_inode_add(struct ext4_dcache *dc, uint32_t ino,
+			   const struct ext4_inode *inode, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EXT4_DCACHE_H_ */
+
+/**
+ * @}
+ */
@@ -116,6 +116,7 @@ int jbd_inode_bmap(struct jbd_fs *jbd_fs,
 		   ext4_lblk_t iblock,
 		   ext4_fsblk_t *fblock);
 int jbd_recover(struct jbd_fs *jbd_fs);
+int jbd_recover_overlay(struct jbd_fs *jbd_fs);
 int jbd_journal_start(struct jbd_fs *jbd_fs,
 		      struct jbd_journal *journal);
 int jbd_journal_stop(struct jbd_journal *journal);
@@ -4,3 +4,6 @@
 #define CONFIG_HAVE_OWN_ASSERT 0
 #define CONFIG_BLOCK_DEV_CACHE_SIZE 16
 #define CONFIG_JOURNALING_ENABLE 0
+#define CONFIG_THREAD_SAFE_READ 1
+#define CONFIG_BCACHE_SHARDS 16
+#define CONFIG_USE_USER_MALLOC 1
@@ -52,6 +52,8 @@
 #include "ext4_dir_idx.h"
 #include "ext4_xattr.h"
 #include "ext4_journal.h"
+#include "ext4_extent.h"
+#include "ext4_dcache.h"
 
 
 #include <stdlib.h>
@@ -91,6 +93,12 @@ struct ext4_mountpoint {
 
 	struct jbd_fs jbd_fs;
 	struct jbd_journal jbd_journal;
+
+	/**@brief   Dentry & inode cache (dropped on any write).*/
+	struct ext4_dcache dcache;
+
+	/**@brief   Write generation, bumped by every transaction.*/
+	uint32_t wgen;
 };
 
 /**@brief   Block devices descriptor.*/
@@ -342,6 +350,7 @@ int ext4_mount(const char *dev_name, const char *mount_point,
 	int i;
 
 	uint32_t bsize;
+	int shards;
 	struct ext4_blockdev *bd = 0;
 	struct ext4_bcache *bc = 0;
 	struct ext4_mountpoint *mp = 0;
@@ -391,18 +400,29 @@ int ext4_mount(const char *dev_name, const char *mount_point,
 	ext4_block_set_lb_size(bd, bsize);
 
 	mp->cache_dynamic = 0;
+	shards = 1;
 
 	if (!bc) {
-		/*Automatic block cache alloc.*/
+		/*Automatic block cache alloc, one cache per shard.*/
 		mp->cache_dynamic = 1;
-		bc = ext4_malloc(sizeof(struct ext4_bcache));
-
-		r = ext4_bcache_init_dynamic(bc, CONFIG_BLOCK_DEV_CACHE_SIZE,
-					     bsize);
-		if (r != EOK) {
-			ext4_free(bc);
+		shards = CONFIG_BCACHE_SHARDS;
+		bc = ext4_calloc(shards, sizeof(struct ext4_bcache));
+		if (!bc) {
 			ext4_block_fini(bd);
-			return r;
+			return ENOMEM;
+		}
+
+		for (i = 0; i < shards; i++) {
+			r = ext4_bcache_init_dynamic(&bc[i],
+						     CONFIG_BLOCK_DEV_CACHE_SIZE,
+						     bsize);
+			if (r != EOK) {
+				while (i--)
+					ext4_bcache_fini_dynamic(&bc[i]);
+				ext4_free(bc);
+				ext4_block_fini(bd);
+				return r;
+			}
 		}
 	}
 
@@ -410,18 +430,24 @@ int ext4_mount(const char *dev_name, const char *mount_point,
 		return ENOTSUP;
 
 	/*Bind block cache to block device*/
-	r = ext4_block_bind_bcache(bd, bc);
+	r = ext4_block_bind_bcache_shards(bd, bc, shards);
 	if (r != EOK) {
-		ext4_bcache_cleanup(bc);
+		for (i = 0; i < shards; i++)
+			ext4_bcache_cleanup(&bc[i]);
 		ext4_block_fini(bd);
 		if (mp->cache_dynamic) {
-			ext4_bcache_fini_dynamic(bc);
+			for (i = 0; i < shards; i++)
+				ext4_bcache_fini_dynamic(&bc[i]);
 			ext4_free(bc);
 		}
 		return r;
 	}
 	bd->fs = &mp->fs;
 
+	/*Caches are optional, mount works without them.*/
+	ext4_dcache_init(&mp->dcache, CONFIG_DCACHE_DENTRIES,
+			 CONFIG_DCACHE_INODES);
+
 	return r;
 }
 
@@ -447,10 +473,13 @@ int ext4_umount(const char *mount_point)
 		goto Finish;
 
 	mp->mounted = 0;
+	ext4_dcache_fini(&mp->dcache);
 
-	ext4_bcache_cleanup(mp->fs.bdev->bc);
+	for (i = 0; i < (int)mp->fs.bdev->bc_shards; i++)
+		ext4_bcache_cleanup(&mp->fs.bdev->bc[i]);
 	if (mp->cache_dynamic) {
-		ext4_bcache_fini_dynamic(mp->fs.bdev->bc);
+		for (i = 0; i < (int)mp->fs.bdev->bc_shards; i++)
+			ext4_bcache_fini_dynamic(&mp->fs.bdev->bc[i]);
 		ext4_free(mp->fs.bdev->bc);
 	}
 	r = ext4_block_fini(mp->fs.bdev);
@@ -473,6 +502,61 @@ static struct ext4_mountpoint *ext4_get_mount(const char *path)
 	return NULL;
 }
 
+/**@brief   Bytes of the group 0 inode table read by EXT4_WARMUP_ITABLE.*/
+#define EXT4_WARMUP_ITABLE_SIZE (64 * 1024)
+
+int ext4_mount_warmup(const char *mount_point, uint32_t flags)
+{
+	struct ext4_mountpoint *mp = ext4_get_mount(mount_point);
+	struct ext4_block_group_ref bg_ref;
+	struct ext4_sblock *sb;
+	uint64_t first, table;
+	uint32_t bsize, gdt, dsc_per_block;
+	int r = EOK;
+
+	if (!mp)
+		return ENOENT;
+
+	EXT4_MP_LOCK(mp);
+	sb = &mp->fs.sb;
+	bsize = ext4_sb_get_block_size(sb);
+
+	if (flags & EXT4_WARMUP_GDT) {
+		/*The superblock itself is in memory already. Without meta_bg
+		 * the descriptors follow it, with meta_bg only the first
+		 * first_meta_bg blocks do.*/
+		dsc_per_block = bsize / ext4_sb_get_desc_size(sb);
+		gdt = (ext4_block_group_cnt(sb) + dsc_per_block - 1) /
+		      dsc_per_block;
+		if (ext4_sb_feature_incom(sb, EXT4_FINCOM_META_BG) &&
+		    gdt > ext4_sb_first_meta_bg(sb))
+			gdt = ext4_sb_first_meta_bg(sb);
+
+		first = ext4_get32(sb, first_data_block) + 1;
+		r = ext4_block_prefetch(mp->fs.bdev, first, gdt);
+		if (r != EOK)
+			goto Finish;
+	}
+
+	if (flags & EXT4_WARMUP_ITABLE) {
+		r = ext4_fs_get_block_group_ref(&mp->fs, 0, &bg_ref);
+		if (r != EOK)
+			goto Finish;
+		table = ext4_bg_get_inode_table_first_block(bg_ref.block_group,
+							    sb);
+		r = ext4_fs_put_block_group_ref(&bg_ref);
+		if (r != EOK)
+			goto Finish;
+
+		r = ext4_block_prefetch(mp->fs.bdev, table,
+					EXT4_WARMUP_ITABLE_SIZE / bsize);
+	}
+
+Finish:
+	EXT4_MP_UNLOCK(mp);
+	return r;
+}
+
 __unused
 static int __ext4_journal_start(const char *mount_point)
 {
@@ -562,8 +646,15 @@ static int __ext4_recover(const char *mount_point)
 			goto Finish;
 		}
 
-		r = jbd_recover(jbd_fs);
+		/*Read only mount: replay into the block device overlay,
+		 * nothing is written back.*/
+		if (mp->fs.read_only)
+			r = jbd_recover_overlay(jbd_fs);
+		else
+			r = jbd_recover(jbd_fs);
+
 		jbd_put_fs(jbd_fs);
+		ext4_dcache_invalidate(&mp->dcache);
 		ext4_free(jbd_fs);
 	}
 	if (r == EOK && !mp->fs.read_only) {
@@ -657,35 +748,47 @@ int ext4_journal_stop(const char *mount_point __unused)
 	return r;
 }
 
-int ext4_recover(const char *mount_point __unused)
+int ext4_recover(const char *mount_point)
 {
 	int r = EOK;
+	struct ext4_mountpoint *mp = ext4_get_mount(mount_point);
+
+	/*Read only replay does not need journaling support.*/
+	if (mp && mp->fs.read_only)
+		return __ext4_recover(mount_point);
+
 #if CONFIG_JOURNALING_ENABLE
 	r = __ext4_recover(mount_point);
 #endif
 	return r;
 }
 
-static int ext4_trans_start(struct ext4_mountpoint *mp __unused)
+static int ext4_trans_start(struct ext4_mountpoint *mp)
 {
 	int r = EOK;
+	ext4_dcache_invalidate(&mp->dcache);
+	mp->wgen++;
 #if CONFIG_JOURNALING_ENABLE
 	r = __ext4_trans_start(mp);
 #endif
 	return r;
 }
 
-static int ext4_trans_stop(struct ext4_mountpoint *mp __unused)
+static int ext4_trans_stop(struct ext4_mountpoint *mp)
 {
 	int r = EOK;
+	ext4_dcache_invalidate(&mp->dcache);
+	mp->wgen++;
 #if CONFIG_JOURNALING_ENABLE
 	r = __ext4_trans_stop(mp);
 #endif
 	return r;
 }
 
-static void ext4_trans_abort(struct ext4_mountpoint *mp __unused)
+static void ext4_trans_abort(struct ext4_mountpoint *mp)
 {
+	ext4_dcache_invalidate(&mp->dcache);
+	mp->wgen++;
 #if CONFIG_JOURNALING_ENABLE
 	__ext4_trans_abort(mp);
 #endif
@@ -903,6 +1006,155 @@ static int ext4_trunc_dir(struct ext4_mountpoint *mp,
 	return ext4_fs_truncate_inode(dir, 0);
 }
 
+/**@brief   Get a copy of the inode through the inode cache.*/
+static int ext4_cached_inode(struct ext4_mountpoint *mp, uint32_t ino,
+			     struct ext4_inode *inode)
+{
+	int r;
+	struct ext4_inode_ref ref;
+	uint32_t isize = ext4_get16(&mp->fs.sb, inode_size);
+
+	if (ext4_dcache_inode_get(&mp->dcache, ino, inode))
+		return EOK;
+
+	r = ext4_fs_get_inode_ref(&mp->fs, ino, &ref);
+	if (r != EOK)
+		return r;
+
+	if (isize > sizeof(struct ext4_inode))
+		isize = sizeof(struct ext4_inode);
+
+	memset(inode, 0, sizeof(struct ext4_inode));
+	memcpy(inode, ref.inode, isize);
+	ext4_dcache_inode_add(&mp->dcache, ino, inode, isize);
+
+	return ext4_fs_put_inode_ref(&ref);
+}
+
+/**@brief   Resolve one path component through the dentry cache.*/
+static int ext4_cached_lookup(struct ext4_mountpoint *mp, uint32_t dir,
+			      const char *name, uint32_t len, uint32_t *ino,
+			      uint32_t *imode)
+{
+	int r;
+	struct ext4_inode_ref ref;
+	struct ext4_dir_search_result result;
+	struct ext4_inode inode;
+	struct ext4_sblock *const sb = &mp->fs.sb;
+	bool has_type = ext4_sb_feature_incom(sb, EXT4_FINCOM_FILETYPE);
+
+	if (ext4_dcache_lookup(&mp->dcache, dir, name, len, ino, imode))
+		return EOK;
+
+	r = ext4_fs_get_inode_ref(&mp->fs, dir, &ref);
+	if (r != EOK)
+		return r;
+
+	r = ext4_dir_find_entry(&result, &ref, name, len);
+	if (r != EOK) {
+		ext4_dir_destroy_result(&ref, &result);
+		ext4_fs_put_inode_ref(&ref);
+		return r;
+	}
+
+	*ino = ext4_dir_en_get_inode(result.dentry);
+	if (has_type)
+		*imode = ext4_fs_correspond_inode_mode(
+		    ext4_dir_en_get_inode_type(sb, result.dentry));
+
+	ext4_dir_destroy_result(&ref, &result);
+	r = ext4_fs_put_inode_ref(&ref);
+	if (r != EOK)
+		return r;
+
+	if (!has_type) {
+		r = ext4_cached_inode(mp, *ino, &inode);
+		if (r != EOK)
+			return r;
+		*imode = ext4_inode_type(sb, &inode);
+	}
+
+	ext4_dcache_add(&mp->dcache, dir, name, len, *ino, *imode);
+	return EOK;
+}
+
+/**@brief   Read only path walk. Only the components missing in the
+ *          dentry cache (and the goal inode missing in the inode cache)
+ *          touch the block device.*/
+static int ext4_cached_open(struct ext4_mountpoint *mp, ext4_file *f,
+			    const char *path, int ftype,
+			    uint32_t *parent_inode, uint32_t *name_off)
+{
+	bool is_goal = false;
+	uint32_t imode = EXT4_INODE_MODE_DIRECTORY;
+	uint32_t ino = EXT4_INODE_ROOT_INDEX;
+	uint32_t next_inode;
+	struct ext4_inode inode;
+	int r;
+	int len;
+
+	/*Skip mount point*/
+	path += strlen(mp->name);
+
+	if (name_off)
+		*name_off = strlen(mp->name);
+
+	if (parent_inode)
+		*parent_inode = ino;
+
+	while (1) {
+
+		len = ext4_path_check(path, &is_goal);
+		if (!len) {
+			/*If root open was request.*/
+			if (ftype == EXT4_DE_DIR || ftype == EXT4_DE_UNKNOWN)
+				if (is_goal)
+					break;
+
+			return ENOENT;
+		}
+
+		r = ext4_cached_lookup(mp, ino, path, len, &next_inode, &imode);
+		if (r != EOK)
+			return r;
+
+		if (parent_inode)
+			*parent_inode = ino;
+
+		/*If expected file error*/
+		if (imode != EXT4_INODE_MODE_DIRECTORY && !is_goal)
+			return ENOENT;
+
+		if (ftype != EXT4_DE_UNKNOWN && is_goal &&
+		    imode != ext4_fs_correspond_inode_mode(ftype))
+			return ENOENT;
+
+		ino = next_inode;
+		if (is_goal)
+			break;
+
+		path += len + 1;
+
+		if (name_off)
+			*name_off += len + 1;
+	}
+
+	r = ext4_cached_inode(mp, ino, &inode);
+	if (r != EOK)
+		return r;
+
+	f->mp = mp;
+	f->fsize = ext4_inode_get_size(&mp->fs.sb, &inode);
+	f->inode = ino;
+	f->fpos = 0;
+	f->es_len = 0;
+
+	if (f->flags & O_APPEND)
+		f->fpos = f->fsize;
+
+	return EOK;
+}
+
 /*
  * NOTICE: if filetype is equal to EXT4_DIRENTRY_UNKNOWN,
  * any filetype of the target dir entry will be accepted.
@@ -933,6 +1185,11 @@ static int ext4_generic_open2(ext4_file *f, const char *path, int flags,
 		return EROFS;
 
 	f->flags = flags;
+	f->es_len = 0;
+
+	if (!(flags & (O_CREAT | O_TRUNC)))
+		return ext4_cached_open(mp, f, path, ftype, parent_inode,
+					name_off);
 
 	/*Skip mount point*/
 	path += strlen(mp->name);
@@ -1503,7 +1760,6 @@ int ext4_fill_raw_inode(const char *path, uint32_t *ret_ino,
 {
 	int r;
 	ext4_file f;
-	struct ext4_inode_ref inode_ref;
 	struct ext4_mountpoint *mp = ext4_get_mount(path);
 	uint32_t ino;
 
@@ -1521,15 +1777,7 @@ int ext4_fill_raw_inode(const char *path, uint32_t *ret_ino,
 	ino = f.inode;
 	ext4_fclose(&f);
 
-	/*Load parent*/
-	r = ext4_fs_get_inode_ref(&mp->fs, ino, &inode_ref);
-	if (r != EOK) {
-		EXT4_MP_UNLOCK(mp);
-		return r;
-	}
-
-	memcpy(inode, inode_ref.inode, sizeof(struct ext4_inode));
-	ext4_fs_put_inode_ref(&inode_ref);
+	r = ext4_cached_inode(mp, ino, inode);
 	EXT4_MP_UNLOCK(mp);
 
 	if (ret_ino)
@@ -1538,6 +1786,136 @@ int ext4_fill_raw_inode(const char *path, uint32_t *ret_ino,
 	return r;
 }
 
+/**@brief   Largest inode table read of ext4_inodes_prefetch (bytes).*/
+#define EXT4_PREFETCH_RUN (256 * 1024)
+
+/**@brief   Unused inode table bytes worth reading to join two runs into
+ *          one request (a device round trip costs more).*/
+#define EXT4_PREFETCH_GAP (32 * 1024)
+
+struct ext4_prefetch_slot {
+	uint64_t lba;
+	uint32_t off;
+	uint32_t idx;
+};
+
+static int ext4_prefetch_cmp(const void *a, const void *b)
+{
+	const struct ext4_prefetch_slot *sa = a, *sb = b;
+
+	if (sa->lba != sb->lba)
+		return sa->lba < sb->lba ? -1 : 1;
+	return sa->off < sb->off ? -1 : sa->off > sb->off;
+}
+
+int ext4_inodes_prefetch(const char *mount_point, const uint32_t *ino,
+			 uint32_t cnt, struct ext4_inode *inodes)
+{
+	struct ext4_mountpoint *mp = ext4_get_mount(mount_point);
+	struct ext4_prefetch_slot *s = NULL;
+	struct ext4_block_group_ref bg_ref;
+	struct ext4_inode tmp, *out;
+	struct ext4_sblock *sb;
+	uint8_t *buf = NULL, *data;
+	uint64_t table = 0, pos, first, last;
+	uint32_t ipg, isize, bsize, copy, run_max, gap;
+	uint32_t bg, last_bg = UINT32_MAX;
+	uint32_t i, j, k, n = 0;
+	int r = EOK;
+
+	if (!mp)
+		return ENOENT;
+
+	EXT4_MP_LOCK(mp);
+	sb = &mp->fs.sb;
+	ipg = ext4_get32(sb, inodes_per_group);
+	isize = ext4_get16(sb, inode_size);
+	bsize = ext4_sb_get_block_size(sb);
+	copy = isize > sizeof(struct ext4_inode) ? sizeof(struct ext4_inode)
+						 : isize;
+
+	/*A writable mount may hold newer table blocks in the block cache.*/
+	if (!mp->fs.read_only) {
+		for (i = 0; i < cnt && r == EOK; i++)
+			r = ext4_cached_inode(mp, ino[i],
+					      inodes ? &inodes[i] : &tmp);
+		goto Finish;
+	}
+
+	s = ext4_malloc(cnt * sizeof(struct ext4_prefetch_slot));
+	buf = ext4_malloc(EXT4_PREFETCH_RUN);
+	if (!s || !buf) {
+		r = ENOMEM;
+		goto Finish;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		if (!ino[i] || ino[i] > ext4_get32(sb, inodes_count)) {
+			r = EINVAL;
+			goto Finish;
+		}
+		if (ext4_dcache_inode_get(&mp->dcache, ino[i],
+					  inodes ? &inodes[i] : &tmp))
+			continue;
+
+		bg = (ino[i] - 1) / ipg;
+		if (bg != last_bg) {
+			r = ext4_fs_get_block_group_ref(&mp->fs, bg, &bg_ref);
+			if (r != EOK)
+				goto Finish;
+			table = ext4_bg_get_inode_table_first_block(
+			    bg_ref.block_group, sb);
+			r = ext4_fs_put_block_group_ref(&bg_ref);
+			if (r != EOK)
+				goto Finish;
+			last_bg = bg;
+		}
+
+		pos = (uint64_t)((ino[i] - 1) % ipg) * isize;
+		s[n].lba = table + pos / bsize;
+		s[n].off = pos % bsize;
+		s[n].idx = i;
+		n++;
+	}
+	qsort(s, n, sizeof(struct ext4_prefetch_slot), ext4_prefetch_cmp);
+
+	run_max = EXT4_PREFETCH_RUN / bsize;
+	gap = EXT4_PREFETCH_GAP / bsize;
+	for (i = 0; i < n; i = j) {
+		first = last = s[i].lba;
+		for (j = i + 1; j < n; j++) {
+			if (s[j].lba - first >= run_max ||
+			    s[j].lba - last > gap + 1)
+				break;
+			last = s[j].lba;
+		}
+
+		r = ext4_blocks_get_direct(mp->fs.bdev, buf, first,
+					   last - first + 1);
+		if (r != EOK)
+			goto Finish;
+
+		for (k = i; k < j; k++) {
+			/*Journal replay overlay shadows the device.*/
+			data = ext4_block_overlay_get(mp->fs.bdev, s[k].lba);
+			if (!data)
+				data = buf + (s[k].lba - first) * bsize;
+
+			out = inodes ? &inodes[s[k].idx] : &tmp;
+			memset(out, 0, sizeof(struct ext4_inode));
+			memcpy(out, data + s[k].off, copy);
+			ext4_dcache_inode_add(&mp->dcache, ino[s[k].idx], out,
+					      copy);
+		}
+	}
+
+Finish:
+	EXT4_MP_UNLOCK(mp);
+	ext4_free(s);
+	ext4_free(buf);
+	return r;
+}
+
 int ext4_fopen(ext4_file *f, const char *path, const char *flags)
 {
 	struct ext4_mountpoint *mp = ext4_get_mount(path);
@@ -1657,6 +2035,47 @@ int ext4_ftruncate(ext4_file *f, uint64_t size)
 	return r;
 }
 
+/**@brief   Logical to physical block mapping through the extent status
+ *          cache of the file. A hit maps contiguous blocks without walking
+ *          the extent tree; any transaction on the mount point drops it.*/
+static int ext4_file_get_dblk(ext4_file *f, struct ext4_inode_ref *ref,
+			      uint32_t iblock, ext4_fsblk_t *fblock)
+{
+#if CONFIG_EXTENT_ENABLE
+	int r;
+	uint32_t count;
+	struct ext4_sblock *const sb = &f->mp->fs.sb;
+
+	if (f->es_len && f->es_gen == f->mp->wgen &&
+	    iblock >= f->es_lblk && iblock - f->es_lblk < f->es_len) {
+		*fblock = f->es_pblk ? f->es_pblk + (iblock - f->es_lblk) : 0;
+		return EOK;
+	}
+
+	if (!ext4_sb_feature_incom(sb, EXT4_FINCOM_EXTENTS) ||
+	    !ext4_inode_has_flag(ref->inode, EXT4_INODE_FLAG_EXTENTS) ||
+	    !ext4_inode_get_size(sb, ref->inode))
+		return ext4_fs_get_inode_dblk_idx(ref, iblock, fblock, true);
+
+	r = ext4_extent_get_blocks(ref, iblock, UINT32_MAX, fblock, false,
+				   &count);
+	if (r != EOK)
+		return r;
+
+	/*Holes are not cached, only mapped (or unwritten) extents.*/
+	if (count) {
+		f->es_lblk = iblock;
+		f->es_len = count;
+		f->es_pblk = *fblock;
+		f->es_gen = f->mp->wgen;
+	}
+
+	return EOK;
+#else
+	return ext4_fs_get_inode_dblk_idx(ref, iblock, fblock, true);
+#endif
+}
+
 int ext4_fread(ext4_file *f, void *buf, size_t size, size_t *rcnt)
 {
 	uint32_t unalg;
@@ -1731,7 +2150,7 @@ int ext4_fread(ext4_file *f, void *buf, size_t size, size_t *rcnt)
 		if (size > (block_size - unalg))
 			len = block_size - unalg;
 
-		r = ext4_fs_get_inode_dblk_idx(&ref, iblock_idx, &fblock, true);
+		r = ext4_file_get_dblk(f, &ref, iblock_idx, &fblock);
 		if (r != EOK)
 			goto Finish;
 
@@ -1761,8 +2180,7 @@ int ext4_fread(ext4_file *f, void *buf, size_t size, size_t *rcnt)
 	fblock_count = 0;
 	while (size >= block_size) {
 		while (iblock_idx < iblock_last) {
-			r = ext4_fs_get_inode_dblk_idx(&ref, iblock_idx,
-						       &fblock, true);
+			r = ext4_file_get_dblk(f, &ref, iblock_idx, &fblock);
 			if (r != EOK)
 				goto Finish;
 
@@ -1795,7 +2213,7 @@ int ext4_fread(ext4_file *f, void *buf, size_t size, size_t *rcnt)
 
 	if (size) {
 		uint64_t off;
-		r = ext4_fs_get_inode_dblk_idx(&ref, iblock_idx, &fblock, true);
+		r = ext4_file_get_dblk(f, &ref, iblock_idx, &fblock);
 		if (r != EOK)
 			goto Finish;
 
@@ -1816,6 +2234,212 @@ Finish:
 	return r;
 }
 
+int ext4_fstream(ext4_file *f, uint64_t length, void *buf, size_t bufsize,
+		 int (*sink)(void *arg, const void *data, size_t len),
+		 void *arg, uint64_t *scnt)
+{
+	uint32_t block_size;
+	uint32_t buf_blocks;
+	uint32_t iblock;
+	uint32_t unalg;
+	uint32_t run;
+	uint32_t need;
+	size_t len;
+
+	ext4_fsblk_t fblock;
+	ext4_fsblk_t next;
+
+	uint8_t *u8_buf = buf;
+	int r;
+	struct ext4_inode_ref ref;
+
+	ext4_assert(f && f->mp && sink);
+
+	if (f->flags & O_WRONLY)
+		return EPERM;
+
+	if (scnt)
+		*scnt = 0;
+
+	EXT4_MP_LOCK(f->mp);
+
+	struct ext4_fs *const fs = &f->mp->fs;
+	struct ext4_sblock *const sb = &f->mp->fs.sb;
+
+	block_size = ext4_sb_get_block_size(sb);
+	buf_blocks = (uint32_t)(bufsize / block_size);
+	if (!buf_blocks) {
+		EXT4_MP_UNLOCK(f->mp);
+		return EINVAL;
+	}
+
+	r = ext4_fs_get_inode_ref(fs, f->inode, &ref);
+	if (r != EOK) {
+		EXT4_MP_UNLOCK(f->mp);
+		return r;
+	}
+
+	/*Sync file size*/
+	f->fsize = ext4_inode_get_size(sb, ref.inode);
+	if (f->fpos >= f->fsize)
+		length = 0;
+	else if (length > f->fsize - f->fpos)
+		length = f->fsize - f->fpos;
+
+	/*Fast symlink: data lives in the inode itself.*/
+	if (length && ext4_inode_is_type(sb, ref.inode,
+					  EXT4_INODE_MODE_SOFTLINK) &&
+	    f->fsize < sizeof(ref.inode->blocks) &&
+	    !ext4_inode_get_blocks_count(sb, ref.inode)) {
+		len = (size_t)length;
+		memcpy(u8_buf, (char *)ref.inode->blocks + f->fpos, len);
+		r = sink(arg, u8_buf, len);
+		if (r == EOK) {
+			f->fpos += len;
+			if (scnt)
+				*scnt = len;
+		}
+		goto Finish;
+	}
+
+	while (length) {
+		iblock = (uint32_t)(f->fpos / block_size);
+		unalg = (uint32_t)(f->fpos % block_size);
+		need = (uint32_t)((unalg + length + block_size - 1) / block_size);
+		if (need > buf_blocks)
+			need = buf_blocks;
+
+		r = ext4_file_get_dblk(f, &ref, iblock, &fblock);
+		if (r != EOK)
+			goto Finish;
+
+		/*Extend the run: the extent status cache answers in O(1).*/
+		run = 1;
+		while (run < need) {
+			r = ext4_file_get_dblk(f, &ref, iblock + run, &next);
+			if (r != EOK)
+				goto Finish;
+
+			if (fblock ? next != fblock + run : next != 0)
+				break;
+
+			run++;
+		}
+
+		if (fblock) {
+			r = ext4_blocks_get_direct(fs->bdev, u8_buf, fblock, run);
+			if (r != EOK)
+				goto Finish;
+		} else {
+			memset(u8_buf, 0, (size_t)run * block_size);
+		}
+
+		len = (size_t)run * block_size - unalg;
+		if (len > length)
+			len = (size_t)length;
+
+		r = sink(arg, u8_buf + unalg, len);
+		if (r != EOK)
+			goto Finish;
+
+		f->fpos += len;
+		length -= len;
+
+		if (scnt)
+			*scnt += len;
+	}
+
+Finish:
+	ext4_fs_put_inode_ref(&ref);
+	EXT4_MP_UNLOCK(f->mp);
+	return r;
+}
+
+/**@brief   Longest hole reported by one ext4_fmap call (blocks). Holes are
+ *          not in the extent status cache, each block is a tree lookup.*/
+#define EXT4_FMAP_HOLE_MAX 16384
+
+int ext4_fmap(ext4_file *f, uint64_t *dev_off, uint64_t *len)
+{
+	uint32_t block_size;
+	uint32_t iblock;
+	uint32_t unalg;
+	uint64_t blocks;
+	uint64_t run;
+
+	ext4_fsblk_t fblock;
+	ext4_fsblk_t next;
+
+	int r;
+	struct ext4_inode_ref ref;
+
+	ext4_assert(f && f->mp && dev_off && len);
+
+	*dev_off = 0;
+	*len = 0;
+
+	EXT4_MP_LOCK(f->mp);
+
+	struct ext4_fs *const fs = &f->mp->fs;
+	struct ext4_sblock *const sb = &f->mp->fs.sb;
+
+	r = ext4_fs_get_inode_ref(fs, f->inode, &ref);
+	if (r != EOK) {
+		EXT4_MP_UNLOCK(f->mp);
+		return r;
+	}
+
+	/*Sync file size*/
+	f->fsize = ext4_inode_get_size(sb, ref.inode);
+	if (f->fpos >= f->fsize)
+		goto Finish;
+
+	if (!RB_EMPTY(&fs->bdev->overlay) ||
+	    (ext4_inode_is_type(sb, ref.inode, EXT4_INODE_MODE_SOFTLINK) &&
+	     f->fsize < sizeof(ref.inode->blocks) &&
+	     !ext4_inode_get_blocks_count(sb, ref.inode))) {
+		r = ENOTSUP;
+		goto Finish;
+	}
+
+	block_size = ext4_sb_get_block_size(sb);
+	iblock = (uint32_t)(f->fpos / block_size);
+	unalg = (uint32_t)(f->fpos % block_size);
+	blocks = (unalg + f->fsize - f->fpos + block_size - 1) / block_size;
+
+	r = ext4_file_get_dblk(f, &ref, iblock, &fblock);
+	if (r != EOK)
+		goto Finish;
+
+	if (!fblock && blocks > EXT4_FMAP_HOLE_MAX)
+		blocks = EXT4_FMAP_HOLE_MAX;
+
+	/*Extend the run: the extent status cache answers in O(1).*/
+	run = 1;
+	while (run < blocks) {
+		r = ext4_file_get_dblk(f, &ref, iblock + (uint32_t)run, &next);
+		if (r != EOK)
+			goto Finish;
+
+		if (fblock ? next != fblock + run : next != 0)
+			break;
+
+		run++;
+	}
+
+	if (fblock)
+		*dev_off = fblock * block_size + fs->bdev->part_offset + unalg;
+
+	*len = run * block_size - unalg;
+	if (*len > f->fsize - f->fpos)
+		*len = f->fsize - f->fpos;
+
+Finish:
+	ext4_fs_put_inode_ref(&ref);
+	EXT4_MP_UNLOCK(f->mp);
+	return r;
+}
+
 int ext4_fwrite(ext4_file *f, const void *buf, size_t size, size_t *wcnt)
 {
 	uint32_t unalg;
@@ -2650,10 +3274,9 @@ int ext4_listxattr(const char *path, char *list, size_t size, size_t *ret_size)
 
 			list_size += prefix_len + entry->name_len + 1;
 		}
-		if (ret_size)
-			*ret_size = list_size;
-
 	}
+	if (r == EOK && ret_size)
+		*ret_size = list_size;
 	ext4_fs_put_inode_ref(&inode_ref);
 Finish:
 	EXT4_MP_UNLOCK(mp);
@@ -3052,6 +3675,14 @@ const ext4_direntry *ext4_dir_entry_next(ext4_dir *d)
 		goto Finish;
 	}
 
+	/*Empty (or zeroed) directory.*/
+	if (!it.curr) {
+		d->next_off = EXT4_DIR_ENTRY_OFFSET_TERM;
+		ext4_dir_iterator_fini(&it);
+		ext4_fs_put_inode_ref(&dir);
+		goto Finish;
+	}
+
 	memset(&d->de.name, 0, sizeof(d->de.name));
 	name_length = ext4_dir_en_get_name_len(&d->f.mp->fs.sb,
 					       it.curr);
@@ -3064,6 +3695,13 @@ const ext4_direntry *ext4_dir_entry_next(ext4_dir *d)
 	d->de.inode_type = ext4_dir_en_get_inode_type(&d->f.mp->fs.sb,
 						      it.curr);
 
+	/*Listing warms up the dentry cache for the following opens.*/
+	if (ext4_sb_feature_incom(&d->f.mp->fs.sb, EXT4_FINCOM_FILETYPE))
+		ext4_dcache_add(&d->f.mp->dcache, d->f.inode,
+				(const char *)d->de.name, name_length,
+				d->de.inode,
+				ext4_fs_correspond_inode_mode(d->de.inode_type));
+
 	de = &d->de;
 
 	ext4_dir_iterator_next(&it);
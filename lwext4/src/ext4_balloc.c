@@ -223,7 +223,7 @@ int ext4_balloc_free_block(struct ext4_inode_ref *inode_ref, ext4_fsblk_t baddr)
 		ext4_fs_put_block_group_ref(&bg_ref);
 		return rc;
 	}
-	ext4_bcache_invalidate_lba(fs->bdev->bc, baddr, 1);
+	ext4_block_invalidate_lba(fs->bdev, baddr, 1);
 	/* Release block group reference */
 	rc = ext4_fs_put_block_group_ref(&bg_ref);
 
@@ -341,7 +341,7 @@ int ext4_balloc_free_blocks(struct ext4_inode_ref *inode_ref,
 
 	}
 
-	ext4_bcache_invalidate_lba(fs->bdev->bc, first, count);
+	ext4_block_invalidate_lba(fs->bdev, first, count);
 	/*All blocks should be released*/
 	ext4_assert(count == 0);
 
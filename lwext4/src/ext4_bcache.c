@@ -79,6 +79,13 @@ int ext4_bcache_init_dynamic(struct ext4_bcache *bc, uint32_t cnt,
 	bc->ref_blocks = 0;
 	bc->max_ref_blocks = 0;
 
+#if CONFIG_THREAD_SAFE_READ
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&bc->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+#endif
 	return EOK;
 }
 
@@ -93,6 +100,9 @@ void ext4_bcache_cleanup(struct ext4_bcache *bc)
 
 int ext4_bcache_fini_dynamic(struct ext4_bcache *bc)
 {
+#if CONFIG_THREAD_SAFE_READ
+	pthread_mutex_destroy(&bc->lock);
+#endif
 	memset(bc, 0, sizeof(struct ext4_bcache));
 	return EOK;
 }
@@ -196,7 +206,11 @@ void ext4_bcache_invalidate_lba(struct ext4_bcache *bc,
 				uint32_t cnt)
 {
 	uint64_t end = from + cnt - 1;
-	struct ext4_buf *tmp = ext4_buf_lookup(bc, from), *buf;
+	struct ext4_buf key = {
+		.lba = from
+	};
+	/*First cached block of the range, not necessarily @from itself.*/
+	struct ext4_buf *tmp = RB_NFIND(ext4_buf_lba, &bc->lba_root, &key), *buf;
 	RB_FOREACH_FROM(buf, ext4_buf_lba, tmp) {
 		if (buf->lba > end)
 			break;
@@ -47,6 +47,23 @@
 #include <string.h>
 #include <stdlib.h>
 
+#if CONFIG_THREAD_SAFE_READ
+#include <pthread.h>
+
+/**@brief   Guards bdif->ph_bbuf and bdev->cache_write_back, both touched
+ *          by every (read only) file open/read.*/
+static pthread_mutex_t bdev_lock = PTHREAD_MUTEX_INITIALIZER;
+#define ext4_bdev_lock() pthread_mutex_lock(&bdev_lock)
+#define ext4_bdev_unlock() pthread_mutex_unlock(&bdev_lock)
+
+/*pread based interfaces have no lock callback, count atomically.*/
+#define ext4_bdif_ctr_inc(ctr) __atomic_add_fetch(&(ctr), 1, __ATOMIC_RELAXED)
+#else
+#define ext4_bdev_lock()
+#define ext4_bdev_unlock()
+#define ext4_bdif_ctr_inc(ctr) ((ctr)++)
+#endif
+
 static void ext4_bdif_lock(struct ext4_blockdev *bdev)
 {
 	if (!bdev->bdif->lock)
@@ -65,13 +82,61 @@ static void ext4_bdif_unlock(struct ext4_blockdev *bdev)
 	ext4_assert(r == EOK);
 }
 
+static int ext4_overlay_cmp(struct ext4_overlay_block *a,
+			    struct ext4_overlay_block *b)
+{
+	if (a->off > b->off)
+		return 1;
+	else if (a->off < b->off)
+		return -1;
+	return 0;
+}
+
+RB_GENERATE_INTERNAL(ext4_overlay, ext4_overlay_block, node,
+		     ext4_overlay_cmp, static inline)
+
+/**@brief   Copy between an interface buffer and the overlaid blocks
+ *          it intersects.
+ * @param   to_buf true: overlay -> buf (read), false: buf -> overlay*/
+static void ext4_overlay_sync(struct ext4_blockdev *bdev, uint8_t *buf,
+			      uint64_t blk_id, uint32_t blk_cnt, bool to_buf)
+{
+	struct ext4_overlay_block tmp, *ob, *next;
+	uint64_t start = blk_id * bdev->bdif->ph_bsize;
+	uint64_t end = start + (uint64_t)blk_cnt * bdev->bdif->ph_bsize;
+	uint64_t from, to;
+
+	tmp.off = start >= bdev->lg_bsize ? start - bdev->lg_bsize + 1 : 0;
+	next = RB_NFIND(ext4_overlay, &bdev->overlay, &tmp);
+	RB_FOREACH_FROM(ob, ext4_overlay, next) {
+		if (ob->off >= end)
+			break;
+
+		from = ob->off > start ? ob->off : start;
+		to = ob->off + bdev->lg_bsize;
+		if (to > end)
+			to = end;
+
+		if (to_buf)
+			memcpy(buf + (from - start), ob->data + (from - ob->off),
+			       to - from);
+		else
+			memcpy(ob->data + (from - ob->off), buf + (from - start),
+			       to - from);
+	}
+}
+
 static int ext4_bdif_bread(struct ext4_blockdev *bdev, void *buf,
 			   uint64_t blk_id, uint32_t blk_cnt)
 {
 	ext4_bdif_lock(bdev);
 	int r = bdev->bdif->bread(bdev, buf, blk_id, blk_cnt);
-	bdev->bdif->bread_ctr++;
+	ext4_bdif_ctr_inc(bdev->bdif->bread_ctr);
 	ext4_bdif_unlock(bdev);
+
+	if (r == EOK && !RB_EMPTY(&bdev->overlay))
+		ext4_overlay_sync(bdev, buf, blk_id, blk_cnt, true);
+
 	return r;
 }
 
@@ -80,8 +145,13 @@ static int ext4_bdif_bwrite(struct ext4_blockdev *bdev, const void *buf,
 {
 	ext4_bdif_lock(bdev);
 	int r = bdev->bdif->bwrite(bdev, buf, blk_id, blk_cnt);
-	bdev->bdif->bwrite_ctr++;
+	ext4_bdif_ctr_inc(bdev->bdif->bwrite_ctr);
 	ext4_bdif_unlock(bdev);
+
+	/*Keep the overlay coherent with what was just written.*/
+	if (r == EOK && !RB_EMPTY(&bdev->overlay))
+		ext4_overlay_sync(bdev, (uint8_t *)buf, blk_id, blk_cnt, false);
+
 	return r;
 }
 
@@ -111,9 +181,18 @@ int ext4_block_init(struct ext4_blockdev *bdev)
 
 int ext4_block_bind_bcache(struct ext4_blockdev *bdev, struct ext4_bcache *bc)
 {
-	ext4_assert(bdev && bc);
+	return ext4_block_bind_bcache_shards(bdev, bc, 1);
+}
+
+int ext4_block_bind_bcache_shards(struct ext4_blockdev *bdev,
+				  struct ext4_bcache *bc, uint32_t cnt)
+{
+	uint32_t i;
+	ext4_assert(bdev && bc && cnt);
 	bdev->bc = bc;
-	bc->bdev = bdev;
+	bdev->bc_shards = cnt;
+	for (i = 0; i < cnt; i++)
+		bc[i].bdev = bdev;
 	return EOK;
 }
 
@@ -130,6 +209,8 @@ int ext4_block_fini(struct ext4_blockdev *bdev)
 {
 	ext4_assert(bdev);
 
+	ext4_block_overlay_drop(bdev);
+
 	if (!bdev->bdif->ph_refctr)
 		return EOK;
 
@@ -144,7 +225,7 @@ int ext4_block_fini(struct ext4_blockdev *bdev)
 int ext4_block_flush_buf(struct ext4_blockdev *bdev, struct ext4_buf *buf)
 {
 	int r;
-	struct ext4_bcache *bc = bdev->bc;
+	struct ext4_bcache *bc = ext4_block_bcache(bdev, buf->lba);
 
 	if (ext4_bcache_test_flag(buf, BC_DIRTY) &&
 	    ext4_bcache_test_flag(buf, BC_UPTODATE)) {
@@ -175,27 +256,43 @@ int ext4_block_flush_lba(struct ext4_blockdev *bdev, uint64_t lba)
 	int r = EOK;
 	struct ext4_buf *buf;
 	struct ext4_block b;
-	buf = ext4_bcache_find_get(bdev->bc, &b, lba);
+	struct ext4_bcache *bc = ext4_block_bcache(bdev, lba);
+
+	ext4_bcache_lock(bc);
+	buf = ext4_bcache_find_get(bc, &b, lba);
 	if (buf) {
 		r = ext4_block_flush_buf(bdev, buf);
-		ext4_bcache_free(bdev->bc, &b);
+		ext4_bcache_free(bc, &b);
 	}
+	ext4_bcache_unlock(bc);
 	return r;
 }
 
-int ext4_block_cache_shake(struct ext4_blockdev *bdev)
+void ext4_block_invalidate_lba(struct ext4_blockdev *bdev, uint64_t from,
+			       uint32_t cnt)
+{
+	uint32_t i;
+	for (i = 0; i < bdev->bc_shards; i++) {
+		ext4_bcache_lock(&bdev->bc[i]);
+		ext4_bcache_invalidate_lba(&bdev->bc[i], from, cnt);
+		ext4_bcache_unlock(&bdev->bc[i]);
+	}
+}
+
+/**@brief   Make room in one cache shard, called with the shard locked.*/
+static int ext4_block_shard_shake(struct ext4_blockdev *bdev,
+				  struct ext4_bcache *bc)
 {
 	int r = EOK;
 	struct ext4_buf *buf;
-	if (bdev->bc->dont_shake)
+	if (bc->dont_shake)
 		return EOK;
 
-	bdev->bc->dont_shake = true;
+	bc->dont_shake = true;
 
-	while (!RB_EMPTY(&bdev->bc->lru_root) &&
-		ext4_bcache_is_full(bdev->bc)) {
+	while (!RB_EMPTY(&bc->lru_root) && ext4_bcache_is_full(bc)) {
 
-		buf = ext4_buf_lowest_lru(bdev->bc);
+		buf = ext4_buf_lowest_lru(bc);
 		ext4_assert(buf);
 		if (ext4_bcache_test_flag(buf, BC_DIRTY)) {
 			r = ext4_block_flush_buf(bdev, buf);
@@ -204,14 +301,28 @@ int ext4_block_cache_shake(struct ext4_blockdev *bdev)
 
 		}
 
-		ext4_bcache_drop_buf(bdev->bc, buf);
+		ext4_bcache_drop_buf(bc, buf);
 	}
-	bdev->bc->dont_shake = false;
+	bc->dont_shake = false;
 	return r;
 }
 
-int ext4_block_get_noread(struct ext4_blockdev *bdev, struct ext4_block *b,
-			  uint64_t lba)
+int ext4_block_cache_shake(struct ext4_blockdev *bdev)
+{
+	int r = EOK;
+	uint32_t i;
+	for (i = 0; i < bdev->bc_shards && r == EOK; i++) {
+		ext4_bcache_lock(&bdev->bc[i]);
+		r = ext4_block_shard_shake(bdev, &bdev->bc[i]);
+		ext4_bcache_unlock(&bdev->bc[i]);
+	}
+	return r;
+}
+
+/**@brief   ext4_block_get_noread body, called with the shard locked.*/
+static int ext4_block_shard_get(struct ext4_blockdev *bdev,
+				struct ext4_bcache *bc, struct ext4_block *b,
+				uint64_t lba)
 {
 	bool is_new;
 	int r;
@@ -227,11 +338,11 @@ int ext4_block_get_noread(struct ext4_blockdev *bdev, struct ext4_block *b,
 	b->lb_id = lba;
 
 	/*If cache is full we have to (flush and) drop it anyway :(*/
-	r = ext4_block_cache_shake(bdev);
+	r = ext4_block_shard_shake(bdev, bc);
 	if (r != EOK)
 		return r;
 
-	r = ext4_bcache_alloc(bdev->bc, b, &is_new);
+	r = ext4_bcache_alloc(bc, b, &is_new);
 	if (r != EOK)
 		return r;
 
@@ -241,41 +352,194 @@ int ext4_block_get_noread(struct ext4_blockdev *bdev, struct ext4_block *b,
 	return EOK;
 }
 
+int ext4_block_get_noread(struct ext4_blockdev *bdev, struct ext4_block *b,
+			  uint64_t lba)
+{
+	struct ext4_bcache *bc = ext4_block_bcache(bdev, lba);
+	int r;
+
+	ext4_bcache_lock(bc);
+	r = ext4_block_shard_get(bdev, bc, b, lba);
+	ext4_bcache_unlock(bc);
+	return r;
+}
+
 int ext4_block_get(struct ext4_blockdev *bdev, struct ext4_block *b,
 		   uint64_t lba)
 {
-	int r = ext4_block_get_noread(bdev, b, lba);
+	struct ext4_bcache *bc = ext4_block_bcache(bdev, lba);
+	int r;
+
+	/*The shard stays locked over the read, so a concurrent get of the
+	 * same block waits for it instead of seeing a half read buffer.*/
+	ext4_bcache_lock(bc);
+	r = ext4_block_shard_get(bdev, bc, b, lba);
 	if (r != EOK)
-		return r;
+		goto Finish;
 
 	if (ext4_bcache_test_flag(b->buf, BC_UPTODATE)) {
 		/* Data in the cache is up-to-date.
 		 * Reading from physical device is not required */
-		return EOK;
+		goto Finish;
 	}
 
+	bdev->bdif->bread_meta = true;
 	r = ext4_blocks_get_direct(bdev, b->data, lba, 1);
+	bdev->bdif->bread_meta = false;
 	if (r != EOK) {
-		ext4_bcache_free(bdev->bc, b);
+		ext4_bcache_free(bc, b);
 		b->lb_id = 0;
-		return r;
+		goto Finish;
 	}
 
 	/* Mark buffer up-to-date, since
 	 * fresh data is read from physical device just now. */
 	ext4_bcache_set_flag(b->buf, BC_UPTODATE);
-	return EOK;
+Finish:
+	ext4_bcache_unlock(bc);
+	return r;
+}
+
+int ext4_block_prefetch(struct ext4_blockdev *bdev, uint64_t lba,
+			uint32_t cnt)
+{
+	struct ext4_bcache *bc;
+	struct ext4_block b;
+	uint32_t i, max;
+	uint8_t *buf;
+	int r;
+
+	ext4_assert(bdev && bdev->bc);
+
+	if (!bdev->bdif->ph_refctr)
+		return EIO;
+
+	if (lba >= bdev->lg_bcnt)
+		return ENXIO;
+
+	/*Keep the run well inside the cache, otherwise its tail evicts its
+	 * head before anybody asks for it.*/
+	max = bdev->bc_shards * bdev->bc->cnt / 2;
+	if (cnt > max)
+		cnt = max;
+	if (cnt > bdev->lg_bcnt - lba)
+		cnt = (uint32_t)(bdev->lg_bcnt - lba);
+	if (!cnt)
+		return EOK;
+
+	buf = ext4_malloc((size_t)cnt * bdev->lg_bsize);
+	if (!buf)
+		return ENOMEM;
+
+	bdev->bdif->bread_meta = true;
+	r = ext4_blocks_get_direct(bdev, buf, lba, cnt);
+	bdev->bdif->bread_meta = false;
+	if (r != EOK)
+		goto Finish;
+
+	for (i = 0; i < cnt; i++) {
+		/*Block 0 is never cached (lb_id 0 means unused).*/
+		if (!(lba + i))
+			continue;
+
+		bc = ext4_block_bcache(bdev, lba + i);
+		ext4_bcache_lock(bc);
+		r = ext4_block_shard_get(bdev, bc, &b, lba + i);
+		if (r == EOK) {
+			/*Never overwrite a cached (maybe dirty) copy.*/
+			if (!ext4_bcache_test_flag(b.buf, BC_UPTODATE)) {
+				memcpy(b.data, buf + (size_t)i * bdev->lg_bsize,
+				       bdev->lg_bsize);
+				ext4_bcache_set_flag(b.buf, BC_UPTODATE);
+			}
+			r = ext4_bcache_free(bc, &b);
+		}
+		ext4_bcache_unlock(bc);
+		if (r != EOK)
+			break;
+	}
+
+Finish:
+	ext4_free(buf);
+	return r;
 }
 
 int ext4_block_set(struct ext4_blockdev *bdev, struct ext4_block *b)
 {
+	struct ext4_bcache *bc;
+	int r;
+
 	ext4_assert(bdev && b);
 	ext4_assert(b->buf);
 
 	if (!bdev->bdif->ph_refctr)
 		return EIO;
 
-	return ext4_bcache_free(bdev->bc, b);
+	bc = ext4_block_bcache(bdev, b->lb_id);
+	ext4_bcache_lock(bc);
+	r = ext4_bcache_free(bc, b);
+	ext4_bcache_unlock(bc);
+	return r;
+}
+
+int ext4_block_overlay_set(struct ext4_blockdev *bdev, uint64_t lba,
+			   const void *data)
+{
+	struct ext4_overlay_block tmp, *ob;
+	struct ext4_block b;
+
+	ext4_assert(bdev && data);
+
+	if (!(lba < bdev->lg_bcnt))
+		return ENXIO;
+
+	tmp.off = lba * bdev->lg_bsize + bdev->part_offset;
+	ob = RB_FIND(ext4_overlay, &bdev->overlay, &tmp);
+	if (!ob) {
+		ob = ext4_malloc(sizeof(struct ext4_overlay_block) +
+				 bdev->lg_bsize);
+		if (!ob)
+			return ENOMEM;
+
+		ob->off = tmp.off;
+		RB_INSERT(ext4_overlay, &bdev->overlay, ob);
+	}
+	memcpy(ob->data, data, bdev->lg_bsize);
+
+	/*A cached copy is stale now, make the next get read it again.*/
+	if (lba && bdev->bc) {
+		struct ext4_bcache *bc = ext4_block_bcache(bdev, lba);
+
+		ext4_bcache_lock(bc);
+		if (ext4_bcache_find_get(bc, &b, lba)) {
+			if (!ext4_bcache_test_flag(b.buf, BC_DIRTY))
+				ext4_bcache_clear_flag(b.buf, BC_UPTODATE);
+			ext4_bcache_free(bc, &b);
+		}
+		ext4_bcache_unlock(bc);
+	}
+
+	return EOK;
+}
+
+uint8_t *ext4_block_overlay_get(struct ext4_blockdev *bdev, uint64_t lba)
+{
+	struct ext4_overlay_block tmp, *ob;
+
+	tmp.off = lba * bdev->lg_bsize + bdev->part_offset;
+	ob = RB_FIND(ext4_overlay, &bdev->overlay, &tmp);
+	return ob ? ob->data : NULL;
+}
+
+void ext4_block_overlay_drop(struct ext4_blockdev *bdev)
+{
+	struct ext4_overlay_block *ob;
+
+	while (!RB_EMPTY(&bdev->overlay)) {
+		ob = RB_MIN(ext4_overlay, &bdev->overlay);
+		RB_REMOVE(ext4_overlay, &bdev->overlay, ob);
+		ext4_free(ob);
+	}
 }
 
 int ext4_blocks_get_direct(struct ext4_blockdev *bdev, void *buf, uint64_t lba,
@@ -306,8 +570,8 @@ int ext4_blocks_set_direct(struct ext4_blockdev *bdev, const void *buf,
 	return ext4_bdif_bwrite(bdev, buf, pba, pb_cnt * cnt);
 }
 
-int ext4_block_writebytes(struct ext4_blockdev *bdev, uint64_t off,
-			  const void *buf, uint32_t len)
+static int __ext4_block_writebytes(struct ext4_blockdev *bdev, uint64_t off,
+				   const void *buf, uint32_t len)
 {
 	uint64_t block_idx;
 	uint32_t blen;
@@ -374,8 +638,19 @@ int ext4_block_writebytes(struct ext4_blockdev *bdev, uint64_t off,
 	return r;
 }
 
-int ext4_block_readbytes(struct ext4_blockdev *bdev, uint64_t off, void *buf,
-			 uint32_t len)
+int ext4_block_writebytes(struct ext4_blockdev *bdev, uint64_t off,
+			  const void *buf, uint32_t len)
+{
+	int r;
+
+	ext4_bdev_lock();
+	r = __ext4_block_writebytes(bdev, off, buf, len);
+	ext4_bdev_unlock();
+	return r;
+}
+
+static int __ext4_block_readbytes(struct ext4_blockdev *bdev, uint64_t off,
+				  void *buf, uint32_t len)
 {
 	uint64_t block_idx;
 	uint32_t blen;
@@ -437,29 +712,55 @@ int ext4_block_readbytes(struct ext4_blockdev *bdev, uint64_t off, void *buf,
 	return r;
 }
 
+int ext4_block_readbytes(struct ext4_blockdev *bdev, uint64_t off, void *buf,
+			 uint32_t len)
+{
+	int r;
+
+	ext4_bdev_lock();
+	r = __ext4_block_readbytes(bdev, off, buf, len);
+	ext4_bdev_unlock();
+	return r;
+}
+
 int ext4_block_cache_flush(struct ext4_blockdev *bdev)
 {
-	while (!SLIST_EMPTY(&bdev->bc->dirty_list)) {
-		int r;
-		struct ext4_buf *buf = SLIST_FIRST(&bdev->bc->dirty_list);
-		ext4_assert(buf);
-		r = ext4_block_flush_buf(bdev, buf);
-		if (r != EOK)
-			return r;
+	uint32_t i;
+	for (i = 0; i < bdev->bc_shards; i++) {
+		struct ext4_bcache *bc = &bdev->bc[i];
+
+		ext4_bcache_lock(bc);
+		while (!SLIST_EMPTY(&bc->dirty_list)) {
+			int r;
+			struct ext4_buf *buf = SLIST_FIRST(&bc->dirty_list);
+			ext4_assert(buf);
+			r = ext4_block_flush_buf(bdev, buf);
+			if (r != EOK) {
+				ext4_bcache_unlock(bc);
+				return r;
+			}
 
+		}
+		ext4_bcache_unlock(bc);
 	}
 	return EOK;
 }
 
 int ext4_block_cache_write_back(struct ext4_blockdev *bdev, uint8_t on_off)
 {
+	uint32_t write_back;
+
+	ext4_bdev_lock();
 	if (on_off)
 		bdev->cache_write_back++;
 
 	if (!on_off && bdev->cache_write_back)
 		bdev->cache_write_back--;
 
-	if (bdev->cache_write_back)
+	write_back = bdev->cache_write_back;
+	ext4_bdev_unlock();
+
+	if (write_back)
 		return EOK;
 
 	/*Flush data in all delayed cache blocks*/
@@ -44,6 +44,23 @@
 
 #include "ext4_crc32.h"
 
+#if CONFIG_THREAD_SAFE_READ
+#include <pthread.h>
+
+/**@brief   Run a lazy table init exactly once, even with concurrent callers.*/
+#define CRC32_ONCE(name, init)                                                 \
+	do {                                                                   \
+		static pthread_once_t name##_once = PTHREAD_ONCE_INIT;         \
+		pthread_once(&name##_once, init);                              \
+	} while (0)
+#else
+#define CRC32_ONCE(name, init)                                                 \
+	do {                                                                   \
+		if (!name)                                                     \
+			init();                                                \
+	} while (0)
+#endif
+
 static const uint32_t crc32_tab[] = {
 	0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
 	0xe963a535, 0x9e6495a3,	0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
@@ -161,6 +178,12 @@ static const uint32_t crc32c_tab[256] = {
     0x988C474DL, 0x6AE7C44EL, 0xBE2DA0A5L, 0x4C4623A6L, 0x5F16D052L,
     0xAD7D5351L};
 
+/**@brief   Slicing-by-8 tables, derived from the byte tables on first use.*/
+static uint32_t crc32_tab8[8][256];
+static uint32_t crc32c_tab8[8][256];
+static volatile bool crc32_tab8_ready;
+static volatile bool crc32c_tab8_ready;
+
 static inline uint32_t crc32(uint32_t crc, const void *buf, uint32_t size,
 			     const uint32_t *tab)
 {
@@ -172,16 +195,333 @@ static inline uint32_t crc32(uint32_t crc, const void *buf, uint32_t size,
 	return (crc);
 }
 
-uint32_t ext4_crc32(uint32_t crc, const void *buf, uint32_t size)
+static void crc32_slice8_init(uint32_t tab8[][256], const uint32_t *tab)
+{
+	uint32_t i, k;
+
+	for (i = 0; i < 256; i++)
+		tab8[0][i] = tab[i];
+
+	for (k = 1; k < 8; k++)
+		for (i = 0; i < 256; i++)
+			tab8[k][i] = (tab8[k - 1][i] >> 8) ^
+				     tab[tab8[k - 1][i] & 0xFF];
+}
+
+static uint32_t crc32_slice8(uint32_t crc, const void *buf, uint32_t size,
+			     uint32_t tab8[][256])
+{
+	const uint8_t *p = (const uint8_t *)buf;
+	uint32_t lo, hi;
+
+	while (size && ((uintptr_t)p & 7)) {
+		crc = tab8[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+		size--;
+	}
+
+	while (size >= 8) {
+		lo = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+			    (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+		hi = (uint32_t)p[4] | (uint32_t)p[5] << 8 |
+		     (uint32_t)p[6] << 16 | (uint32_t)p[7] << 24;
+		crc = tab8[7][lo & 0xFF] ^ tab8[6][(lo >> 8) & 0xFF] ^
+		      tab8[5][(lo >> 16) & 0xFF] ^ tab8[4][lo >> 24] ^
+		      tab8[3][hi & 0xFF] ^ tab8[2][(hi >> 8) & 0xFF] ^
+		      tab8[1][(hi >> 16) & 0xFF] ^ tab8[0][hi >> 24];
+		p += 8;
+		size -= 8;
+	}
+
+	while (size--)
+		crc = tab8[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+	return crc;
+}
+
+static uint32_t crc32_byte(uint32_t crc, const void *buf, uint32_t size)
 {
 	return crc32(crc, buf, size, crc32_tab);
 }
 
-uint32_t ext4_crc32c(uint32_t crc, const void *buf, uint32_t size)
+static void crc32_tab8_build(void)
+{
+	crc32_slice8_init(crc32_tab8, crc32_tab);
+	crc32_tab8_ready = true;
+}
+
+static uint32_t crc32_sw8(uint32_t crc, const void *buf, uint32_t size)
+{
+	CRC32_ONCE(crc32_tab8_ready, crc32_tab8_build);
+	return crc32_slice8(crc, buf, size, crc32_tab8);
+}
+
+static uint32_t crc32c_byte(uint32_t crc, const void *buf, uint32_t size)
 {
 	return crc32(crc, buf, size, crc32c_tab);
 }
 
+static void crc32c_tab8_build(void)
+{
+	crc32_slice8_init(crc32c_tab8, crc32c_tab);
+	crc32c_tab8_ready = true;
+}
+
+static uint32_t crc32c_sw8(uint32_t crc, const void *buf, uint32_t size)
+{
+	CRC32_ONCE(crc32c_tab8_ready, crc32c_tab8_build);
+	return crc32_slice8(crc, buf, size, crc32c_tab8);
+}
+
+#if CONFIG_CRC32C_HW && defined(__GNUC__) &&                                   \
+    (defined(__x86_64__) || (defined(__aarch64__) && defined(__linux__)))
+#define EXT4_CRC32C_HW 1
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define CRC32C_HW_TARGET __attribute__((target("sse4.2")))
+#define crc32c_hw_u8(c, v) _mm_crc32_u8((c), (v))
+#define crc32c_hw_u64(c, v) _mm_crc32_u64((c), (v))
+#define CRC32C_HW_NAME "sse4.2-3way"
+#else
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define CRC32C_HW_TARGET __attribute__((target("+crc")))
+#define crc32c_hw_u8(c, v) __crc32cb((c), (v))
+#define crc32c_hw_u64(c, v) __crc32cd((c), (v))
+#define CRC32C_HW_NAME "armv8-crc-3way"
+#endif
+
+/* Three independent crc32 streams hide the 3 cycle latency of the
+ * instruction. The streams are joined by shifting the partial crc over
+ * the bytes of the following streams (Mark Adler's crc32c.c).*/
+#define CRC32C_HW_LONG 8192
+#define CRC32C_HW_SHORT 256
+#define CRC32C_POLY 0x82F63B78
+
+static uint32_t crc32c_long[4][256];
+static uint32_t crc32c_short[4][256];
+static volatile bool crc32c_hw_ready;
+
+static uint32_t gf2_matrix_times(const uint32_t *mat, uint32_t vec)
+{
+	uint32_t sum = 0;
+
+	while (vec) {
+		if (vec & 1)
+			sum ^= *mat;
+		vec >>= 1;
+		mat++;
+	}
+	return sum;
+}
+
+static void gf2_matrix_square(uint32_t *square, const uint32_t *mat)
+{
+	int n;
+
+	for (n = 0; n < 32; n++)
+		square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+/**@brief   Build the operator that appends len zero bytes to a crc.*/
+static void crc32c_zeros_op(uint32_t *even, size_t len)
+{
+	int n;
+	uint32_t row = 1;
+	uint32_t odd[32];
+
+	odd[0] = CRC32C_POLY;
+	for (n = 1; n < 32; n++) {
+		odd[n] = row;
+		row <<= 1;
+	}
+
+	gf2_matrix_square(even, odd);
+	gf2_matrix_square(odd, even);
+
+	do {
+		gf2_matrix_square(even, odd);
+		len >>= 1;
+		if (len == 0)
+			return;
+		gf2_matrix_square(odd, even);
+		len >>= 1;
+	} while (len);
+
+	for (n = 0; n < 32; n++)
+		even[n] = odd[n];
+}
+
+static void crc32c_zeros(uint32_t zeros[][256], size_t len)
+{
+	uint32_t n;
+	uint32_t op[32];
+
+	crc32c_zeros_op(op, len);
+	for (n = 0; n < 256; n++) {
+		zeros[0][n] = gf2_matrix_times(op, n);
+		zeros[1][n] = gf2_matrix_times(op, n << 8);
+		zeros[2][n] = gf2_matrix_times(op, n << 16);
+		zeros[3][n] = gf2_matrix_times(op, n << 24);
+	}
+}
+
+static inline uint32_t crc32c_shift(uint32_t zeros[][256], uint32_t crc)
+{
+	return zeros[0][crc & 0xFF] ^ zeros[1][(crc >> 8) & 0xFF] ^
+	       zeros[2][(crc >> 16) & 0xFF] ^ zeros[3][crc >> 24];
+}
+
+static bool crc32c_hw_supported(void)
+{
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse4.2");
+#else
+	return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#endif
+}
+
+static void crc32c_hw_build(void)
+{
+	crc32c_zeros(crc32c_long, CRC32C_HW_LONG);
+	crc32c_zeros(crc32c_short, CRC32C_HW_SHORT);
+	crc32c_hw_ready = true;
+}
+
+CRC32C_HW_TARGET
+static uint32_t crc32c_hw(uint32_t crc, const void *buf, uint32_t size)
+{
+	const uint8_t *next = (const uint8_t *)buf;
+	const uint8_t *end;
+	uint64_t crc0, crc1, crc2;
+
+	CRC32_ONCE(crc32c_hw_ready, crc32c_hw_build);
+
+	crc0 = crc;
+	while (size && ((uintptr_t)next & 7)) {
+		crc0 = crc32c_hw_u8((uint32_t)crc0, *next++);
+		size--;
+	}
+
+	while (size >= CRC32C_HW_LONG * 3) {
+		crc1 = 0;
+		crc2 = 0;
+		end = next + CRC32C_HW_LONG;
+		do {
+			crc0 = crc32c_hw_u64(crc0, *(const uint64_t *)next);
+			crc1 = crc32c_hw_u64(crc1,
+				*(const uint64_t *)(next + CRC32C_HW_LONG));
+			crc2 = crc32c_hw_u64(crc2,
+				*(const uint64_t *)(next + CRC32C_HW_LONG * 2));
+			next += 8;
+		} while (next < end);
+		crc0 = crc32c_shift(crc32c_long, (uint32_t)crc0) ^ crc1;
+		crc0 = crc32c_shift(crc32c_long, (uint32_t)crc0) ^ crc2;
+		next += CRC32C_HW_LONG * 2;
+		size -= CRC32C_HW_LONG * 3;
+	}
+
+	while (size >= CRC32C_HW_SHORT * 3) {
+		crc1 = 0;
+		crc2 = 0;
+		end = next + CRC32C_HW_SHORT;
+		do {
+			crc0 = crc32c_hw_u64(crc0, *(const uint64_t *)next);
+			crc1 = crc32c_hw_u64(crc1,
+				*(const uint64_t *)(next + CRC32C_HW_SHORT));
+			crc2 = crc32c_hw_u64(crc2,
+				*(const uint64_t *)(next + CRC32C_HW_SHORT * 2));
+			next += 8;
+		} while (next < end);
+		crc0 = crc32c_shift(crc32c_short, (uint32_t)crc0) ^ crc1;
+		crc0 = crc32c_shift(crc32c_short, (uint32_t)crc0) ^ crc2;
+		next += CRC32C_HW_SHORT * 2;
+		size -= CRC32C_HW_SHORT * 3;
+	}
+
+	end = next + (size - (size & 7));
+	while (next < end) {
+		crc0 = crc32c_hw_u64(crc0, *(const uint64_t *)next);
+		next += 8;
+	}
+	size &= 7;
+
+	while (size--)
+		crc0 = crc32c_hw_u8((uint32_t)crc0, *next++);
+
+	return (uint32_t)crc0;
+}
+#endif
+
+static const struct ext4_crc32_impl crc32_impls[] = {
+	{"byte", crc32_byte},
+	{"slice8", crc32_sw8},
+};
+
+static const struct ext4_crc32_impl crc32c_impls[] = {
+	{"byte", crc32c_byte},
+	{"slice8", crc32c_sw8},
+#ifdef EXT4_CRC32C_HW
+	{CRC32C_HW_NAME, crc32c_hw},
+#endif
+};
+
+static uint32_t crc32c_resolve(uint32_t crc, const void *buf, uint32_t size);
+
+/**@brief   Fastest crc32c routine of this cpu (selected on first call).*/
+static uint32_t (*crc32c_fn)(uint32_t, const void *, uint32_t) =
+    crc32c_resolve;
+
+static uint32_t crc32c_resolve(uint32_t crc, const void *buf, uint32_t size)
+{
+	crc32c_fn = crc32c_sw8;
+#ifdef EXT4_CRC32C_HW
+	if (crc32c_hw_supported())
+		crc32c_fn = crc32c_hw;
+#endif
+	return crc32c_fn(crc, buf, size);
+}
+
+uint32_t ext4_crc32(uint32_t crc, const void *buf, uint32_t size)
+{
+	return crc32_sw8(crc, buf, size);
+}
+
+uint32_t ext4_crc32c(uint32_t crc, const void *buf, uint32_t size)
+{
+	return crc32c_fn(crc, buf, size);
+}
+
+uint32_t ext4_crc32c_hole(uint32_t crc, const void *buf, uint32_t size,
+			  uint32_t hole, uint32_t hole_len)
+{
+	static const uint8_t zeros[8];
+	const uint8_t *p = buf;
+
+	ext4_assert(hole_len <= sizeof(zeros) && hole + hole_len <= size);
+
+	crc = crc32c_fn(crc, p, hole);
+	crc = crc32c_fn(crc, zeros, hole_len);
+	return crc32c_fn(crc, p + hole + hole_len, size - hole - hole_len);
+}
+
+const struct ext4_crc32_impl *ext4_crc32_impls(bool castagnoli, uint32_t *cnt)
+{
+	if (!castagnoli) {
+		*cnt = sizeof(crc32_impls) / sizeof(crc32_impls[0]);
+		return crc32_impls;
+	}
+
+	*cnt = sizeof(crc32c_impls) / sizeof(crc32c_impls[0]);
+#ifdef EXT4_CRC32C_HW
+	if (!crc32c_hw_supported())
+		(*cnt)--;
+#endif
+	return crc32c_impls;
+}
+
 /**
  * @}
  */
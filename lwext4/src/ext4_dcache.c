@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2016 Duo Jia (jiaduo@syberos.com)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup lwext4
+ * @{
+ */
+/**
+ * @file  ext4_dcache.c
+ * @brief Directory entry (parent inode + name -> inode) and inode caches.
+ */
+
+#include "ext4_config.h"
+#include "ext4_types.h"
+#include "ext4_misc.h"
+#include "ext4_errno.h"
+#include "ext4_debug.h"
+
+#include "ext4_dcache.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#if CONFIG_THREAD_SAFE_READ
+#define ext4_dcache_lock(dc) pthread_mutex_lock(&(dc)->lock)
+#define ext4_dcache_unlock(dc) pthread_mutex_unlock(&(dc)->lock)
+#else
+#define ext4_dcache_lock(dc)
+#define ext4_dcache_unlock(dc)
+#endif
+
+static uint32_t ext4_dcache_pow2(uint32_t cnt)
+{
+	uint32_t p = EXT4_DCACHE_WAYS;
+
+	if (cnt < EXT4_DCACHE_WAYS)
+		return 0;
+
+	while (p * 2 <= cnt)
+		p *= 2;
+	return p;
+}
+
+static uint32_t ext4_dcache_hash(uint32_t parent, const char *name,
+				 uint32_t len)
+{
+	uint32_t h = 2166136261u ^ parent;
+	uint32_t i;
+
+	for (i = 0; i < len; i++) {
+		h ^= (uint8_t)name[i];
+		h *= 16777619u;
+	}
+	return h ^ (h >> 16);
+}
+
+static uint32_t ext4_dcache_ino_hash(uint32_t ino)
+{
+	ino *= 2654435761u;
+	return ino ^ (ino >> 16);
+}
+
+int ext4_dcache_init(struct ext4_dcache *dc, uint32_t dentry_cnt,
+		     uint32_t inode_cnt)
+{
+	memset(dc, 0, sizeof(struct ext4_dcache));
+#if CONFIG_THREAD_SAFE_READ
+	pthread_mutex_init(&dc->lock, NULL);
+#endif
+
+	dentry_cnt = ext4_dcache_pow2(dentry_cnt);
+	inode_cnt = ext4_dcache_pow2(inode_cnt);
+
+	if (dentry_cnt) {
+		dc->dentries = ext4_calloc(dentry_cnt,
+					   sizeof(struct ext4_dcache_dentry));
+		if (!dc->dentries)
+			goto Fail;
+	}
+
+	if (inode_cnt) {
+		dc->inodes = ext4_calloc(inode_cnt,
+					 sizeof(struct ext4_dcache_inode));
+		if (!dc->inodes)
+			goto Fail;
+	}
+
+	dc->dentry_cnt = dentry_cnt;
+	dc->inode_cnt = inode_cnt;
+	return EOK;
+
+Fail:
+	/*Keep the lock, a disabled cache is still used.*/
+	ext4_free(dc->dentries);
+	ext4_free(dc->inodes);
+	dc->dentries = NULL;
+	dc->inodes = NULL;
+	return ENOMEM;
+}
+
+void ext4_dcache_fini(struct ext4_dcache *dc)
+{
+	ext4_free(dc->dentries);
+	ext4_free(dc->inodes);
+#if CONFIG_THREAD_SAFE_READ
+	pthread_mutex_destroy(&dc->lock);
+#endif
+	memset(dc, 0, sizeof(struct ext4_dcache));
+}
+
+void ext4_dcache_invalidate(struct ext4_dcache *dc)
+{
+	uint32_t i;
+
+	ext4_dcache_lock(dc);
+	for (i = 0; i < dc->dentry_cnt; i++)
+		dc->dentries[i].parent = 0;
+
+	for (i = 0; i < dc->inode_cnt; i++)
+		dc->inodes[i].ino = 0;
+	ext4_dcache_unlock(dc);
+}
+
+bool ext4_dcache_lookup(struct ext4_dcache *dc, uint32_t parent,
+			const char *name, uint32_t len, uint32_t *ino,
+			uint32_t *imode)
+{
+	uint32_t i, set;
+	struct ext4_dcache_dentry *de;
+
+	if (!dc->dentry_cnt)
+		return false;
+
+	set = ext4_dcache_hash(parent, name, len) &
+	      (dc->dentry_cnt / EXT4_DCACHE_WAYS - 1);
+	de = dc->dentries + set * EXT4_DCACHE_WAYS;
+
+	ext4_dcache_lock(dc);
+	for (i = 0; i < EXT4_DCACHE_WAYS; i++, de++) {
+		if (de->parent != parent || de->name_len != len)
+			continue;
+		if (memcmp(de->name, name, len))
+			continue;
+
+		de->lru_id = ++dc->lru_ctr;
+		*ino = de->ino;
+		*imode = de->imode;
+		dc->dentry_hits++;
+		ext4_dcache_unlock(dc);
+		return true;
+	}
+
+	dc->dentry_misses++;
+	ext4_dcache_unlock(dc);
+	return false;
+}
+
+void ext4_dcache_add(struct ext4_dcache *dc, uint32_t parent,
+		     const char *name, uint32_t len, uint32_t ino,
+		     uint32_t imode)
+{
+	uint32_t i, set;
+	struct ext4_dcache_dentry *de, *victim;
+
+	if (!dc->dentry_cnt || !parent || len > EXT4_DIRECTORY_FILENAME_LEN)
+		return;
+
+	set = ext4_dcache_hash(parent, name, len) &
+	      (dc->dentry_cnt / EXT4_DCACHE_WAYS - 1);
+	de = dc->dentries + set * EXT4_DCACHE_WAYS;
+	victim = de;
+
+	ext4_dcache_lock(dc);
+	for (i = 0; i < EXT4_DCACHE_WAYS; i++, de++) {
+		if (de->parent == parent && de->name_len == len &&
+		    !memcmp(de->name, name, len)) {
+			victim = de;
+			break;
+		}
+		if (!de->parent) {
+			victim = de;
+			break;
+		}
+		if (de->lru_id < victim->lru_id)
+			victim = de;
+	}
+
+	victim->parent = parent;
+	victim->ino = ino;
+	victim->imode = imode;
+	victim->lru_id = ++dc->lru_ctr;
+	victim->name_len = len;
+	memcpy(victim->name, name, len);
+	ext4_dcache_unlock(dc);
+}
+
+bool ext4_dcache_inode_get(struct ext4_dcache *dc, uint32_t ino,
+			   struct ext4_inode *inode)
+{
+	uint32_t i, set;
+	struct ext4_dcache_inode *ci;
+
+	if (!dc->inode_cnt)
+		return false;
+
+	set = ext4_dcache_ino_hash(ino) & (dc->inode_cnt / EXT4_DCACHE_WAYS - 1);
+	ci = dc->inodes + set * EXT4_DCACHE_WAYS;
+
+	ext4_dcache_lock(dc);
+	for (i = 0; i < EXT4_DCACHE_WAYS; i++, ci++) {
+		if (ci->ino == ino) {
+			ci->lru_id = ++dc->lru_ctr;
+			dc->inode_hits++;
+			memcpy(inode, &ci->inode, sizeof(struct ext4_inode));
+			ext4_dcache_unlock(dc);
+			return true;
+		}
+	}
+
+	dc->inode_misses++;
+	ext4_dcache_unlock(dc);
+	return false;
+}
+
+void ext4_dcache_inode_add(struct ext4_dcache *dc, uint32_t ino,
+			   const struct ext4_inode *inode, uint32_t size)
+{
+	uint32_t i, set;
+	struct ext4_dcache_inode *ci, *victim;
+
+	if (!dc->inode_cnt || !ino)
+		return;
+
+	set = ext4_dcache_ino_hash(ino) & (dc->inode_cnt / EXT4_DCACHE_WAYS - 1);
+	ci = dc->inodes + set * EXT4_DCACHE_WAYS;
+	victim = ci;
+
+	ext4_dcache_lock(dc);
+	for (i = 0; i < EXT4_DCACHE_WAYS; i++, ci++) {
+		if (ci->ino == ino || !ci->ino) {
+			victim = ci;
+			break;
+		}
+		if (ci->lru_id < victim->lru_id)
+			victim = ci;
+	}
+
+	if (size > sizeof(struct ext4_inode))
+		size = sizeof(struct ext4_inode);
+
+	memset(&victim->inode, 0, sizeof(struct ext4_inode));
+	memcpy(&victim->inode, inode, size);
+	victim->ino = ino;
+	victim->lru_id = ++dc->lru_ctr;
+	ext4_dcache_unlock(dc);
+}
+
+/**
+ * @}
+ */
@@ -500,20 +500,20 @@ static uint16_t ext4_fs_bg_checksum(struct ext4_sblock *sb, uint32_t bgid,
 	if (ext4_sb_feature_ro_com(sb, EXT4_FRO_COM_METADATA_CSUM)) {
 		/* Use metadata_csum algorithm instead */
 		uint32_t le32_bgid = to_le32(bgid);
-		uint32_t orig_checksum, checksum;
-
-		/* Preparation: temporarily set bg checksum to 0 */
-		orig_checksum = bg->checksum;
-		bg->checksum = 0;
+		uint32_t checksum;
 
 		/* First calculate crc32 checksum against fs uuid */
 		checksum = ext4_crc32c(EXT4_CRC32_INIT, sb->uuid,
 				sizeof(sb->uuid));
 		/* Then calculate crc32 checksum against bgid */
 		checksum = ext4_crc32c(checksum, &le32_bgid, sizeof(bgid));
-		/* Finally calculate crc32 checksum against block_group_desc */
-		checksum = ext4_crc32c(checksum, bg, ext4_sb_get_desc_size(sb));
-		bg->checksum = orig_checksum;
+		/* Finally calculate crc32 checksum against block_group_desc,
+		 * the checksum field hashed as 0 (the descriptor is shared
+		 * by concurrent readers, it is never modified here) */
+		checksum = ext4_crc32c_hole(checksum, bg,
+				ext4_sb_get_desc_size(sb),
+				offsetof(struct ext4_bgroup, checksum),
+				sizeof(bg->checksum));
 
 		crc = checksum & 0xFFFF;
 		return crc;
@@ -597,6 +597,11 @@ int ext4_fs_get_block_group_ref(struct ext4_fs *fs, uint32_t bgid,
 			 bgid);
 	}
 
+	/*Lazy bitmap init is for the allocator, a read only mount must not
+	 * dirty (and later write back) the descriptors.*/
+	if (fs->read_only)
+		return EOK;
+
 	if (ext4_bg_has_flag(bg, EXT4_BLOCK_GROUP_BLOCK_UNINIT)) {
 		rc = ext4_fs_init_block_bitmap(ref);
 		if (rc != EOK) {
@@ -658,16 +663,15 @@ static uint32_t ext4_fs_inode_checksum(struct ext4_inode_ref *inode_ref)
 	uint16_t inode_size = ext4_get16(sb, inode_size);
 
 	if (ext4_sb_feature_ro_com(sb, EXT4_FRO_COM_METADATA_CSUM)) {
-		uint32_t orig_checksum;
+		uint8_t *raw = (uint8_t *)inode_ref->inode;
+		uint32_t lo = offsetof(struct ext4_inode,
+				       osd2.linux2.checksum_lo);
+		uint32_t hi = offsetof(struct ext4_inode, checksum_hi);
 
 		uint32_t ino_index = to_le32(inode_ref->index);
 		uint32_t ino_gen =
 			to_le32(ext4_inode_get_generation(inode_ref->inode));
 
-		/* Preparation: temporarily set bg checksum to 0 */
-		orig_checksum = ext4_inode_get_csum(sb, inode_ref->inode);
-		ext4_inode_set_csum(sb, inode_ref->inode, 0);
-
 		/* First calculate crc32 checksum against fs uuid */
 		checksum = ext4_crc32c(EXT4_CRC32_INIT, sb->uuid,
 				       sizeof(sb->uuid));
@@ -675,10 +679,17 @@ static uint32_t ext4_fs_inode_checksum(struct ext4_inode_ref *inode_ref)
 		 * and inode generation */
 		checksum = ext4_crc32c(checksum, &ino_index, sizeof(ino_index));
 		checksum = ext4_crc32c(checksum, &ino_gen, sizeof(ino_gen));
-		/* Finally calculate crc32 checksum against
-		 * the entire inode */
-		checksum = ext4_crc32c(checksum, inode_ref->inode, inode_size);
-		ext4_inode_set_csum(sb, inode_ref->inode, orig_checksum);
+		/* Finally calculate crc32 checksum against the entire
+		 * inode, checksum fields hashed as 0 (not cleared in
+		 * place: the inode block may have concurrent readers) */
+		if (inode_size > EXT4_GOOD_OLD_INODE_SIZE) {
+			checksum = ext4_crc32c_hole(checksum, raw, hi, lo, 2);
+			checksum = ext4_crc32c_hole(checksum, raw + hi,
+						    inode_size - hi, 0, 2);
+		} else {
+			checksum = ext4_crc32c_hole(checksum, raw, inode_size,
+						    lo, 2);
+		}
 
 		/* If inode size is not large enough to hold the
 		 * upper 16bit of the checksum */
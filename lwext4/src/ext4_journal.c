@@ -80,6 +80,12 @@ struct recover_info {
 	/**@brief  No of transactions went through.*/
 	uint32_t trans_cnt;
 
+	/**@brief  Replay into the read overlay of the block device.*/
+	bool overlay;
+
+	/**@brief  First overlay error.*/
+	int overlay_err;
+
 	/**@brief  RB-Tree storing revoke entries.*/
 	RB_HEAD(jbd_revoke, revoke_entry) revoke_root;
 };
@@ -464,13 +470,13 @@ int jbd_get_fs(struct ext4_fs *fs,
 	}
 	rc = jbd_sb_read(jbd_fs, &jbd_fs->sb);
 	if (rc != EOK) {
-		memset(jbd_fs, 0, sizeof(struct jbd_fs));
 		ext4_fs_put_inode_ref(&jbd_fs->inode_ref);
+		memset(jbd_fs, 0, sizeof(struct jbd_fs));
 		return rc;
 	}
 	if (!jbd_verify_sb(&jbd_fs->sb)) {
-		memset(jbd_fs, 0, sizeof(struct jbd_fs));
 		ext4_fs_put_inode_ref(&jbd_fs->inode_ref);
+		memset(jbd_fs, 0, sizeof(struct jbd_fs));
 		rc = EIO;
 	}
 
@@ -905,6 +911,23 @@ static void jbd_replay_block_tags(struct jbd_fs *jbd_fs,
 	if (r != EOK)
 		return;
 
+	/* Read only replay: shadow the block in memory, the device
+	 * (superblock included) is never written.*/
+	if (info->overlay) {
+		r = ext4_block_overlay_set(fs->bdev, tag_info->block,
+					   journal_block.data);
+		if (r == EOK && tag_info->is_escape)
+			((struct jbd_bhdr *)ext4_block_overlay_get(fs->bdev,
+					tag_info->block))->magic =
+					to_be32(JBD_MAGIC_NUMBER);
+
+		if (r != EOK && info->overlay_err == EOK)
+			info->overlay_err = r;
+
+		jbd_block_set(jbd_fs, &journal_block);
+		return;
+	}
+
 	/* We need special treatment for ext4 superblock. */
 	if (tag_info->block) {
 		r = ext4_block_get_noread(fs->bdev, &ext4_block, tag_info->block);
@@ -1219,6 +1242,8 @@ int jbd_recover(struct jbd_fs *jbd_fs)
 		return EOK;
 
 	RB_INIT(&info.revoke_root);
+	info.overlay = false;
+	info.overlay_err = EOK;
 
 	r = jbd_iterate_log(jbd_fs, &info, ACTION_SCAN);
 	if (r != EOK)
@@ -1251,6 +1276,53 @@ int jbd_recover(struct jbd_fs *jbd_fs)
 	return r;
 }
 
+/**@brief  Replay journal into the read overlay of the block device.
+ *         Committed transactions become visible to readers, nothing
+ *         is written back (neither the journal nor the filesystem).
+ * @param  jbd_fs jbd filesystem
+ * @return standard error code*/
+int jbd_recover_overlay(struct jbd_fs *jbd_fs)
+{
+	int r;
+	struct recover_info info;
+	struct jbd_sb *sb = &jbd_fs->sb;
+	struct ext4_fs *fs = jbd_fs->inode_ref.fs;
+	if (!sb->start)
+		return EOK;
+
+	RB_INIT(&info.revoke_root);
+	info.overlay = true;
+	info.overlay_err = EOK;
+
+	r = jbd_iterate_log(jbd_fs, &info, ACTION_SCAN);
+	if (r != EOK)
+		return r;
+
+	r = jbd_iterate_log(jbd_fs, &info, ACTION_REVOKE);
+	if (r == EOK)
+		r = jbd_iterate_log(jbd_fs, &info, ACTION_RECOVER);
+
+	if (r == EOK)
+		r = info.overlay_err;
+
+	if (r == EOK) {
+		/* The superblock may have been replayed as well,
+		 * reload it through the overlay. The in memory copy
+		 * does not need recovery any more.*/
+		uint32_t features_incompatible;
+		r = ext4_sb_read(fs->bdev, &fs->sb);
+		if (r == EOK) {
+			features_incompatible =
+				ext4_get32(&fs->sb, features_incompatible);
+			features_incompatible &= ~EXT4_FINCOM_RECOVER;
+			ext4_set32(&fs->sb, features_incompatible,
+				   features_incompatible);
+		}
+	}
+	jbd_destroy_revoke_tree(&info);
+	return r;
+}
+
 static void jbd_journal_write_sb(struct jbd_journal *journal)
 {
 	struct jbd_fs *jbd_fs = journal->jbd_fs;
@@ -1324,7 +1396,8 @@ static void jbd_journal_flush_trans(struct jbd_trans *trans)
 		struct ext4_buf *buf;
 		struct ext4_block block;
 		/* The buffer is not yet flushed. */
-		buf = ext4_bcache_find_get(fs->bdev->bc, &block,
+		buf = ext4_bcache_find_get(ext4_block_bcache(fs->bdev,
+					   jbd_buf->block_rec->lba), &block,
 					   jbd_buf->block_rec->lba);
 		if (!(buf && ext4_bcache_test_flag(buf, BC_UPTODATE) &&
 		      jbd_buf->block_rec->trans == trans)) {
@@ -1338,7 +1411,9 @@ static void jbd_journal_flush_trans(struct jbd_trans *trans)
 			ext4_block_set(fs->bdev, &jbd_block);
 			r = ext4_blocks_set_direct(fs->bdev, tmp_data,
 					jbd_buf->block_rec->lba, 1);
-			jbd_trans_end_write(fs->bdev->bc, buf, r, jbd_buf);
+			jbd_trans_end_write(ext4_block_bcache(fs->bdev,
+					    jbd_buf->block_rec->lba),
+					    buf, r, jbd_buf);
 		} else
 			ext4_block_flush_buf(fs->bdev, buf);
 
@@ -1534,7 +1609,8 @@ jbd_trans_finish_callback(struct jbd_journal *journal,
 				&block_rec->dirty_buf_queue,
 				dirty_buf_node,
 				tmp) {
-			jbd_trans_end_write(fs->bdev->bc,
+			jbd_trans_end_write(ext4_block_bcache(fs->bdev,
+					jbd_buf->block_rec->lba),
 					NULL,
 					EOK,
 					jbd_buf);
@@ -2197,10 +2273,13 @@ static int __jbd_journal_commit_trans(struct jbd_journal *journal,
 			 * ext4_buf::end_write_arg fields so that the checkpoint
 			 * callback won't be triggered again.
 			 */
-			buf = ext4_bcache_find_get(journal->jbd_fs->bdev->bc,
+			struct ext4_bcache *bc = ext4_block_bcache(
+					journal->jbd_fs->bdev,
+					jbd_buf->block_rec->lba);
+			buf = ext4_bcache_find_get(bc,
 					&block,
 					jbd_buf->block_rec->lba);
-			jbd_trans_end_write(journal->jbd_fs->bdev->bc,
+			jbd_trans_end_write(bc,
 					buf,
 					EOK,
 					jbd_buf);
@@ -126,11 +126,6 @@ static uint32_t ext4_xattr_block_checksum(struct ext4_inode_ref *inode_ref,
 	struct ext4_sblock *sb = &inode_ref->fs->sb;
 
 	if (ext4_sb_feature_ro_com(sb, EXT4_FRO_COM_METADATA_CSUM)) {
-		uint32_t orig_checksum;
-
-		/* Preparation: temporarily set bg checksum to 0 */
-		orig_checksum = header->h_checksum;
-		header->h_checksum = 0;
 		/* First calculate crc32 checksum against fs uuid */
 		checksum =
 		    ext4_crc32c(EXT4_CRC32_INIT, sb->uuid, sizeof(sb->uuid));
@@ -138,10 +133,11 @@ static uint32_t ext4_xattr_block_checksum(struct ext4_inode_ref *inode_ref,
 		checksum =
 		    ext4_crc32c(checksum, &le64_blocknr, sizeof(le64_blocknr));
 		/* Finally calculate crc32 checksum against
-		 * the entire xattr block */
-		checksum =
-		    ext4_crc32c(checksum, header, ext4_sb_get_block_size(sb));
-		header->h_checksum = orig_checksum;
+		 * the entire xattr block, h_checksum hashed as 0 */
+		checksum = ext4_crc32c_hole(checksum, header,
+				ext4_sb_get_block_size(sb),
+				offsetof(struct ext4_xattr_header, h_checksum),
+				sizeof(header->h_checksum));
 	}
 	return checksum;
 }
@@ -15,6 +15,10 @@
 //#define SPRD_PID 0x4002 
 
 #define DATA_BUFFER_SIZE 0x400000 //4MB
+#define SPRD_REPLY_SIZE 0x1000 //replies without flash data
+#define SPRD_USB_PACKET 512 //bulk max packet size(high speed)
+#define SPRD_ESCAPE_SIZE(w) ((w)*2 + SPRD_USB_PACKET) //escaped frame of a w bytes window
+#define SPRD_READ_WINDOW 0x3000 //12k,largest READ_FLASH_MIDST request
 
 /* sprd bulk information */
 #define SPRD_INTERFACE	0x00
@@ -34,6 +38,57 @@ void debug_print_hex(uint8_t* str,int length);
 unsigned long get_file_size(const char *path);
 int sprd_usb_transfer(uint8_t* data,int size);
 int sprd_usb_receive(uint8_t* data,int *size);
+int sprd_usb_receive_max(uint8_t* data,int max,int *size);
+void *sprd_usb_buf_alloc(int size);
+void sprd_usb_buf_free(void *buf);
+void sprd_usb_buf_release(void);
+int sprd_usb_zerocopy(void);
+int sprd_read_flash(void *dst,uint32_t size,uint32_t offset);
+
+/* session output(syberusb.c):messages to the log callback,listings to
+ * the output stream,non zero progress return:cancel */
+int sprd_log(const char *fmt, ...) __attribute__((format(printf,1,2)));
+int sprd_out(const char *fmt, ...) __attribute__((format(printf,1,2)));
+int sprd_out_fd(void);
+int sprd_progress(const char *what,uint64_t done,uint64_t total);
+
+/* operations(sprd.c) */
+extern char part_table[][15];
+extern uint32_t part_size[];
+int print_descriptor(libusb_device *dev);
+int sprd_task_bootrom(void);
+int sprd_task_fdl1(void);
+int sprd_normal_reset(void);
+int sprd_power_down(void);
+int sprd_upload(char *part,uint32_t size,uint32_t win_size,char *file);
+int sprd_read_start(const char *part);
+int sprd_read_end(void);
+int sprd_write_start(const char *part,uint32_t size,uint32_t sum);
+int sprd_write_frame(char *dst,uint8_t *data,uint32_t size);
+int sprd_write_send(char *frame,int cnt,uint32_t size);
+int sprd_write_end(void);
+int sprd_erase_partition(const char *part);
+struct frames;
+int sprd_write_frames(const char *part,const struct frames *fc,const char *what);
+int sprd_download_partition(char *part,const char *file,uint32_t size,uint32_t win_size);
+int sprd_read_camera(void);
+int sprd_parse_size(const char *str, uint64_t *size);
+struct syberusb_ext4fs;
+int sprd_ext4fs_task(const struct syberusb_ext4fs *o);
+
+/* usb link statistics */
+struct sprd_link {
+	double srtt;		//ms
+	double rttvar;
+	unsigned int rto;	//current timeout,ms
+	uint64_t samples;
+	uint64_t exchanges;	//READ_FLASH_MIDST windows
+	uint64_t timeouts;
+	uint64_t retries;
+	uint64_t resyncs;
+};
+void sprd_link_get(struct sprd_link *l);
+void sprd_link_report(void);
 int sprd_verify_frame(uint8_t* frame,int frame_size);
 int sprd_com_nodata(uint8_t bsl_com_byte);
 int sprd_frame_exchange(char *dst, const char *src, int src_size, int dir);
@@ -0,0 +1,3629 @@
+#define _GNU_SOURCE //copy_file_range
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <limits.h>
+#include <pthread.h>
+#include <fnmatch.h>
+
+#include <libusb.h>
+
+#include "main.h"
+#include "checksum.h"
+#include "arena.h"
+#include "stats.h"
+#include "trace.h"
+#include "protocol.h"
+#include "ff.h"
+#include "diskio.h"
+
+#include "ext4.h"
+#include "ext4_misc.h"
+#include "ext4_inode.h"
+#include "blockdev.h"
+#include "imagedev.h"
+#include "test_lwext4.h"
+#include "syberusb.h"
+#include "frames.h"
+
+/* usb bulk transfer buffer */
+uint8_t data_buffer[DATA_BUFFER_SIZE];
+
+/* libusb variable */
+libusb_device **devs;
+libusb_device *sprd_dev = NULL;
+libusb_device_handle *sprd_handle;	
+/* check sum type */
+uint8_t checksum_type = TYPE_CRC;
+/* FatFs work area needed for each volume */
+FATFS FatFs;
+/* File object needed for each open file */
+FIL Fil;                   
+
+/**@brief   Block device handle.*/
+static struct ext4_blockdev *bd;
+/**@brief   Block cache handle.*/
+static struct ext4_bcache *bc;
+/**@brief   Local partition dump(ext4fs --image).*/
+static char *ext4fs_image = NULL;
+
+char part_table[][15]={
+"prodnv",	//05000000 = 80m
+"miscdata",	//01000000 = 16m
+"l_fixnv1",	//01000000 = 16m
+"l_fixnv2",	//01000000 = 16m
+"l_runtimenv1",	//01000000 = 16m
+"l_runtimenv2",	//01000000 = 16m
+"l_modem",	//0c000000 = 192m
+"l_ldsp",	//03000000 = 48m
+"l_gdsp",	//03000000 = 48m
+"l_warm",	//03000000 = 48m
+"pm_sys",	//01000000 = 16m
+"sml",		//01000000 = 16m
+"logo",		//01000000 = 16m
+"fbootlogo",	//01000000 = 16m
+"wcnfdl",	//01000000 = 16m
+"wcnmodem",	//0a000000 = 160m
+"boot",		//01000000 = 16m
+"system",	//b0040000 = 2.9g(about)
+"cache",	//96000000 = 2.4g
+"recovery",	//14000000 = 320m
+"misc",		//01000000 = 16m
+"userdata",	//00340000 = 3328k
+"ubootlogo",	//01000000 = 16m
+"security",	//32000000 = 800m
+"dt",		//04000000 = 64m
+"cboot",	//20000000 = 512m
+"syberfs",	//e8030000 = 3.8g(about)
+"data",		//00100000 = 1m(actual=4g)
+"internalsd",	//ffffffff = 4g
+"",		//end
+};
+
+/* bytes of each part_table partition(backup),0:probed from the ext4 or
+ * fat it holds */
+uint32_t part_size[]={
+0x05000000,	//prodnv
+0x01000000,	//miscdata
+0x01000000,	//l_fixnv1
+0x01000000,	//l_fixnv2
+0x01000000,	//l_runtimenv1
+0x01000000,	//l_runtimenv2
+0x0c000000,	//l_modem
+0x03000000,	//l_ldsp
+0x03000000,	//l_gdsp
+0x03000000,	//l_warm
+0x01000000,	//pm_sys
+0x01000000,	//sml
+0x01000000,	//logo
+0x01000000,	//fbootlogo
+0x01000000,	//wcnfdl
+0x0a000000,	//wcnmodem
+0x01000000,	//boot
+0xb0040000,	//system
+0x96000000,	//cache
+0x14000000,	//recovery
+0x01000000,	//misc
+0x00340000,	//userdata
+0x01000000,	//ubootlogo
+0x32000000,	//security
+0x04000000,	//dt
+0x20000000,	//cboot
+0xe8030000,	//syberfs
+0,		//data
+0,		//internalsd
+0,		//end
+};
+
+
+int is_sprd_dev(libusb_device *dev)
+{
+	struct libusb_device_descriptor desc;
+
+	int r = libusb_get_device_descriptor(dev,&desc);
+	if( r == 0){
+		if(desc.idProduct == SPRD_PID && desc.idVendor == SPRD_VID){
+			sprd_log("Found sprd usb\n");
+			sprd_log("PID = 0x%X , VID = 0x%X\n",desc.idProduct,desc.idVendor);
+			return 0;
+		}
+		else return 1;
+	}
+	else{
+		return r;
+	}
+}
+
+void print_hex(uint8_t* str,int length)
+{
+	int i;
+        for(i = 0; i < length; i++){
+                if(!(i%8)) sprd_log("\n");
+                sprd_log("0x%02x ",str[i]);
+        }
+	if(i && (i%9))
+	        sprd_log("\n");
+}
+
+void debug_print_hex(uint8_t* str,int length)
+{
+        int i;
+#ifdef SPRD_DEBUG
+	sprd_log("debug:");
+        for(i = 0; i < length; i++){
+                if(!(i%8)) sprd_log("\n");
+                sprd_log("0x%02x ",str[i]);
+        }
+	if(i && (i%9))
+	        sprd_log("\n");
+#endif
+}
+
+unsigned long get_file_size(const char *path)  
+{  
+    unsigned long filesize = -1;      
+    struct stat statbuff;  
+    if(stat(path, &statbuff) < 0){  
+        return filesize;  
+    }else{  
+        filesize = statbuff.st_size;  
+    }  
+    return filesize;  
+}  
+
+
+void print_device_descriptor(struct libusb_device_descriptor *desc_p)
+{
+	int i;
+        for(i = 0; i < desc_p->bLength; i++){
+                if(!(i%8)) sprd_log("\n");
+                sprd_log("0x%02x ",((uint8_t *)desc_p)[i]);
+        }
+}
+
+void print_config_descriptor(struct libusb_config_descriptor *desc_p)
+{
+	int i;
+        for(i = 0; i < desc_p->bLength; i++){
+                if(!(i%8)) sprd_log("\n");
+                sprd_log("0x%02x ",((uint8_t *)desc_p)[i]);
+        }
+}
+
+void print_interface_descriptor(struct libusb_interface_descriptor *desc_p)
+{
+	int i;
+        for(i = 0; i < desc_p->bLength; i++){
+                if(!(i%8)) sprd_log("\n");
+                sprd_log("0x%02x ",((uint8_t *)desc_p)[i]);
+        }
+}
+
+void printf_endpoint_descriptor(struct libusb_endpoint_descriptor *desc_p)
+{
+        int i;
+        for(i = 0; i < desc_p->bLength; i++){
+                if(!(i%8)) sprd_log("\n");
+                sprd_log("0x%02x ",((uint8_t *)desc_p)[i]);
+        }
+}
+
+/* printf the device descriptor & active config descriptor */
+int print_descriptor(libusb_device *sprd_dev)
+{
+	struct libusb_device_descriptor device_desc;
+	struct libusb_config_descriptor *config_desc;
+	struct libusb_interface_descriptor *interface_desc;
+	struct libusb_endpoint_descriptor *endpoint_desc;
+	int i,j;
+	int r;
+
+	r = libusb_get_device_descriptor(sprd_dev,&device_desc);
+	if(r != 0)
+		return r;
+	r = libusb_get_active_config_descriptor(sprd_dev,&config_desc);
+	//r = libusb_get_config_descriptor(sprd_dev,0,&config_desc);
+	if(r != 0)
+		return r;
+
+	/* device descritpors */
+	sprd_log("Device descriptor:");
+	print_device_descriptor(&device_desc);
+	sprd_log("\n");
+
+	/* config descriptors */
+	sprd_log("Active config descriptor:");
+	print_config_descriptor(config_desc);	
+	sprd_log("\n");	
+
+	/* interface & endpoint descriptors */
+	sprd_log("Interface number:0x%02x\n",config_desc->bNumInterfaces);	
+	for(i = 0; i < config_desc->bNumInterfaces; i++){
+		sprd_log("Interface descriptor:");
+		interface_desc = \
+			(struct libusb_interface_descriptor*)config_desc->interface[i].altsetting;
+		print_interface_descriptor(interface_desc);
+		sprd_log("\n");		
+
+		sprd_log("Endpoint descriptor(num=%02x):",interface_desc->bNumEndpoints);
+		endpoint_desc = \
+			(struct libusb_endpoint_descriptor*)interface_desc->endpoint;
+		for(j = 0; j < interface_desc->bNumEndpoints ;j++){
+			printf_endpoint_descriptor(&endpoint_desc[j]);
+		}
+		
+		sprd_log("\n");
+	}
+	
+	/* free the config struct!!! */
+	libusb_free_config_descriptor(config_desc);
+
+	return 0;
+}
+
+/* usb link timing,srtt/rttvar as tcp does(rfc 6298):the rto is the timeout
+ * of the READ_FLASH_MIDST windows,doubled on a timeout and sampled only from
+ * exchanges that were not retried.Every other exchange(write acks,*_END)
+ * has one try,it never waits less than SPRD_RTO_INIT:a flash program stall
+ * is not a lost window */
+#define SPRD_RTO_INIT 200	//ms,the old fixed timeout
+#define SPRD_RTO_MIN 100
+#define SPRD_RTO_MAX 5000
+#define SPRD_READ_RETRY 6	//attempts of one READ_FLASH_MIDST window
+
+static struct sprd_link usb_link = {.rto = SPRD_RTO_INIT};
+static int usb_link_retried;	//in a READ_FLASH_MIDST exchange
+
+static double sprd_now_ms(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+static void sprd_link_sample(double rtt)
+{
+	double err;
+
+	if(usb_link.samples++ == 0){
+		usb_link.srtt = rtt;
+		usb_link.rttvar = rtt / 2;
+	}
+	else {
+		err = usb_link.srtt - rtt;
+		usb_link.rttvar = 0.75 * usb_link.rttvar + 0.25 * (err < 0 ? -err : err);
+		usb_link.srtt = 0.875 * usb_link.srtt + 0.125 * rtt;
+	}
+	usb_link.rto = usb_link.srtt + 4 * usb_link.rttvar + 1;
+	if(usb_link.rto < SPRD_RTO_MIN) usb_link.rto = SPRD_RTO_MIN;
+	if(usb_link.rto > SPRD_RTO_MAX) usb_link.rto = SPRD_RTO_MAX;
+}
+
+static void sprd_link_backoff(void)
+{
+	usb_link.rto *= 2;
+	if(usb_link.rto > SPRD_RTO_MAX) usb_link.rto = SPRD_RTO_MAX;
+}
+
+void sprd_link_get(struct sprd_link *l)
+{
+	*l = usb_link;
+}
+
+void sprd_link_report(void)
+{
+	sprd_log("usb:%llu reads,srtt %.1f ms,rttvar %.1f ms,timeout %u ms,%llu timeouts,%llu retries,%llu resyncs\n",
+		(unsigned long long)usb_link.exchanges,usb_link.srtt,usb_link.rttvar,usb_link.rto,
+		(unsigned long long)usb_link.timeouts,(unsigned long long)usb_link.retries,
+		(unsigned long long)usb_link.resyncs);
+}
+
+/* every bulk transfer:the device,recorded(--record) or the trace(--replay) */
+static int sprd_usb_bulk(uint8_t ep,uint8_t *data,int len,int *cnt)
+{
+	unsigned int timeout = usb_link.rto;
+	int r;
+
+	if(trace_replaying())
+		return trace_replay(ep,data,len,cnt);
+	if(!usb_link_retried && timeout < SPRD_RTO_INIT)
+		timeout = SPRD_RTO_INIT;
+	*cnt = 0;
+	r = libusb_bulk_transfer(sprd_handle,ep,data,len,cnt,timeout);
+	if(trace_recording())
+		trace_record(ep,data,(ep & 0x80) ? *cnt : len,r);
+	return r;
+}
+
+/* return 0 - normal  no 0 - error */
+int sprd_usb_transfer(uint8_t* data,int size)
+{
+	int r;int cnt;
+	r = sprd_usb_bulk(SPRD_ENDP_OUT,data,size,&cnt);
+	if(r == LIBUSB_ERROR_TIMEOUT){
+		usb_link.timeouts++;
+		sprd_link_backoff();
+	}
+	return r;
+}
+
+/* replies(acks,version...) are small:asking for DATA_BUFFER_SIZE made usbfs
+ * set up a 4MB transfer for each of them */
+int sprd_usb_receive(uint8_t* data,int *size)
+{
+	return sprd_usb_receive_max(data,SPRD_REPLY_SIZE,size);
+}
+
+/* max:room at data,only whole packets are requested(a packet never
+ * overflows),a frame may arrive in several receives */
+int sprd_usb_receive_max(uint8_t* data,int max,int *size)
+{
+	int r;
+	if(max > SPRD_USB_PACKET)
+		max -= max % SPRD_USB_PACKET;
+	r = sprd_usb_bulk(SPRD_ENDP_IN,data,max,size);
+	if(r == LIBUSB_ERROR_TIMEOUT){
+		usb_link.timeouts++;
+		sprd_link_backoff();
+	}
+	return r;
+}
+
+/* transfer buffers:usbfs device memory(zerocopy,no copy between user and
+ * kernel memory) where libusb and the kernel support it,else the arena.
+ * Mapping device memory is a syscall,so released buffers are kept for reuse
+ * until sprd_usb_buf_release() */
+#define SPRD_USB_BUFS 8
+
+struct sprd_usb_buf {
+	uint8_t *buf;
+	int size;
+	int used;
+};
+
+static struct sprd_usb_buf usb_bufs[SPRD_USB_BUFS];
+static pthread_mutex_t usb_bufs_lock = PTHREAD_MUTEX_INITIALIZER;
+static int usb_zerocopy = -1;	/* -1:not probed yet */
+
+void *sprd_usb_buf_alloc(int size)
+{
+	void *p = NULL;
+	int i;
+
+	pthread_mutex_lock(&usb_bufs_lock);
+	if(usb_zerocopy < 0){
+		char *e = getenv("SYBER_USB_ZEROCOPY");
+		usb_zerocopy = (e == NULL || strcmp(e,"0") != 0);
+	}
+	for(i = 0;i < SPRD_USB_BUFS;i++){
+		if(usb_bufs[i].buf != NULL && !usb_bufs[i].used && usb_bufs[i].size >= size){
+			usb_bufs[i].used = 1;
+			p = usb_bufs[i].buf;
+			goto out;
+		}
+	}
+#if defined(LIBUSB_API_VERSION) && LIBUSB_API_VERSION >= 0x01000105
+	if(usb_zerocopy && sprd_handle != NULL){
+		for(i = 0;i < SPRD_USB_BUFS && usb_bufs[i].buf != NULL;i++);
+		if(i < SPRD_USB_BUFS){
+			p = libusb_dev_mem_alloc(sprd_handle,size);
+			if(p != NULL){
+				usb_bufs[i].buf = p;
+				usb_bufs[i].size = size;
+				usb_bufs[i].used = 1;
+				goto out;
+			}
+			/* kernel without usbfs mmap:don't try again */
+			usb_zerocopy = 0;
+		}
+	}
+#endif
+	p = arena_alloc(size);
+out:
+	pthread_mutex_unlock(&usb_bufs_lock);
+	return p;
+}
+
+void sprd_usb_buf_free(void *buf)
+{
+	int i;
+
+	if(buf == NULL)
+		return;
+	pthread_mutex_lock(&usb_bufs_lock);
+	for(i = 0;i < SPRD_USB_BUFS;i++){
+		if(usb_bufs[i].buf == buf){
+			usb_bufs[i].used = 0;
+			pthread_mutex_unlock(&usb_bufs_lock);
+			return;
+		}
+	}
+	pthread_mutex_unlock(&usb_bufs_lock);
+	arena_free(buf);
+}
+
+/* before libusb_close */
+void sprd_usb_buf_release(void)
+{
+	int i;
+
+	pthread_mutex_lock(&usb_bufs_lock);
+	for(i = 0;i < SPRD_USB_BUFS;i++){
+#if defined(LIBUSB_API_VERSION) && LIBUSB_API_VERSION >= 0x01000105
+		if(usb_bufs[i].buf != NULL)
+			libusb_dev_mem_free(sprd_handle,usb_bufs[i].buf,usb_bufs[i].size);
+#endif
+		usb_bufs[i].buf = NULL;
+	}
+	pthread_mutex_unlock(&usb_bufs_lock);
+}
+
+int sprd_usb_zerocopy(void)
+{
+	int i,r = 0;
+
+	pthread_mutex_lock(&usb_bufs_lock);
+	for(i = 0;i < SPRD_USB_BUFS;i++)
+		if(usb_bufs[i].buf != NULL)
+			r = 1;
+	pthread_mutex_unlock(&usb_bufs_lock);
+	return r;
+}
+
+/* drop what is left of a lost,late or corrupt reply(and unstall the pipe),
+ * so the next reply read is the answer to the next request */
+static void sprd_usb_resync(int r)
+{
+	int i,cnt;
+
+	usb_link.resyncs++;
+	if(r == LIBUSB_ERROR_PIPE && sprd_handle != NULL){
+		libusb_clear_halt(sprd_handle,SPRD_ENDP_IN);
+		libusb_clear_halt(sprd_handle,SPRD_ENDP_OUT);
+	}
+	for(i = 0;i < 64;i++){
+		if(sprd_usb_bulk(SPRD_ENDP_IN,data_buffer,0x10000,&cnt) != 0)
+			break;
+	}
+}
+
+/* one READ_FLASH_MIDST exchange,reply frame decoded into data_buffer */
+static int sprd_read_flash_once(uint32_t size,uint32_t offset,char *s_buffer,int s_cap)
+{
+	uint8_t com_buffer[16];
+	uint16_t crc;
+	int r,i,cnt,n;
+
+	com_buffer[SPRD_FRAME_START_OFF] = SPRD_START_BYTE;
+	com_buffer[1] = 0x00;
+	com_buffer[SPRD_FRAME_TYPE_OFF] = BSL_CMD_READ_FLASH_MIDST;
+	com_buffer[SPRD_FRAME_DATA_SIZE_OFF] = 0x08>>8;
+	com_buffer[SPRD_FRAME_DATA_SIZE_OFF+1] = 0x08;
+	((uint32_t*)(com_buffer+SPRD_FRAME_DATA_OFF))[0] = size;
+	((uint32_t*)(com_buffer+SPRD_FRAME_DATA_OFF))[1] = offset;
+	crc = checksum(checksum_type,com_buffer+1,16-4);
+	com_buffer[16-3] = crc>>8;
+	com_buffer[16-2] = crc;
+	com_buffer[16-1] = SPRD_END_BYTE;
+
+	cnt = sprd_frame_exchange(s_buffer,(char *)com_buffer,16,0);
+	debug_print_hex((uint8_t *)s_buffer,cnt);
+	STATS_T0(t_send);
+	r = sprd_usb_transfer((uint8_t *)s_buffer,cnt);
+	if(r != 0)
+		return r;
+	STATS_ADD(STATS_SEND,t_send,0);
+
+	STATS_T0(t_recv);
+	for(cnt = 0;cnt < size + 8;){
+		i = 0;
+		do{
+			r = sprd_usb_receive_max((uint8_t *)s_buffer+i,s_cap-i,&n);
+			if(r != 0)
+				return r;
+			if(cnt == 0 && i == 0)
+				STATS_ADD(STATS_FIRST_BYTE,t_recv,0);
+			i += n;
+		}while(i == 0 || (s_buffer[i-1] == 0x7d && i < s_cap));//last byte maybe 0x7d
+		debug_print_hex((uint8_t *)s_buffer,i);
+		STATS_T0(t_esc);
+		cnt += sprd_frame_exchange((char *)data_buffer+cnt,s_buffer,i,1);
+		STATS_ADD(STATS_ESCAPE,t_esc,i);
+	}
+	STATS_ADD(STATS_RECV,t_recv,size);
+	if(cnt != size + 8)
+		return -1;
+	STATS_T0(t_sum);
+	r = sprd_verify_frame(data_buffer,cnt);
+	STATS_ADD(STATS_CHECKSUM,t_sum,cnt);
+	if(r != 0 || data_buffer[SPRD_FRAME_TYPE_OFF] != BSL_REP_READ_FLASH)
+		return -1;
+	return 0;
+}
+
+/* read size(<= SPRD_READ_WINDOW) bytes at offset of the open partition to
+ * dst,dst NULL:leave them at data_buffer+SPRD_FRAME_DATA_OFF.
+ * READ_FLASH_MIDST is idempotent:a timeout,short or corrupt reply costs
+ * a resync and the same request again,not the whole operation */
+int sprd_read_flash(void *dst,uint32_t size,uint32_t offset)
+{
+	int s_cap = SPRD_ESCAPE_SIZE(SPRD_READ_WINDOW);
+	char *s_buffer;
+	double t0;
+	int r,try;
+
+	if(size > SPRD_READ_WINDOW)
+		return -1;
+	s_buffer = sprd_usb_buf_alloc(s_cap);
+	if(s_buffer == NULL)
+		return LIBUSB_ERROR_NO_MEM;
+
+	for(try = 0;;try++){
+		t0 = sprd_now_ms();
+		usb_link_retried = 1;
+		r = sprd_read_flash_once(size,offset,s_buffer,s_cap);
+		usb_link_retried = 0;
+		if(r == 0)
+			break;
+		if(try + 1 == SPRD_READ_RETRY){
+			sprd_log("sprd_read_flash:offset 0x%x,%d attempts failed:%d\n",offset,SPRD_READ_RETRY,r);
+			break;
+		}
+		usb_link.retries++;
+		sprd_usb_resync(r);
+	}
+	usb_link.exchanges++;
+	/* karn:a retried exchange says nothing about the rtt */
+	if(r == 0 && try == 0)
+		sprd_link_sample(sprd_now_ms() - t0);
+
+	sprd_usb_buf_free(s_buffer);
+	if(r == 0 && dst != NULL)
+		memcpy(dst,data_buffer+SPRD_FRAME_DATA_OFF,size);
+	return r;
+}
+
+int sprd_verify_frame(uint8_t* frame,int frame_size)
+{
+	if(frame[0] != SPRD_START_BYTE || frame[frame_size-1] != SPRD_END_BYTE) 
+		return -1;
+	if(checksum(checksum_type,frame+1,frame_size-4) != ((frame[frame_size-3]<<8)/*'( )'!!*/ | frame[frame_size-2]))
+		return -1;
+	return 0;
+}
+/* send com frame without data field */
+int sprd_com_nodata(uint8_t bsl_com_byte)
+{
+	int r;
+	uint8_t data[8];
+	uint16_t crc;
+        data_buffer[0] = SPRD_START_BYTE;       //header
+        data_buffer[1] = 0x00;          
+        data_buffer[2] = bsl_com_byte;	       //type
+        data_buffer[3] = 0x00;
+        data_buffer[4] = 0x00;                  //data size
+        crc = checksum(checksum_type,&data_buffer[1],4);
+        data_buffer[5] = crc>>8;
+        data_buffer[6] = (crc&0xff);              //crc
+        data_buffer[7] = SPRD_END_BYTE;         //ender				
+        r = sprd_usb_transfer(data_buffer,8);
+	debug_print_hex(data_buffer,8);
+
+        if(r) return r;
+	
+	return 0;	
+}
+/* phone ack only first commication (check_baudrate)*/
+int sprd_version(void)
+{
+	int r;int cnt;
+        data_buffer[0] = SPRD_START_BYTE;
+        r = sprd_usb_transfer(data_buffer,1);
+        if(r != 0) return r;
+        r = sprd_usb_receive(data_buffer,&cnt);
+        if(r != 0) return r;
+        r = sprd_verify_frame(data_buffer,cnt);
+        if(r != 0) return r;
+        debug_print_hex(data_buffer,cnt);	
+	
+	return 0;
+}
+
+int sprd_connect(void)
+{
+	int cnt;int r;
+
+	r = sprd_com_nodata(BSL_CMD_CONNECT);
+	if(r) return r;
+	r = sprd_usb_receive(data_buffer,&cnt);
+	if(r) return r;
+	r = sprd_verify_frame(data_buffer,cnt);
+	if(r) return r;
+        debug_print_hex(data_buffer,cnt);
+        if(data_buffer[SPRD_FRAME_TYPE_OFF] != BSL_REP_ACK){
+                return -1;
+        }
+
+	return 0;
+}
+
+int sprd_exec_data(void)
+{
+	int cnt;int r;
+	r = sprd_com_nodata(BSL_CMD_EXEC_DATA);
+	if(r) return r;
+	r = sprd_usb_receive(data_buffer,&cnt);
+	if(r) return r;
+	r = sprd_verify_frame(data_buffer,cnt);
+	if(r) return r;
+	debug_print_hex(data_buffer,cnt);
+        if(data_buffer[SPRD_FRAME_TYPE_OFF] == BSL_REP_ACK )
+                return 0;
+	//else if(data_buffer[SPRD_FRAME_TYPE_OFF] == BSL_INCOMPATIBLE_PARTITION)
+	//	return 1;
+	else return -1;
+	
+	return 0;
+}
+
+/* reset to normal state */
+int sprd_normal_reset(void)
+{
+	int r;int cnt;
+	r = sprd_com_nodata(BSL_CMD_NORMAL_RESET);
+	if(r) return r;
+	r = sprd_usb_receive(data_buffer,&cnt);
+	if(r) return r;
+	r = sprd_verify_frame(data_buffer,cnt);
+	if(r) return r;
+	debug_print_hex(data_buffer,cnt);
+	if(data_buffer[SPRD_FRAME_TYPE_OFF] == BSL_REP_ACK)
+		return 0;
+	else return -1;
+
+	return 0;
+}
+
+/* power down device */
+int sprd_power_down(void)
+{
+        int r;int cnt;
+        r = sprd_com_nodata(BSL_CMD_POWER_DOWN_TYPE);
+        if(r) return r;
+        r = sprd_usb_receive(data_buffer,&cnt);
+        if(r) return r;
+        r = sprd_verify_frame(data_buffer,cnt);
+        if(r) return r;
+        debug_print_hex(data_buffer,cnt);
+        if(data_buffer[SPRD_FRAME_TYPE_OFF] == BSL_REP_ACK)
+                return 0;
+        else return -1;
+
+        return 0;
+}
+
+/*
+*dir:0 0x7e->0x7d 0x5e
+*      0x7d->0x7d 0x5d
+*dir:1 0x7d 0x5e->0x7e
+*      0x7d 0x5d->0x7d
+*return:exchange size
+*/
+int sprd_frame_exchange(char *dst, const char *src, int src_size, int dir)
+{
+	int i,cnt;
+	dir &= 1;
+	if(dir == 0){
+        	for(i = 0,cnt = 0;i < src_size; i++){
+         	       switch(src[i]){
+                	        case 0x7e:
+                        	        if(i && (i != src_size-1)){
+                                	        dst[cnt++] = 0x7d;dst[cnt++] = 0x5e;
+	                                }else dst[cnt++] = src[i];
+        	                                break;
+                	        case 0x7d:
+                        	        dst[cnt++] = 0x7d;dst[cnt++] = 0x5d;
+                                	break;
+	                        default:
+        	                        dst[cnt++] = src[i];
+                	                break;
+                        }
+        	}
+	}
+	else if(dir == 1){
+		for(i = 0,cnt = 0;i < src_size;i++){
+			if(src[i] == 0x7d){ 
+				switch(src[i+1]){
+					case 0x5e:dst[cnt++] = 0x7e;
+						break;
+					case 0x5d:dst[cnt++] = 0x7d;
+						break;
+					default:break;
+				}
+				i++;
+			}
+			else{
+				dst[cnt++] = src[i];
+			}
+		}	
+	}
+	return cnt;
+}
+
+/* send file to destnation addr */
+int sprd_download(const char *file_name,uint32_t download_size,uint32_t dst_addr,uint32_t win_size)
+{
+	int r;int i=0;int cnt;
+	uint16_t crc;
+	uint8_t com_buff[16];
+	/* start */
+#ifdef SPRD_DEBUG
+	sprd_log("sprd download step:start\n");
+#endif
+	com_buff[i++] = SPRD_START_BYTE;
+	com_buff[i++] = 0x00;
+	com_buff[i++] = BSL_CMD_START_DATA; //com
+	com_buff[i++] = 0x00;
+	com_buff[i++] = 0x08; //data size
+	com_buff[i++] = dst_addr>>24;
+	com_buff[i++] = dst_addr>>16;
+	com_buff[i++] = dst_addr>>8;
+	com_buff[i++] = dst_addr; //distnation
+	com_buff[i++] = download_size>>24;
+	com_buff[i++] = download_size>>16;
+	com_buff[i++] = download_size>>8;
+	com_buff[i++] = download_size; // size
+	crc = checksum(checksum_type,com_buff+1,12);
+	com_buff[i++] = crc>>8;
+	com_buff[i++] = crc;	//crc16
+	com_buff[i++] = SPRD_END_BYTE;
+	debug_print_hex(com_buff,16);
+	
+	r = sprd_usb_transfer(com_buff,16);
+	if(r != 0) return r;
+	r = sprd_usb_receive(data_buffer,&cnt);
+	if(r != 0) return r;
+	r = sprd_verify_frame(data_buffer,cnt);
+	if(r != 0) return r;
+	if(data_buffer[SPRD_FRAME_TYPE_OFF] != BSL_REP_ACK){
+		return -1;
+	}
+	debug_print_hex(data_buffer,cnt);
+
+	/* middle */
+#ifdef SPRD_DEBUG
+	sprd_log("sprd download step:middle\n");
+#endif
+	int fd = open(file_name,O_RDONLY);
+	if(fd == -1){
+		sprd_log("middle:open %s error\n",file_name);
+		return -1;
+	}
+	
+	ssize_t r_size;
+	char *s_buffer = sprd_usb_buf_alloc(SPRD_ESCAPE_SIZE(win_size));
+	while(download_size){
+#ifdef SPRD_DEBUG
+		sprd_log("download_size is %d\n",download_size);
+#endif
+		r_size = (download_size > win_size ) ? win_size:download_size;
+		r_size = read(fd,(void*)(data_buffer+SPRD_FRAME_DATA_OFF),r_size);
+		if(r_size == 0){
+			sprd_log("middle:read file error\n");
+			sprd_usb_buf_free(s_buffer);
+			return -1;
+		}
+		download_size -= r_size;
+
+	        data_buffer[SPRD_FRAME_START_OFF] = SPRD_START_BYTE;
+	        data_buffer[1] = 0x00;
+	        data_buffer[SPRD_FRAME_TYPE_OFF] = BSL_CMD_MIDST_DATA;
+	        data_buffer[SPRD_FRAME_DATA_SIZE_OFF] = r_size>>8;
+	        data_buffer[SPRD_FRAME_DATA_SIZE_OFF+1] = r_size;
+		crc = checksum(checksum_type,data_buffer+1,r_size+4);
+		data_buffer[SPRD_FRAME_DATA_OFF+r_size] = crc>>8;
+		data_buffer[SPRD_FRAME_DATA_OFF+r_size+1] = crc;
+		data_buffer[r_size+8-1] = SPRD_END_BYTE;
+		//send frame steaming 
+		//0x7e = 0x7d 0x7e^0x20 0x7d = 0x7d 0x7d^0x20 , except header & ender		
+		for(i = 0,cnt = 0; i < r_size+8; i++){
+			switch(data_buffer[i]){
+				case 0x7e:
+					if(i && (i != r_size+7)){
+						s_buffer[cnt++] = 0x7d;s_buffer[cnt++] = 0x5e;
+					}else s_buffer[cnt++] = data_buffer[i];
+					break;
+				case 0x7d:
+					s_buffer[cnt++] = 0x7d;s_buffer[cnt++] = 0x5d;
+					break;
+				default:
+					s_buffer[cnt++] = data_buffer[i];
+					break;
+			}
+		}
+		debug_print_hex(s_buffer,cnt);
+
+		r = sprd_usb_transfer(s_buffer,cnt);
+		if(r) {
+			sprd_log("sprd_usb_transfer error\n");
+			sprd_usb_buf_free(s_buffer);
+			return r;
+		}
+		r = sprd_usb_receive(data_buffer,&cnt);
+		if(r){
+			sprd_log("sprd_usb_receive error\n");
+			sprd_usb_buf_free(s_buffer);
+			return r;
+		}
+		r = sprd_verify_frame(data_buffer,cnt);
+		if(r){
+			sprd_log("sprd verify error\n");
+			sprd_usb_buf_free(s_buffer);
+			return r;
+		}
+		debug_print_hex(data_buffer,cnt);
+		if(data_buffer[SPRD_FRAME_TYPE_OFF] != BSL_REP_ACK){
+			sprd_log("sprd ack error\n");
+			sprd_usb_buf_free(s_buffer);
+			return -1;
+		}
+	}
+	sprd_usb_buf_free(s_buffer);
+	if(close(fd) == -1){
+		sprd_log("close file error\n");
+		return -1;
+	}
+	/* end */
+#ifdef SPRD_DEBUG
+	sprd_log("sprd download step:end\n");
+#endif
+	r = sprd_com_nodata(BSL_CMD_END_DATA);
+	if(r) return r;
+	r = sprd_usb_receive(data_buffer,&cnt);
+	if(r) return r;
+        r = sprd_verify_frame(data_buffer,cnt);
+        if(r) {
+		return r;
+	}
+	debug_print_hex(data_buffer,cnt);
+        if(data_buffer[SPRD_FRAME_TYPE_OFF] != BSL_REP_ACK){
+        	return -1;
+        }
+		
+	return 0;
+}
+
+/* get sum of file */
+uint32_t get_sum_file(const char* pathname)
+{
+        int fd;int i;
+        ssize_t r_size =0;
+        uint32_t buff_size = 0x2800;
+        uint32_t check_sum = 0;
+        uint32_t  total_size = 0;
+        void *buff = malloc(buff_size);//10k
+        fd = open(pathname,O_RDONLY);
+        r_size = read(fd,buff,buff_size);
+        while(r_size){
+                for(i = 0;i < r_size;i++){
+                        check_sum += ((uint8_t*)buff)[i];
+                }
+                total_size += r_size;
+                r_size = read(fd,buff,buff_size);
+        }
+        free(buff);
+        close(fd);
+        return check_sum;
+}
+
+/* bulk transfer rate and cpu cost,compare with SYBER_USB_ZEROCOPY=0 */
+struct sprd_rate {
+	struct timespec t0;
+	struct timespec c0;
+};
+
+static void sprd_rate_start(struct sprd_rate *rt)
+{
+	clock_gettime(CLOCK_MONOTONIC,&rt->t0);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&rt->c0);
+}
+
+static void sprd_rate_report(struct sprd_rate *rt,uint32_t bytes)
+{
+	struct timespec t1,c1;
+	double sec,cpu,mb = bytes / 1e6;
+
+	clock_gettime(CLOCK_MONOTONIC,&t1);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&c1);
+	sec = (t1.tv_sec - rt->t0.tv_sec) + (t1.tv_nsec - rt->t0.tv_nsec) / 1e9;
+	cpu = (c1.tv_sec - rt->c0.tv_sec) + (c1.tv_nsec - rt->c0.tv_nsec) / 1e9;
+	sprd_log("%u Bytes in %.2fs(%.2f MB/s,%.2f ms cpu/MB,%s buffers)\n",bytes,sec,
+		sec > 0 ? mb / sec : 0.0,mb > 0 ? cpu * 1e3 / mb : 0.0,
+		sprd_usb_zerocopy() ? "zerocopy" : "copied");
+	sprd_link_report();
+}
+
+/* START_DATA of a partition,down_size bytes follow in MIDST_DATA frames
+ * until sprd_write_end();sum:byte sum of the data,l_fixnv1 only */
+int sprd_write_start(const char *part_name,uint32_t down_size,uint32_t sum)
+{
+	int i;int r;int cnt;
+	uint16_t crc;
+	uint8_t com_buffer[100];
+	char *s_buffer;
+
+	s_buffer = sprd_usb_buf_alloc(SPRD_ESCAPE_SIZE(100));
+	if(s_buffer == NULL){
+		sprd_log("sprd_usb_buf_alloc error\n");
+		return -1;
+	}
+	/* start */
+#ifdef SPRD_DEBUG
+	sprd_log("sprd download partition step:start\n");
+#endif
+	if(strcmp(part_name,"l_fixnv1") == 0){//writing l_fixnv1 is diff
+                memset(com_buffer,0x00,88);
+                com_buffer[SPRD_FRAME_START_OFF] = SPRD_START_BYTE;
+                com_buffer[1] = 0x00;
+                com_buffer[SPRD_FRAME_TYPE_OFF] = BSL_CMD_START_DATA;
+                com_buffer[SPRD_FRAME_DATA_SIZE_OFF] = 0x50>>8;
+                com_buffer[SPRD_FRAME_DATA_SIZE_OFF+1] = 0x50;
+                com_buffer[88-1] = SPRD_END_BYTE;
+                for(i = 0;part_name[i] != '\0';i++){
+                        com_buffer[SPRD_FRAME_DATA_OFF+i*2] = part_name[i];
+                        com_buffer[SPRD_FRAME_DATA_OFF+i*2+1] = 0x00;
+                }
+                *((uint32_t*)(com_buffer+77)) = down_size; //download size
+		*((uint32_t*)(com_buffer+81)) = sum; //total data sum
+                crc = checksum(checksum_type,com_buffer+1,88-4);
+                com_buffer[88-3] = crc>>8;
+                com_buffer[88-2] = crc;
+        
+                cnt = sprd_frame_exchange(s_buffer,com_buffer,88,0);
+                debug_print_hex(s_buffer,cnt);
+	}
+	else{	
+		memset(com_buffer,0x00,84);
+	        com_buffer[SPRD_FRAME_START_OFF] = SPRD_START_BYTE;
+        	com_buffer[1] = 0x00;
+	        com_buffer[SPRD_FRAME_TYPE_OFF] = BSL_CMD_START_DATA;
+	        com_buffer[SPRD_FRAME_DATA_SIZE_OFF] = 0x4c>>8;
+	        com_buffer[SPRD_FRAME_DATA_SIZE_OFF+1] = 0x4c;
+		com_buffer[84-1] = SPRD_END_BYTE;
+		for(i = 0;part_name[i] != '\0';i++){
+			com_buffer[SPRD_FRAME_DATA_OFF+i*2] = part_name[i];
+			com_buffer[SPRD_FRAME_DATA_OFF+i*2+1] = 0x00;
+		}
+		*((uint32_t*)(com_buffer+77)) = down_size; //download size
+		crc = checksum(checksum_type,com_buffer+1,84-4);
+		com_buffer[84-3] = crc>>8;
+		com_buffer[84-2] = crc;
+	
+		cnt = sprd_frame_exchange(s_buffer,com_buffer,84,0);
+		debug_print_hex(s_buffer,cnt);
+	}
+	r = sprd_usb_transfer(s_buffer,cnt);
+	sprd_usb_buf_free(s_buffer);
+	if(r != 0){
+		sprd_log("start:sprd usb transfer error:%d\n",r);
+		return r;
+	}
+	for(i = 5;i ;i--){
+		r = sprd_usb_receive(data_buffer,&cnt);
+		if(r) continue;else break;
+	}
+	if(!i){
+		sprd_log("start:sprd usb receive error:%d\n",r);
+		return r;
+	}
+	debug_print_hex(data_buffer,cnt);	
+	if(sprd_verify_frame(data_buffer,cnt) != 0){
+		sprd_log("start:sprd verify frame error\n");
+		return -1;
+	}
+	if(data_buffer[SPRD_FRAME_TYPE_OFF] != BSL_REP_ACK){
+		if(data_buffer[SPRD_FRAME_TYPE_OFF] == BSL_REP_DOWN_SIZE_ERROR){
+			sprd_log("start:download size error(0x%x Bytes larger than partition '%s' size?)\n",down_size,part_name);
+			return -1;
+		}
+		else {
+			sprd_log("start:sprd ack error\n");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* one MIDST_DATA frame,escaped:size bytes at data+SPRD_FRAME_DATA_OFF,
+ * room for 8 more;returns the bytes to send */
+int sprd_write_frame(char *dst,uint8_t *data,uint32_t size)
+{
+	uint16_t crc;
+	int cnt;
+
+	data[SPRD_FRAME_START_OFF] = SPRD_START_BYTE;
+	data[1] = 0x00;
+	data[SPRD_FRAME_TYPE_OFF] = BSL_CMD_MIDST_DATA;
+	data[SPRD_FRAME_DATA_SIZE_OFF] = size>>8;
+	data[SPRD_FRAME_DATA_SIZE_OFF+1] = size;
+	STATS_T0(t_sum);
+	crc = checksum(checksum_type,data+1,size+4);
+	STATS_ADD(STATS_CHECKSUM,t_sum,size+4);
+	data[SPRD_FRAME_DATA_OFF+size] = crc>>8;
+	data[SPRD_FRAME_DATA_OFF+size+1] = crc;
+	data[size+8-1] = SPRD_END_BYTE;
+	//send frame steaming 
+	//0x7e = 0x7d 0x7e^0x20 0x7d = 0x7d 0x7d^0x20 , except header & ender           
+	STATS_T0(t_esc);
+	cnt = sprd_frame_exchange(dst,(char *)data,size + 8,0);
+	STATS_ADD(STATS_ESCAPE,t_esc,size + 8);
+	return cnt;
+}
+
+/* send an escaped MIDST_DATA frame,wait for its ack */
+int sprd_write_send(char *frame,int cnt,uint32_t size)
+{
+	int r;
+
+	debug_print_hex(frame,cnt);
+	STATS_T0(t_send);
+	r = sprd_usb_transfer((uint8_t *)frame,cnt);
+	if(r) {
+		sprd_log("middle:sprd_usb_transfer error:%d\n",r);
+		return r;
+	}
+	STATS_ADD(STATS_SEND,t_send,size);
+	STATS_T0(t_recv);
+	r = sprd_usb_receive(data_buffer,&cnt);
+	if(r){
+		sprd_log("middle:sprd_usb_receive error:%d\n",r);
+		return r;
+	}
+	STATS_ADD(STATS_FIRST_BYTE,t_recv,0);
+	STATS_ADD(STATS_RECV,t_recv,0);
+	r = sprd_verify_frame(data_buffer,cnt);
+	if(r){
+		sprd_log("middle:sprd verify error:%d\n",r);
+		return r;
+	}
+	debug_print_hex(data_buffer,cnt);
+	if(data_buffer[SPRD_FRAME_TYPE_OFF] != BSL_REP_ACK){
+		sprd_log("sprd ack error\n");
+		return -1;
+	}
+	return 0;
+}
+
+/* END_DATA */
+int sprd_write_end(void)
+{
+	int r;int cnt;
+
+#ifdef SPRD_DEBUG
+	sprd_log("sprd download partition step:end\n");
+#endif
+        r = sprd_com_nodata(BSL_CMD_END_DATA);
+        if(r) {
+		sprd_log("end step:sprd com nodata error:%d\n",r);
+		return r;
+	}
+        r = sprd_usb_receive(data_buffer,&cnt);
+        if(r) {
+		sprd_log("end step:sprd usb receive error:%d\n",r);
+		return r;
+	}
+        r = sprd_verify_frame(data_buffer,cnt);
+        if(r) {
+		sprd_log("end step:frame verify error:%d\n",r);
+                return r;
+        }
+        debug_print_hex(data_buffer,cnt);
+        if(data_buffer[SPRD_FRAME_TYPE_OFF] != BSL_REP_ACK){
+		sprd_log("end step:ack error\n");
+                return -1;
+        }
+        return 0;
+}
+
+/* ERASE_FLASH of a whole partition,the ack comes once the flash is erased */
+int sprd_erase_partition(const char *part_name)
+{
+	int i;int r;int cnt;
+	uint16_t crc;
+	uint8_t com_buffer[84];
+	char *s_buffer;
+
+	s_buffer = sprd_usb_buf_alloc(SPRD_ESCAPE_SIZE(84));
+	if(s_buffer == NULL){
+		sprd_log("sprd_usb_buf_alloc error\n");
+		return -1;
+	}
+	memset(com_buffer,0x00,84);
+	com_buffer[SPRD_FRAME_START_OFF] = SPRD_START_BYTE;
+	com_buffer[1] = 0x00;
+	com_buffer[SPRD_FRAME_TYPE_OFF] = BSL_ERASE_FLASH;
+	com_buffer[SPRD_FRAME_DATA_SIZE_OFF] = 0x4c>>8;
+	com_buffer[SPRD_FRAME_DATA_SIZE_OFF+1] = 0x4c;
+	com_buffer[84-1] = SPRD_END_BYTE;
+	for(i = 0;part_name[i] != '\0';i++){
+		com_buffer[SPRD_FRAME_DATA_OFF+i*2] = part_name[i];
+		com_buffer[SPRD_FRAME_DATA_OFF+i*2+1] = 0x00;
+	}
+	*((uint32_t*)(com_buffer+77)) = 0xffffffff; //whole partition
+	crc = checksum(checksum_type,com_buffer+1,84-4);
+	com_buffer[84-3] = crc>>8;
+	com_buffer[84-2] = crc;
+
+	cnt = sprd_frame_exchange(s_buffer,com_buffer,84,0);
+	debug_print_hex(s_buffer,cnt);
+	r = sprd_usb_transfer(s_buffer,cnt);
+	sprd_usb_buf_free(s_buffer);
+	if(r != 0){
+		sprd_log("erase:sprd usb transfer error:%d\n",r);
+		return r;
+	}
+	/* big partitions take a while */
+	for(i = 10;i ;i--){
+		r = sprd_usb_receive(data_buffer,&cnt);
+		if(r) continue;else break;
+	}
+	if(!i){
+		sprd_log("erase:sprd usb receive error:%d\n",r);
+		return r;
+	}
+	debug_print_hex(data_buffer,cnt);
+	if(sprd_verify_frame(data_buffer,cnt) != 0){
+		sprd_log("erase:sprd verify frame error\n");
+		return -1;
+	}
+	if(data_buffer[SPRD_FRAME_TYPE_OFF] != BSL_REP_ACK){
+		sprd_log("erase:partition '%s' not erased(reply 0x%02x)\n",part_name,data_buffer[SPRD_FRAME_TYPE_OFF]);
+		return -1;
+	}
+	return 0;
+}
+
+/* write a pre-framed image(frame cache):the frames go out as they are
+ * mapped,no file read,checksum or escaping;what:progress name */
+int sprd_write_frames(const char *part_name,const struct frames *fc,const char *what)
+{
+	const uint8_t *frame;
+	uint32_t i,size,offset = 0;
+	int r,cnt;
+
+	r = sprd_write_start(part_name,fc->hdr.size,fc->hdr.sum);
+	if(r != 0)
+		return r;
+	struct sprd_rate rate;
+	sprd_rate_start(&rate);
+	for(i = 0;i < fc->hdr.count;i++){
+		frame = frames_get(fc,i,&cnt);
+		size = fc->hdr.size - offset < fc->hdr.win ? fc->hdr.size - offset : fc->hdr.win;
+		r = sprd_write_send((char *)frame,cnt,size);
+		if(r)
+			return r;
+		offset += size;
+		if(sprd_progress(what,offset,fc->hdr.size) != 0){
+			sprd_log("middle:canceled\n");
+			return ECANCELED;
+		}
+	}
+	sprd_rate_report(&rate,fc->hdr.size);
+	return sprd_write_end();
+}
+
+/* write file to partition 
+*part_name - partition name
+*down_size - size of write
+*file_name - file to write
+*win_size - size of one receive
+*         Larger and faster, according to the mobile phone transmission capacity adjustment
+*         win_size < mobile maximum transmission size
+*/
+int sprd_download_partition(char* part_name,const char* file_name,uint32_t down_size,uint32_t win_size)
+{
+	int r;int cnt;
+	char *s_buffer;
+	/* check param */
+	if(!down_size){
+		sprd_log("download size = 0,nothing to do\n");
+		return -1;
+	}
+	if(file_name == NULL || part_name == NULL){
+		sprd_log("file_name/part_name is NULL\n");
+		return -1;
+	}
+	if(access(file_name,F_OK) != 0){
+		sprd_log("file '%s' not exist\n",file_name);
+		return -1;
+	}
+	struct stat sb;
+        stat(file_name, &sb);
+        if ((sb.st_mode & S_IFMT) != S_IFREG) {
+		sprd_log("file '%s' is not regular file\n",file_name);
+		return -1;
+        }
+
+	sprd_log("Writing file:'%s'(size=0x%x) to partition '%s'\n",file_name,down_size,part_name);
+	/* same image to many phones:frame it once(whole images only) */
+	if(frames_enabled() && down_size == (uint64_t)sb.st_size){
+		struct frames fc;
+		if(frames_open(&fc,file_name,win_size) == 0){
+			if(fc.hdr.size == down_size){
+				r = sprd_write_frames(part_name,&fc,"download");
+				frames_close(&fc);
+				return r;
+			}
+			frames_close(&fc);
+		}
+		sprd_log("frames:no cache for '%s',framing as it goes\n",file_name);
+	}
+	r = sprd_write_start(part_name,down_size,
+		strcmp(part_name,"l_fixnv1") == 0 ? get_sum_file(file_name) : 0);
+	if(r != 0)
+		return r;
+	s_buffer = sprd_usb_buf_alloc(SPRD_ESCAPE_SIZE(win_size));
+	if(s_buffer == NULL){
+		sprd_log("sprd_usb_buf_alloc error\n");
+		return -1;
+	}
+	
+	/* middle */
+#ifdef SPRD_DEBUG
+	sprd_log("sprd download partition step:middle\n");
+#endif
+	umask(0);
+	int fd = open(file_name,O_RDONLY);
+        if(fd == -1){
+               	sprd_log("middle:open %s error\n",file_name);
+	               sprd_usb_buf_free(s_buffer);
+	               return -1;
+        }
+	uint32_t down_size_count = down_size;
+	struct sprd_rate rate;
+	sprd_rate_start(&rate);
+	uint32_t offset = 0;
+	uint32_t r_size = 0;
+	while(down_size){
+#ifdef SPRD_DEBUG
+                sprd_log("down_size is %d\n",down_size);
+#endif
+                r_size = (down_size > win_size ) ? win_size:down_size;
+                STATS_T0(t_read);
+                r_size = read(fd,(void*)(data_buffer+SPRD_FRAME_DATA_OFF),r_size);
+                STATS_ADD(STATS_FILE_READ,t_read,r_size);
+                if(r_size == 0){
+                        sprd_log("middle:read file error\n");
+                        sprd_usb_buf_free(s_buffer);
+                        close(fd);
+                        return -1;
+                }
+
+		cnt = sprd_write_frame(s_buffer,data_buffer,r_size);
+		r = sprd_write_send(s_buffer,cnt,r_size);
+		if(r){
+			sprd_usb_buf_free(s_buffer);
+			close(fd);
+			return r;
+		}
+
+		offset += r_size;
+		down_size -= r_size;
+
+		if(sprd_progress("download",offset,down_size_count) != 0){
+			sprd_log("middle:canceled\n");
+			sprd_usb_buf_free(s_buffer);
+			close(fd);
+			return ECANCELED;
+		}
+	}
+
+	sprd_usb_buf_free(s_buffer);
+	sprd_rate_report(&rate,down_size_count);
+	if(close(fd) != 0){
+		sprd_log("close file error\n");
+		return -1;
+	}
+	/* end */
+	return sprd_write_end();
+}
+
+/* READ_FLASH_START of a partition,the windows are then read with
+ * sprd_read_flash() until sprd_read_end() */
+int sprd_read_start(const char *part_name)
+{
+	int i;int r;int cnt;
+	uint16_t crc;
+	uint8_t com_buffer[84];
+	char *s_buffer;
+
+	s_buffer = sprd_usb_buf_alloc(SPRD_ESCAPE_SIZE(84));
+	if(s_buffer == NULL){
+		sprd_log("sprd_usb_buf_alloc error\n");
+		return -1;
+	}
+	/* start */
+#ifdef SPRD_DEBUG
+	sprd_log("sprd upload step:start\n");
+#endif
+	memset(com_buffer,0x00,84);
+        com_buffer[SPRD_FRAME_START_OFF] = SPRD_START_BYTE;
+        com_buffer[1] = 0x00;
+        com_buffer[SPRD_FRAME_TYPE_OFF] = BSL_CMD_READ_FLASH_START;
+        com_buffer[SPRD_FRAME_DATA_SIZE_OFF] = 0x4c>>8;
+        com_buffer[SPRD_FRAME_DATA_SIZE_OFF+1] = 0x4c;
+	com_buffer[84-1] = SPRD_END_BYTE;
+	for(i = 0;part_name[i] != '\0';i++){
+		com_buffer[SPRD_FRAME_DATA_OFF+i*2] = part_name[i];
+		com_buffer[SPRD_FRAME_DATA_OFF+i*2+1] = 0x00;
+	}
+	*((uint32_t*)(com_buffer+77)) = /*0x01000000*/0xffffffff; //max size???
+	crc = checksum(checksum_type,com_buffer+1,84-4);
+	com_buffer[84-3] = crc>>8;
+	com_buffer[84-2] = crc;
+	
+	cnt = sprd_frame_exchange(s_buffer,com_buffer,84,0);
+	debug_print_hex(s_buffer,cnt);
+
+	r = sprd_usb_transfer(s_buffer,cnt);
+	sprd_usb_buf_free(s_buffer);
+	if(r != 0){
+		sprd_log("start:sprd usb transfer error:%d\n",r);
+		return r;
+	}
+	for(i = 5;i ;i--){
+		r = sprd_usb_receive(data_buffer,&cnt);
+		if(r) continue;else break;
+	}
+	if(!i){
+		sprd_log("start:sprd usb receive error:%d\n",r);
+		return r;
+	}
+	debug_print_hex(data_buffer,cnt);	
+	if(sprd_verify_frame(data_buffer,cnt) != 0){
+		sprd_log("start:sprd verify frame error\n");
+		return -1;
+	}
+	if(data_buffer[SPRD_FRAME_TYPE_OFF] == BSL_REP_DOWN_SIZE_ERROR){
+#ifdef SPRD_DEBUG
+		sprd_log("partition  size error(not care!)\n");
+#endif
+	}
+	return 0;
+}
+
+/* READ_FLASH_END */
+int sprd_read_end(void)
+{
+	int r;int cnt;
+
+#ifdef SPRD_DEBUG
+	sprd_log("sprd upload step:end\n");
+#endif
+	r = sprd_com_nodata(BSL_CMD_READ_FLASH_END);
+	if(r != 0){
+		sprd_log("end:sprd com nodata error:%d\n",r);
+		return r;
+	}
+	r = sprd_usb_receive(data_buffer,&cnt);
+	if(r != 0){
+		sprd_log("end:sprd usb receive error:%d\n",r);
+		return r;
+	}
+	debug_print_hex(data_buffer,cnt);
+	if(sprd_verify_frame(data_buffer,cnt) != 0 || data_buffer[SPRD_FRAME_TYPE_OFF] != BSL_REP_ACK){
+		sprd_log("end:sprd ack error\n");
+		return -1;
+	}
+	return 0;
+}
+
+/* read partition to file 
+*part_name - partition name
+*up_size - size of read
+*win_size - size of one receive
+*         Larger and faster, according to the mobile phone transmission capacity adjustment
+          win_size < mobile maximum transmission size
+*file_name - file to store
+*/
+int sprd_upload(char* part_name,uint32_t up_size,uint32_t win_size,char *file_name)
+{
+	int r;int cnt;
+
+	if(win_size > SPRD_READ_WINDOW)
+		win_size = SPRD_READ_WINDOW;
+	sprd_log("Saving partition:'%s'(size=0x%x) to '%s'\n",part_name,up_size,file_name);
+	r = sprd_read_start(part_name);
+	if(r != 0)
+		return r;
+	
+	/* middle */
+#ifdef SPRD_DEBUG
+	sprd_log("sprd upload step:middle\n");
+#endif
+	umask(0);
+	int fd = open(file_name,O_CREAT|O_WRONLY|O_TRUNC,00666);
+        if(fd == -1){
+               	sprd_log("middle:open or create %s error\n",file_name);
+	               return -1;
+        }
+	uint32_t up_size_count = up_size;
+	struct sprd_rate rate;
+	sprd_rate_start(&rate);
+	uint32_t offset = 0;
+	uint32_t s_size = 0;
+	while(up_size){
+		s_size = (up_size > win_size) ? win_size:up_size;
+		r = sprd_read_flash(NULL,s_size,offset);
+		if(r != 0){
+			sprd_log("middle:sprd read flash error:%d\n",r);
+			close(fd);
+			return r;
+		}
+		cnt = s_size + 8;
+		//write to file 	cnt = frame_size data_buffer = frame_pointer
+		STATS_T0(t_write);
+		r = write(fd,data_buffer+5,cnt-8);			
+		STATS_ADD(STATS_FILE_WRITE,t_write,r > 0 ? r : 0);
+		if(r == -1){
+			sprd_log("middle:write to %s error\n",file_name);
+			close(fd);
+			return r;	
+		}
+		if(r != cnt-8){
+			sprd_log("middle:write %x bytes,not complete\n",r);
+			close(fd);
+			return r;
+		}
+
+		offset += s_size;
+		up_size -= s_size;
+
+		if(sprd_progress("upload",offset,up_size_count) != 0){
+			sprd_log("middle:canceled\n");
+			close(fd);
+			return ECANCELED;
+		}
+	}
+
+	sprd_rate_report(&rate,up_size_count);
+	if(close(fd) != 0){
+		sprd_log("close file error\n");
+		return -1;
+	}
+	/* end */
+	return sprd_read_end();
+}
+
+int sprd_task_bootrom(void)
+{
+	int r;
+        char fdl_path[1024];
+        ssize_t s;
+
+	/* sprd version */
+	r = sprd_version();
+	if(r != 0) {
+		sprd_log("sprd version error\n");
+	}else{
+		sprd_log("sprd_version:%s\n",data_buffer+SPRD_FRAME_DATA_OFF);
+	}
+
+	/* sprd connect */
+	r = sprd_connect();
+	if(r != 0){
+		sprd_log("sprd_connect failed\n");
+		return r;
+	}else{
+		sprd_log("sprd_connect success\n");
+	}
+	
+	/* get fdl path */
+        s = readlink("/proc/self/exe",fdl_path,sizeof(fdl_path));
+        if(s > sizeof(fdl_path)){
+                sprd_log("error:fdl1.bin path too long\n");
+                return -1;
+        }
+        for(;fdl_path[s-1] != '/';s--);
+        fdl_path[s] = '\0';
+        strcat(fdl_path,"fdl1.bin");
+#ifdef SPRD_DEBUG
+        sprd_log("%s\n",fdl_path);
+#endif
+	/* sprd send fdl1 */
+	sprd_log("fdl1.bin file size is %d\n",(int)get_file_size(fdl_path));	
+	r = sprd_download(fdl_path,get_file_size(fdl_path),0x50000000,528);
+	if(r != 0){
+		sprd_log("sprd_download fdl1.bin error\n");
+		return r;
+	}else{
+		sprd_log("sprd_download fld1.bin success\n");
+	}
+
+	/* running fdl1 */
+	r = sprd_exec_data();
+	if(r != 0){
+		sprd_log("fdl1 exec failed\n");	
+		return r;
+	}else{
+		sprd_log("fdl1 running\n");
+	}
+	
+	return 0;
+}
+/* commucate with fdl1 */
+int sprd_task_fdl1(void)
+{
+        int r;int i = 0;
+	int cnt;
+        char fdl_path[1024];
+        ssize_t s;
+        /* sprd version */
+	for(i = 0;i < 2;i++){
+        	if(sprd_version())
+	                continue;
+        	else{
+                	sprd_log("sprd_version:%s\n",data_buffer+SPRD_FRAME_DATA_OFF);
+			break;
+		}
+        }
+
+        /* sprd connect */
+        r = sprd_connect();
+        if(r != 0){
+                sprd_log("sprd_connect failed\n");
+                return r;
+        }else{
+                sprd_log("sprd_connect success\n");
+        }
+
+	/* get fdl path */
+        s = readlink("/proc/self/exe",fdl_path,sizeof(fdl_path));
+        if(s > sizeof(fdl_path)){
+                sprd_log("error:fdl2.bin path too long\n");
+                return -1;
+        }
+        for(;fdl_path[s-1] != '/';s--);
+        fdl_path[s] = '\0';
+        strcat(fdl_path,"fdl2.bin");
+#ifdef SPRD_DEBUG
+        sprd_log("%s\n",fdl_path);
+#endif
+        /* sprd send fdl2 */
+        sprd_log("fdl2.bin file size is %d\n",(int)get_file_size(fdl_path));
+        r = sprd_download(fdl_path,get_file_size(fdl_path),0x9f000000,2112);
+        if(r != 0){
+                sprd_log("sprd_download fdl2.bin error\n");
+                return r;
+        }else{
+                sprd_log("sprd_download fld2.bin success\n");
+        }
+
+        /* running fdl2 */
+	sprd_com_nodata(BSL_CMD_EXEC_DATA);
+        for(i = 15;i ;i--){
+                if(sprd_usb_receive(data_buffer,(int*)&cnt) == 0)
+                        break;
+                else continue;
+        }
+        if(i){
+		if(sprd_verify_frame(data_buffer,cnt) == 0 && data_buffer[SPRD_FRAME_TYPE_OFF] == BSL_INCOMPATIBLE_PARTITION){
+			sprd_log("fdl2 running && imcompatible repartiton\n");
+			debug_print_hex(data_buffer,(int)cnt);
+		}
+	}else{
+		sprd_log("fdl2 exec failed\n");
+		return -1;
+	}
+	return 0;
+}
+/* read "internalsd" partition directioy "./DCIM/Camera/" to "syberos_camera" dir */
+int sprd_read_camera(void)
+{
+    int r;
+    int fd;
+    FRESULT fr;     /* Return value */
+    DIR dj;         /* Directory search object */
+    FILINFO fno;    /* File information */
+
+    uint32_t image_count = 0;
+
+    char path_dest[100]={'\0'};    
+    char path_src[100] ={'\0'};    
+
+    uint32_t r_size = 0;
+    uint32_t win_size = 0x3000;
+
+    uint32_t total_read_size;
+    uint32_t file_size;
+
+    void * buff_p = arena_alloc(win_size*2); //12k;
+    if(buff_p == NULL){
+	sprd_log("sprd_read_camera:malloc error\n");
+	return -1;
+    }
+
+    sprd_log("Saving \"/DCIM/Camera/\" to \"./syberos_camera/\"\n");	
+    /* create & open & clean "syberos_picture" dir (local) */
+    r = system("rm -rf syberos_camera ; mkdir syberos_camera ; chmod 777 syberos_camera");
+    if(r != 0){
+    	sprd_log("sprd_read_picture:system error:%d\n",r);
+	return r;
+    }
+
+    f_mount(&FatFs, "0:", 0); //drive number "0:" = USB device
+
+    fr = f_findfirst(&dj, &fno, "0:/DCIM/Camera", "*.jpg");  /* Start to search for photo files */
+    while (fr == FR_OK && fno.fname[0]) {         /* Repeat while an item is found */
+        sprd_log("%s\n", fno.fname);                /* Display the object name */
+	image_count++;
+	/* write image files to local disk */	
+	path_dest[0] = '\0';
+	path_src[0] = '\0';
+	strcat(path_dest,"./syberos_camera/");
+	strcat(path_src,"0:/DCIM/Camera/");
+
+        umask(0);
+        fd = open(strcat(path_dest,fno.fname),O_CREAT|O_WRONLY|O_TRUNC,00666);
+        if(fd == -1){
+                sprd_log("sprd_read_camera:open or create %s error\n",fno.fname);
+                return -1;
+        }
+
+	fr = f_open(&Fil,strcat(path_src,fno.fname),FA_READ);
+	if(fr){
+		sprd_log("sprd_read_camera:f_open error:%d\n",fr);
+		return -1;
+	}	
+	/* init percent task */
+	total_read_size = 0;
+	file_size = f_size(&Fil);
+	/* task */
+	fr = f_read(&Fil,buff_p,win_size,&r_size);
+	while(fr == FR_OK && r_size){
+                STATS_T0(t_write);
+                r = write(fd,buff_p,r_size);                      
+                STATS_ADD(STATS_FILE_WRITE,t_write,r > 0 ? r : 0);
+                if(r == -1){
+                        sprd_log("sprd_read_camera:write to %s error\n",fno.fname);
+                        return r;       
+                }
+                if(r != r_size){
+                        sprd_log("sprd_read_camera:write %x bytes,not complete\n",r);
+                        return r;
+                }
+		/* percent display */
+		total_read_size += r_size;
+                if(sprd_progress(NULL,total_read_size,file_size) != 0){
+                        sprd_log("sprd_read_camera:canceled\n");
+                        f_close(&Fil);
+                        close(fd);
+                        arena_free(buff_p);
+                        return ECANCELED;
+                }
+		/* read next data */			
+		fr = f_read(&Fil,buff_p,win_size,&r_size);
+	}
+	if(fr != FR_OK){
+		sprd_log("sprd_read_camera:f_read error:%d\n",fr);
+		return fr;
+	}
+	/* file is empty */
+	if(!file_size)
+		sprd_progress(NULL,0,0);
+	
+	f_close(&Fil);
+	close(fd);
+	
+        fr = f_findnext(&dj, &fno);               /* Search for next item */
+    }
+    if(fr != FR_OK){
+	sprd_log("sprd_read_camera:f_findfrist error:%d\n",fr);
+	return -1;
+    }
+    if(image_count == 0){
+	sprd_log("Not Found Image file\n");
+    }
+	
+    f_closedir(&dj);
+
+    /* send BSL_CMD_READ_FLASH_END cmd */
+    r = disk_ioctl(0,CTRL_SPRD_FAT_OPS_END,NULL);
+    if(r != 0){
+    	sprd_log("sprd_read_camera:disk ioctl error:%d\n",r);	
+	return r;
+    }
+
+    arena_free(buff_p);
+    return 0;
+}
+
+/* ext4fs streaming buffer: a multiple of the 12k transfer window, each
+ * physical extent run is fetched with one direct device read of up to
+ * this size and written out in one go */
+#define EXT4FS_STREAM_SIZE (0x3000*64) //768k
+
+struct ext4fs_sink {
+	int fd;
+	int progress;
+	uint64_t total;
+	uint64_t done;
+};
+
+static int ext4fs_sink_write(void *arg, const void *data, size_t len)
+{
+	struct ext4fs_sink *s = arg;
+	const char *p = data;
+	ssize_t r;
+
+	while(len){
+		STATS_T0(t_write);
+		r = write(s->fd,p,len);
+		STATS_ADD(STATS_FILE_WRITE,t_write,r > 0 ? r : 0);
+		if(r == -1){
+			if(errno == EINTR) continue;
+			sprd_log("ext4fs_sink_write:write error:%d\n",errno);
+			return EIO;
+		}
+		p += r;
+		len -= r;
+		s->done += r;
+	}
+	/* percent display */
+	if(s->progress && s->total && sprd_progress(NULL,s->done,s->total) != 0)
+		return ECANCELED;
+	return 0;
+}
+
+/* stream [offset,offset+length) of an ext4fs file to fd */
+static int sprd_stream_ext4fs(char *path, int fd, int progress, uint64_t offset, uint64_t length)
+{
+	int r;
+	ext4_file Fil;
+	struct ext4fs_sink sink;
+	uint64_t file_size;
+
+	void *buff_p = arena_alloc(EXT4FS_STREAM_SIZE);
+	if(buff_p == NULL){
+		sprd_log("sprd_stream_ext4fs:malloc error\n");
+		return -1;
+	}
+
+	r = ext4_fopen(&Fil, path, "rb");
+	if(r != 0){
+		sprd_log("ext4_open:error:%d\n",r);
+		arena_free(buff_p);
+		return r;
+	}
+
+	file_size = ext4_fsize(&Fil);
+	if(offset > file_size) offset = file_size;
+	if(length > file_size - offset) length = file_size - offset;
+	r = ext4_fseek(&Fil,offset,SEEK_SET);
+	if(r != EOK){
+		sprd_log("sprd_stream_ext4fs:ext4_fseek error:%d\n",r);
+		goto out;
+	}
+
+	sink.fd = fd;
+	sink.progress = progress;
+	sink.total = length;
+	sink.done = 0;
+
+	r = ext4_fstream(&Fil,length,buff_p,EXT4FS_STREAM_SIZE,ext4fs_sink_write,&sink,NULL);
+	if(r != EOK){
+		sprd_log("sprd_stream_ext4fs:ext4_fstream error:%d\n",r);
+		goto out;
+	}
+	/* file (or range) is empty */
+	if(progress && !length)
+		sprd_progress(NULL,0,0);
+out:
+	ext4_fclose(&Fil);
+	arena_free(buff_p);
+	return r;
+}
+
+/* mount the partition holding path, return the path inside it */
+static char *sprd_mount_ext4fs(char *path, const char *who)
+{
+        char *path_redirect = path;
+
+        /* local partition dump */
+        if(ext4fs_image != NULL){
+                ext4_imagedev_filename(ext4fs_image);
+                bd = ext4_imagedev_get();
+        }
+        /* partition detect */
+        else if(strncmp(path,"/data",5) == 0){
+                bd = ext4_datadev_get();
+                if(strlen(path) == 5){//root
+                        path_redirect = "/";
+                }
+                else    path_redirect = path + 5;
+        }
+        else {
+                bd = ext4_syberfsdev_get();
+                path_redirect = path;
+        }
+
+        if (!bd) {
+                sprd_log("%s:ext4_syberfsdev_get: no block device\n",who);
+                return NULL;
+        }
+        if (!test_lwext4_mount(bd, bc)){
+                sprd_log("%s:test_lwext4_mount:error\n",who);
+                return NULL;
+        }
+        return path_redirect;
+}
+
+/* umount, report zero padded reads of a truncated dump */
+static int sprd_umount_ext4fs(const char *who)
+{
+        struct ext4_imagedev_stats st;
+
+        if (!test_lwext4_umount()){
+                sprd_log("%s:test_lwext4_umount:error\n",who);
+                return EXIT_FAILURE;
+        }
+        if(ext4fs_image == NULL){
+                sprd_link_report();
+                return 0;
+        }
+
+        ext4_imagedev_stats(&st);
+        if(st.zero_meta_blocks){
+                sprd_log("warning:%llu metadata blocks read beyond the end of %s(first at byte %llu),listing may be incomplete\n",
+                        (unsigned long long)st.zero_meta_blocks,ext4fs_image,
+                        (unsigned long long)st.first_zero_meta*512);
+        }
+        else if(st.zero_blocks){
+                sprd_log("warning:%llu file data blocks read beyond the end of %s(zero filled)\n",
+                        (unsigned long long)st.zero_blocks,ext4fs_image);
+        }
+        return 0;
+}
+
+static char *ext4fs_path_join(const char *dir, const char *name, int len)
+{
+	size_t dlen = strlen(dir);
+	char *p = malloc(dlen + len + 2);
+
+	if(p == NULL)
+		return NULL;
+	memcpy(p,dir,dlen);
+	if(dlen == 0 || dir[dlen-1] != '/')
+		p[dlen++] = '/';
+	memcpy(p + dlen,name,len);
+	p[dlen + len] = '\0';
+	return p;
+}
+
+/* mtime with the nanoseconds and epoch bits of large inodes */
+static void ext4fs_inode_mtime(struct ext4_sblock *sb, struct ext4_inode *inode, struct timespec *ts)
+{
+	uint32_t extra;
+
+	ts->tv_sec = (int32_t)ext4_inode_get_modif_time(inode);
+	ts->tv_nsec = 0;
+	if(ext4_inode_get_extra_isize(sb,inode) >=
+	   offsetof(struct ext4_inode,mtime_extra) + 4 - EXT4_GOOD_OLD_INODE_SIZE){
+		extra = to_le32(inode->mtime_extra);
+		ts->tv_sec += (int64_t)(extra & 3) << 32;
+		ts->tv_nsec = extra >> 2;
+	}
+}
+
+/* ls -l/-R: a directory is read in full first,then the inodes of all its
+ * entries come in one batch (a few inode table reads instead of a path
+ * walk and a table block fetch per entry) */
+static int ext4fs_ls_long = 0;
+static int ext4fs_ls_recursive = 0;
+
+struct ext4fs_dent {
+	char *name;
+	uint32_t ino;
+	uint8_t type;
+};
+
+static int ext4fs_dent_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct ext4fs_dent *)a)->name,((const struct ext4fs_dent *)b)->name);
+}
+
+static void ext4fs_ls_mode(char *s, uint32_t mode)
+{
+	static const char *rwx = "rwxrwxrwx";
+	int i;
+
+	switch(mode & EXT4_INODE_MODE_TYPE_MASK){
+	case EXT4_INODE_MODE_DIRECTORY:s[0] = 'd';break;
+	case EXT4_INODE_MODE_SOFTLINK:s[0] = 'l';break;
+	case EXT4_INODE_MODE_CHARDEV:s[0] = 'c';break;
+	case EXT4_INODE_MODE_BLOCKDEV:s[0] = 'b';break;
+	case EXT4_INODE_MODE_FIFO:s[0] = 'p';break;
+	case EXT4_INODE_MODE_SOCKET:s[0] = 's';break;
+	default:s[0] = '-';break;
+	}
+	for(i = 0;i < 9;i++)
+		s[i+1] = (mode & (0400 >> i)) ? rwx[i] : '-';
+	if(mode & 04000) s[3] = (mode & 0100) ? 's' : 'S';
+	if(mode & 02000) s[6] = (mode & 0010) ? 's' : 'S';
+	if(mode & 01000) s[9] = (mode & 0001) ? 't' : 'T';
+	s[10] = '\0';
+}
+
+static void ext4fs_ls_entry(struct ext4_sblock *sb, const char *src, struct ext4fs_dent *e, struct ext4_inode *inode)
+{
+	char mode[11], size[24], date[24], target[PATH_MAX];
+	struct timespec mtime;
+	struct tm tm;
+	uint32_t m = ext4_inode_get_mode(sb,inode), dev;
+	size_t rcnt;
+	char *path;
+
+	ext4fs_ls_mode(mode,m);
+	if(mode[0] == 'c' || mode[0] == 'b'){
+		dev = ext4_inode_get_dev(inode);
+		sprintf(size,"%u,%4u",(dev & 0xfff00) >> 8,(dev & 0xff) | ((dev >> 12) & 0xfff00));
+	}
+	else
+		sprintf(size,"%llu",(unsigned long long)ext4_inode_get_size(sb,inode));
+	ext4fs_inode_mtime(sb,inode,&mtime);
+	localtime_r(&mtime.tv_sec,&tm);
+	strftime(date,sizeof(date),"%Y-%m-%d %H:%M",&tm);
+
+	sprd_out("%s %3u %5u %5u %10s %s %s",mode,ext4_inode_get_links_cnt(inode),
+		ext4_inode_get_uid(inode),ext4_inode_get_gid(inode),size,date,e->name);
+	if(mode[0] == 'l'){
+		path = ext4fs_path_join(src,e->name,strlen(e->name));
+		if(path != NULL && ext4_readlink(path,target,sizeof(target) - 1,&rcnt) == EOK){
+			target[rcnt] = '\0';
+			sprd_out(" -> %s",target);
+		}
+		free(path);
+	}
+	sprd_out("\n");
+}
+
+/* list src,shown is the path as the user typed it */
+static int ext4fs_ls_dir(const char *src, const char *shown, struct ext4_sblock *sb)
+{
+	ext4_dir d;
+	const ext4_direntry *de;
+	struct ext4fs_dent *v = NULL, *p;
+	struct ext4_inode *inodes = NULL;
+	uint32_t *inos = NULL;
+	uint32_t cnt = 0, cap = 0, i;
+	char *csrc, *cshown;
+	int r, r2;
+
+	r = ext4_dir_open(&d,src);
+	if(r != EOK){
+		sprd_log("ext4fs_ls_dir:ext4_dir_open %s error:%d\n",shown,r);
+		return r;
+	}
+	while((de = ext4_dir_entry_next(&d)) != NULL){
+		if((de->name_length == 1 && de->name[0] == '.') ||
+		   (de->name_length == 2 && de->name[0] == '.' && de->name[1] == '.'))
+			continue;
+		if(cnt == cap){
+			cap = cap ? cap * 2 : 256;
+			p = realloc(v,cap * sizeof(struct ext4fs_dent));
+			if(p == NULL){
+				r = ENOMEM;
+				break;
+			}
+			v = p;
+		}
+		v[cnt].name = strndup((char *)de->name,de->name_length);
+		v[cnt].ino = de->inode;
+		v[cnt].type = de->inode_type;
+		if(v[cnt].name == NULL){
+			r = ENOMEM;
+			break;
+		}
+		cnt++;
+	}
+	ext4_dir_close(&d);
+	if(r != EOK)
+		goto out;
+	qsort(v,cnt,sizeof(struct ext4fs_dent),ext4fs_dent_cmp);
+
+	if(ext4fs_ls_recursive)
+		sprd_out("%s:\n",shown);
+	if(ext4fs_ls_long && cnt){
+		inos = malloc(cnt * sizeof(uint32_t));
+		inodes = malloc(cnt * sizeof(struct ext4_inode));
+		if(inos == NULL || inodes == NULL){
+			r = ENOMEM;
+			goto out;
+		}
+		for(i = 0;i < cnt;i++)
+			inos[i] = v[i].ino;
+		r = ext4_inodes_prefetch("/",inos,cnt,inodes);
+		if(r != EOK){
+			sprd_log("ext4fs_ls_dir:ext4_inodes_prefetch %s error:%d\n",shown,r);
+			goto out;
+		}
+		for(i = 0;i < cnt;i++)
+			ext4fs_ls_entry(sb,src,&v[i],&inodes[i]);
+		free(inodes);
+		inodes = NULL;
+	}
+	else{
+		for(i = 0;i < cnt;i++)
+			sprd_out("%s%s\n",v[i].name,v[i].type == EXT4_DE_DIR ? "/" : "");
+	}
+
+	for(i = 0;ext4fs_ls_recursive && i < cnt;i++){
+		if(v[i].type != EXT4_DE_DIR)
+			continue;
+		csrc = ext4fs_path_join(src,v[i].name,strlen(v[i].name));
+		cshown = ext4fs_path_join(shown,v[i].name,strlen(v[i].name));
+		sprd_out("\n");
+		/* an unreadable subdirectory is reported,the rest still listed,
+		 * its error returned */
+		if(csrc != NULL && cshown != NULL)
+			r2 = ext4fs_ls_dir(csrc,cshown,sb);
+		else
+			r2 = ENOMEM;
+		if(r == EOK)
+			r = r2;
+		free(csrc);
+		free(cshown);
+	}
+out:
+	for(i = 0;i < cnt;i++)
+		free(v[i].name);
+	free(v);
+	free(inos);
+	free(inodes);
+	return r;
+}
+
+static double ext4fs_ms(struct timespec *t0)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return (t.tv_sec - t0->tv_sec) * 1e3 + (t.tv_nsec - t0->tv_nsec) / 1e6;
+}
+
+int sprd_ls_ext4fs(char *path)
+{
+        char *path_redirect;
+	struct ext4_sblock *sb;
+	struct timespec t0;
+	double mount_ms,first_ms;
+	uint32_t mount_reads,first_reads;
+	ext4_dir d;
+	int r;
+
+	clock_gettime(CLOCK_MONOTONIC,&t0);
+        path_redirect = sprd_mount_ext4fs(path,"sprd_ls_ext4fs");
+        if(path_redirect == NULL)
+                return -1;
+	mount_ms = ext4fs_ms(&t0);
+	mount_reads = bd->bdif->bread_ctr;
+
+	/* time to the first directory entry,the listing reads it again from cache */
+	r = ext4_dir_open(&d,path_redirect);
+	if(r == EOK){
+		ext4_dir_entry_next(&d);
+		ext4_dir_close(&d);
+	}
+	first_ms = ext4fs_ms(&t0);
+	first_reads = bd->bdif->bread_ctr;
+
+	sprd_log("ls %s\n", path);
+	if(ext4fs_ls_long || ext4fs_ls_recursive){
+		ext4_get_sblock("/",&sb);
+		r = ext4fs_ls_dir(path_redirect,path,sb);
+	}
+	else {
+		/* the plain listing is printed by the lwext4 test glue,
+		 * r:the open above */
+		test_lwext4_set_printf(sprd_out);
+		test_lwext4_dir_ls(path_redirect);
+		test_lwext4_set_printf(sprd_log);
+	}
+	sprd_log("mount %.1f ms(%u reads),first entry %.1f ms(%u reads),done %.1f ms(%u reads)\n",
+		mount_ms,mount_reads,first_ms,first_reads,ext4fs_ms(&t0),bd->bdif->bread_ctr);
+
+	if(sprd_umount_ext4fs("sprd_ls_ext4fs") != 0)
+		return EXIT_FAILURE;
+	return r;
+}
+
+int sprd_read_ext4fs(char *path, uint64_t offset, uint64_t length)
+{
+	int i;int r;
+        char *path_redirect;
+	char *path_dest;
+	int fd;
+
+        path_redirect = sprd_mount_ext4fs(path,"sprd_read_ext4fs");
+        if(path_redirect == NULL)
+                return -1;
+
+	/* prase pathname */
+	path_dest = path_redirect;
+	for(i = 0;i < strlen(path_redirect);i++){
+		if(path_redirect[i] == '/'){
+			path_dest = path_redirect + i + 1;
+		}
+	}
+	if(path_dest[0] == '\0'){
+		sprd_log("File name Format error\n");
+		test_lwext4_umount();
+		return -1;
+	}
+        sprd_log("get %s ---> %s\n",path ,path_dest);
+
+        umask(0);
+        fd = open(path_dest,O_CREAT|O_WRONLY|O_TRUNC,00666);
+        if(fd == -1){
+                sprd_log("sprd_read_ext4fs:open or create %s error\n",path_dest);
+                test_lwext4_umount();
+                return -1;
+        }
+
+	/* get file task */
+	r = sprd_stream_ext4fs(path_redirect,fd,1,offset,length);
+	close(fd);
+
+        if(sprd_umount_ext4fs("sprd_read_ext4fs") != 0)
+                return EXIT_FAILURE;
+
+	return r;
+}
+
+
+int sprd_cat_ext4fs(char *path, uint64_t offset, uint64_t length)
+{
+	int r;
+        char *path_redirect;
+
+        path_redirect = sprd_mount_ext4fs(path,"sprd_cat_ext4fs");
+        if(path_redirect == NULL)
+                return -1;
+
+        sprd_log("cat %s\n",path);
+
+	/* cat file task */
+	r = sprd_stream_ext4fs(path_redirect,sprd_out_fd(),0,offset,length);
+
+        if(sprd_umount_ext4fs("sprd_cat_ext4fs") != 0)
+                return EXIT_FAILURE;
+
+	return r;
+}
+
+/* ext4fs extract: the tree is walked once (directories and symlinks are
+ * created on the way), regular files are then copied by worker threads
+ * sharing the read only mount */
+#define EXT4FS_JOBS_MAX 64
+#define EXT4FS_COPY_MIN (64*1024) //image runs from this size on go through copy_file_range
+
+struct ext4fs_node {
+	char *src;	//path in the mount point
+	char *dst;	//host path
+	uint64_t size;
+	uint32_t mode;
+	struct timespec mtime;
+};
+
+struct ext4fs_extract {
+	struct ext4fs_node *files;
+	uint32_t files_cnt;
+	uint32_t files_cap;
+	struct ext4fs_node *dirs;
+	uint32_t dirs_cnt;
+	uint32_t dirs_cap;
+	uint32_t links;
+	uint32_t skipped;
+	int img_fd;		//dump opened for copy_file_range,-1 on the device
+	uint32_t next;		//next file to copy (atomic)
+	uint32_t running;	//workers still copying (atomic)
+	uint64_t total;
+	uint64_t done;		//bytes written (atomic)
+	uint64_t copied;	//bytes moved by copy_file_range (atomic)
+	int err;
+};
+
+static int ext4fs_node_add(struct ext4fs_node **v, uint32_t *cnt, uint32_t *cap,
+			   char *src, char *dst, uint64_t size, uint32_t mode, struct timespec *mtime)
+{
+	if(*cnt == *cap){
+		uint32_t n = *cap ? *cap * 2 : 1024;
+		struct ext4fs_node *p = realloc(*v,n * sizeof(struct ext4fs_node));
+		if(p == NULL)
+			return ENOMEM;
+		*v = p;
+		*cap = n;
+	}
+	(*v)[*cnt].src = src;
+	(*v)[*cnt].dst = dst;
+	(*v)[*cnt].size = size;
+	(*v)[*cnt].mode = mode;
+	(*v)[*cnt].mtime = *mtime;
+	(*cnt)++;
+	return 0;
+}
+
+static int ext4fs_extract_link(struct ext4fs_extract *x, const char *src, const char *dst, struct timespec *mtime)
+{
+	char target[PATH_MAX];
+	size_t rcnt;
+	struct timespec ts[2];
+	int r;
+
+	r = ext4_readlink(src,target,sizeof(target) - 1,&rcnt);
+	if(r != EOK){
+		sprd_log("ext4fs_extract_link:ext4_readlink %s error:%d\n",src,r);
+		return r;
+	}
+	target[rcnt] = '\0';
+
+	if(symlink(target,dst) != 0 && (errno != EEXIST || unlink(dst) != 0 || symlink(target,dst) != 0)){
+		sprd_log("ext4fs_extract_link:symlink %s error:%d\n",dst,errno);
+		return errno;
+	}
+	ts[0].tv_sec = 0;
+	ts[0].tv_nsec = UTIME_OMIT;
+	ts[1] = *mtime;
+	utimensat(AT_FDCWD,dst,ts,AT_SYMLINK_NOFOLLOW);
+	x->links++;
+	return 0;
+}
+
+/* walk src,create directories and symlinks under dst,queue regular files */
+static int ext4fs_extract_walk(struct ext4fs_extract *x, const char *src, const char *dst)
+{
+	ext4_dir d;
+	const ext4_direntry *de;
+	struct ext4_sblock *sb;
+	struct ext4_inode inode;
+	struct timespec mtime;
+	uint32_t ino, mode;
+	char *csrc, *cdst;
+	int r;
+
+	ext4_get_sblock("/",&sb);
+	r = ext4_dir_open(&d,src);
+	if(r != EOK){
+		sprd_log("ext4fs_extract_walk:ext4_dir_open %s error:%d\n",src,r);
+		return r;
+	}
+
+	while((de = ext4_dir_entry_next(&d)) != NULL){
+		if((de->name_length == 1 && de->name[0] == '.') ||
+		   (de->name_length == 2 && de->name[0] == '.' && de->name[1] == '.'))
+			continue;
+
+		csrc = ext4fs_path_join(src,(char *)de->name,de->name_length);
+		cdst = ext4fs_path_join(dst,(char *)de->name,de->name_length);
+		if(csrc == NULL || cdst == NULL){
+			r = ENOMEM;
+			goto next;
+		}
+		r = ext4_fill_raw_inode(csrc,&ino,&inode);
+		if(r != EOK){
+			/* keep going,report at the end */
+			sprd_log("ext4fs_extract_walk:ext4_fill_raw_inode %s error:%d\n",csrc,r);
+			x->err = r;
+			r = 0;
+			goto next;
+		}
+		mode = ext4_inode_get_mode(sb,&inode) & 07777;
+		ext4fs_inode_mtime(sb,&inode,&mtime);
+
+		switch(de->inode_type){
+		case EXT4_DE_DIR:
+			if(mkdir(cdst,0700) != 0 && errno != EEXIST){
+				sprd_log("ext4fs_extract_walk:mkdir %s error:%d\n",cdst,errno);
+				r = errno;
+				goto next;
+			}
+			/* modes and mtimes of directories are set last */
+			r = ext4fs_node_add(&x->dirs,&x->dirs_cnt,&x->dirs_cap,csrc,cdst,0,mode,&mtime);
+			if(r != 0)
+				goto next;
+			r = ext4fs_extract_walk(x,csrc,cdst);
+			csrc = cdst = NULL;
+			break;
+		case EXT4_DE_REG_FILE:
+			r = ext4fs_node_add(&x->files,&x->files_cnt,&x->files_cap,csrc,cdst,
+					    ext4_inode_get_size(sb,&inode),mode,&mtime);
+			if(r != 0)
+				goto next;
+			x->total += ext4_inode_get_size(sb,&inode);
+			csrc = cdst = NULL;
+			break;
+		case EXT4_DE_SYMLINK:
+			r = ext4fs_extract_link(x,csrc,cdst,&mtime);
+			break;
+		default:
+			/* device nodes,fifos,sockets need root,not extracted */
+			x->skipped++;
+			break;
+		}
+next:
+		free(csrc);
+		free(cdst);
+		if(r != 0)
+			break;
+	}
+	ext4_dir_close(&d);
+	return r;
+}
+
+/* copy one regular file:image runs with copy_file_range,holes stay holes,
+ * the rest (device,overlaid or truncated blocks) streamed through lwext4 */
+static int ext4fs_extract_file(struct ext4fs_extract *x, struct ext4fs_node *n, void *buf)
+{
+	ext4_file f;
+	struct ext4fs_sink sink;
+	struct timespec ts[2];
+	uint64_t dev_off, len, cnt;
+	loff_t off_in;
+	ssize_t c;
+	int fd;
+	int r;
+
+	fd = open(n->dst,O_CREAT|O_WRONLY|O_TRUNC,0600);
+	if(fd == -1){
+		sprd_log("ext4fs_extract_file:open %s error:%d\n",n->dst,errno);
+		return errno;
+	}
+	r = ext4_fopen(&f,n->src,"rb");
+	if(r != EOK){
+		sprd_log("ext4fs_extract_file:ext4_fopen %s error:%d\n",n->src,r);
+		close(fd);
+		return r;
+	}
+
+	memset(&sink,0,sizeof(sink));
+	sink.fd = fd;
+	while(1){
+		r = ext4_fmap(&f,&dev_off,&len);
+		if(r == ENOTSUP){
+			/* inline symlink data or journal overlay:no plain device runs */
+			r = ext4_fstream(&f,n->size,buf,EXT4FS_STREAM_SIZE,ext4fs_sink_write,&sink,&cnt);
+			__atomic_add_fetch(&x->done,cnt,__ATOMIC_RELAXED);
+			break;
+		}
+		if(r != EOK || len == 0)
+			break;
+
+		if(dev_off == 0){
+			/* hole */
+			lseek(fd,len,SEEK_CUR);
+			__atomic_add_fetch(&x->done,len,__ATOMIC_RELAXED);
+			r = ext4_fseek(&f,ext4_ftell(&f) + len,SEEK_SET);
+			if(r != EOK)
+				break;
+			continue;
+		}
+
+		if(x->img_fd != -1 && len >= EXT4FS_COPY_MIN){
+			off_in = dev_off;
+			while(off_in < dev_off + len){
+				c = copy_file_range(x->img_fd,&off_in,fd,NULL,dev_off + len - off_in,0);
+				if(c <= 0)
+					break; //past the end of the dump or not supported here
+			}
+			cnt = off_in - dev_off;
+			__atomic_add_fetch(&x->done,cnt,__ATOMIC_RELAXED);
+			__atomic_add_fetch(&x->copied,cnt,__ATOMIC_RELAXED);
+			r = ext4_fseek(&f,ext4_ftell(&f) + cnt,SEEK_SET);
+			if(r != EOK)
+				break;
+			len -= cnt;
+			if(len == 0)
+				continue;
+		}
+
+		r = ext4_fstream(&f,len,buf,EXT4FS_STREAM_SIZE,ext4fs_sink_write,&sink,&cnt);
+		__atomic_add_fetch(&x->done,cnt,__ATOMIC_RELAXED);
+		if(r != EOK)
+			break;
+	}
+	ext4_fclose(&f);
+	if(r != EOK)
+		sprd_log("ext4fs_extract_file:%s error:%d\n",n->src,r);
+
+	/* trailing hole */
+	if(r == EOK && ftruncate(fd,n->size) != 0)
+		r = errno;
+	fchmod(fd,n->mode);
+	ts[0].tv_sec = 0;
+	ts[0].tv_nsec = UTIME_OMIT;
+	ts[1] = n->mtime;
+	futimens(fd,ts);
+	close(fd);
+	return r;
+}
+
+static void *ext4fs_extract_worker(void *arg)
+{
+	struct ext4fs_extract *x = arg;
+	uint32_t i;
+	int r;
+	void *buf = arena_alloc(EXT4FS_STREAM_SIZE);
+
+	if(buf == NULL){
+		__atomic_store_n(&x->err,ENOMEM,__ATOMIC_RELAXED);
+		goto out;
+	}
+	while((i = __atomic_fetch_add(&x->next,1,__ATOMIC_RELAXED)) < x->files_cnt){
+		r = ext4fs_extract_file(x,&x->files[i],buf);
+		if(r != 0)
+			__atomic_store_n(&x->err,r,__ATOMIC_RELAXED);
+	}
+	arena_free(buf);
+out:
+	__atomic_sub_fetch(&x->running,1,__ATOMIC_RELEASE);
+	return NULL;
+}
+
+/* largest first,so the last files finish together */
+static int ext4fs_node_cmp(const void *a, const void *b)
+{
+	const struct ext4fs_node *na = a, *nb = b;
+	return na->size < nb->size ? 1 : na->size > nb->size ? -1 : 0;
+}
+
+int sprd_extract_ext4fs(char *path, char *dest, int jobs)
+{
+	struct ext4fs_extract x;
+	struct timespec ts[2], t0, t1;
+	pthread_t th[EXT4FS_JOBS_MAX];
+	char *path_redirect;
+	uint32_t i;
+	double sec;
+	int r;
+
+	memset(&x,0,sizeof(x));
+	x.img_fd = -1;
+
+	if(mkdir(dest,0755) != 0 && errno != EEXIST){
+		sprd_log("sprd_extract_ext4fs:mkdir %s error:%d\n",dest,errno);
+		return -1;
+	}
+	path_redirect = sprd_mount_ext4fs(path,"sprd_extract_ext4fs");
+	if(path_redirect == NULL)
+		return -1;
+	if(ext4fs_image != NULL)
+		x.img_fd = open(ext4fs_image,O_RDONLY);
+
+	sprd_log("extract %s ---> %s\n",path,dest);
+	clock_gettime(CLOCK_MONOTONIC,&t0);
+
+	r = ext4fs_extract_walk(&x,path_redirect,dest);
+	if(r != 0)
+		goto out;
+	qsort(x.files,x.files_cnt,sizeof(struct ext4fs_node),ext4fs_node_cmp);
+
+	if(jobs > (int)x.files_cnt)
+		jobs = x.files_cnt ? x.files_cnt : 1;
+	x.running = jobs;
+	for(i = 0;i < jobs;i++){
+		if(pthread_create(&th[i],NULL,ext4fs_extract_worker,&x) != 0){
+			sprd_log("sprd_extract_ext4fs:pthread_create error\n");
+			/* the started workers drain the queue */
+			__atomic_sub_fetch(&x.running,jobs - i,__ATOMIC_RELEASE);
+			jobs = i;
+			if(jobs == 0){
+				r = -1;
+				goto out;
+			}
+			break;
+		}
+	}
+	/* percent display,a cancel lets the files being copied finish */
+	do{
+		if(__atomic_load_n(&x.running,__ATOMIC_ACQUIRE))
+			usleep(200000);
+		if(x.total && sprd_progress(NULL,__atomic_load_n(&x.done,__ATOMIC_RELAXED),x.total) != 0){
+			__atomic_store_n(&x.next,x.files_cnt,__ATOMIC_RELAXED);
+			__atomic_store_n(&x.err,ECANCELED,__ATOMIC_RELAXED);
+		}
+	}while(__atomic_load_n(&x.running,__ATOMIC_ACQUIRE));
+	for(i = 0;i < jobs;i++)
+		pthread_join(th[i],NULL);
+	if(r == 0)
+		r = x.err;
+
+	/* deepest directories first,a read only parent must come last */
+	for(i = x.dirs_cnt;i--;){
+		chmod(x.dirs[i].dst,x.dirs[i].mode);
+		ts[0].tv_sec = 0;
+		ts[0].tv_nsec = UTIME_OMIT;
+		ts[1] = x.dirs[i].mtime;
+		utimensat(AT_FDCWD,x.dirs[i].dst,ts,0);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC,&t1);
+	sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	sprd_log("%u files,%u dirs,%u symlinks,%llu Bytes in %.2fs(%.1f MB/s,%d jobs,%llu Bytes by copy_file_range)\n",
+		x.files_cnt,x.dirs_cnt,x.links,(unsigned long long)x.done,sec,
+		sec > 0 ? x.done / sec / 1e6 : 0.0,jobs,(unsigned long long)x.copied);
+	if(x.skipped)
+		sprd_log("warning:%u device nodes/fifos/sockets not extracted\n",x.skipped);
+out:
+	for(i = 0;i < x.files_cnt;i++){
+		free(x.files[i].src);
+		free(x.files[i].dst);
+	}
+	for(i = 0;i < x.dirs_cnt;i++){
+		free(x.dirs[i].src);
+		free(x.dirs[i].dst);
+	}
+	free(x.files);
+	free(x.dirs);
+	if(x.img_fd != -1)
+		close(x.img_fd);
+	if(sprd_umount_ext4fs("sprd_extract_ext4fs") != 0)
+		return EXIT_FAILURE;
+	return r;
+}
+
+/* ext4fs tar: one pass over the tree into a ustar archive,pax records carry
+ * what ustar cannot hold (long names,big values,sub second mtimes,xattrs) */
+#define EXT4FS_TAR_BLOCK 512
+#define EXT4FS_TAR_RECORD (EXT4FS_TAR_BLOCK*20)
+#define EXT4FS_TAR_BUF (1024*1024) //headers and small files are batched
+
+struct ext4fs_tar_link {
+	uint32_t ino;
+	char *name;
+};
+
+struct ext4fs_tar {
+	int fd;
+	char *buf;		//output batch
+	size_t len;
+	void *data;		//file streaming buffer,also holds one xattr value
+	char *pax;		//pax records of the current entry
+	size_t pax_len;
+	size_t pax_cap;
+	char *xlist;		//listxattr names
+	size_t xlist_cap;
+	struct ext4fs_tar_link *hl;	//regular files with more than one link
+	uint32_t hl_cnt;
+	uint32_t hl_cap;
+	struct ext4_sblock *sb;
+	uint64_t bytes;		//archive size
+	uint64_t data_bytes;
+	uint32_t files;
+	uint32_t dirs;
+	uint32_t links;
+	uint32_t hardlinks;
+	uint32_t nodes;
+	uint32_t skipped;
+	int out_err;		//archive write failed,nothing more to do
+	int err;		//some entry could not be read
+};
+
+static int ext4fs_tar_flush(struct ext4fs_tar *t, const void *data, size_t len)
+{
+	const char *p = data;
+	ssize_t r;
+
+	while(len){
+		STATS_T0(t_write);
+		r = write(t->fd,p,len);
+		STATS_ADD(STATS_FILE_WRITE,t_write,r > 0 ? r : 0);
+		if(r == -1){
+			if(errno == EINTR) continue;
+			sprd_log("ext4fs_tar_flush:write error:%d\n",errno);
+			t->out_err = EIO;
+			return EIO;
+		}
+		p += r;
+		len -= r;
+	}
+	return 0;
+}
+
+/* archive output,also the ext4_fstream sink */
+static int ext4fs_tar_out(void *arg, const void *data, size_t len)
+{
+	struct ext4fs_tar *t = arg;
+	size_t n;
+	int r;
+
+	if(t->out_err)
+		return t->out_err;
+	t->bytes += len;
+	while(len){
+		if(len >= EXT4FS_TAR_BUF/2){
+			/* big runs skip the copy */
+			r = ext4fs_tar_flush(t,t->buf,t->len);
+			t->len = 0;
+			return r != 0 ? r : ext4fs_tar_flush(t,data,len);
+		}
+		n = EXT4FS_TAR_BUF - t->len;
+		if(n > len) n = len;
+		memcpy(t->buf + t->len,data,n);
+		t->len += n;
+		data = (const char *)data + n;
+		len -= n;
+		if(t->len == EXT4FS_TAR_BUF){
+			r = ext4fs_tar_flush(t,t->buf,t->len);
+			t->len = 0;
+			if(r != 0)
+				return r;
+		}
+	}
+	return 0;
+}
+
+/* zeros up to the next multiple of align */
+static int ext4fs_tar_pad(struct ext4fs_tar *t, uint32_t align)
+{
+	static const char zero[EXT4FS_TAR_BLOCK];
+	uint32_t n = (align - t->bytes % align) % align;
+	uint32_t c;
+	int r = 0;
+
+	while(n && r == 0){
+		c = n > sizeof(zero) ? sizeof(zero) : n;
+		r = ext4fs_tar_out(t,zero,c);
+		n -= c;
+	}
+	return r;
+}
+
+/* "len key=value\n",len counts its own digits */
+static int ext4fs_tar_pax(struct ext4fs_tar *t, const char *key, const void *val, size_t vlen)
+{
+	size_t n = strlen(key) + vlen + 3;
+	size_t len = n + 1;
+	char *p;
+	int d;
+
+	while(len != n + (size_t)snprintf(NULL,0,"%zu",len))
+		len = n + snprintf(NULL,0,"%zu",len);
+	if(t->pax_len + len > t->pax_cap){
+		size_t cap = (t->pax_len + len) * 2;
+		p = realloc(t->pax,cap);
+		if(p == NULL)
+			return ENOMEM;
+		t->pax = p;
+		t->pax_cap = cap;
+	}
+	p = t->pax + t->pax_len;
+	d = sprintf(p,"%zu %s=",len,key);
+	memcpy(p + d,val,vlen);
+	p[d + vlen] = '\n';
+	t->pax_len += len;
+	return 0;
+}
+
+static int ext4fs_tar_pax_num(struct ext4fs_tar *t, const char *key, uint64_t v)
+{
+	char s[24];
+	return ext4fs_tar_pax(t,key,s,sprintf(s,"%llu",(unsigned long long)v));
+}
+
+/* NUL terminated octal field,false (field zeroed) if v does not fit */
+static bool ext4fs_tar_octal(char *field, int size, uint64_t v)
+{
+	if((v >> (3 * (size - 1))) != 0){
+		memset(field,'0',size - 1);
+		return false;
+	}
+	snprintf(field,size,"%0*llo",size - 1,(unsigned long long)v);
+	return true;
+}
+
+static void ext4fs_tar_chksum(char *h)
+{
+	uint32_t sum = 0;
+	int i;
+
+	memset(h + 148,' ',8);
+	for(i = 0;i < EXT4FS_TAR_BLOCK;i++)
+		sum += (unsigned char)h[i];
+	snprintf(h + 148,8,"%06o",sum);
+}
+
+/* xattrs as SCHILY.xattr records,read by gnu tar,bsdtar and star */
+static int ext4fs_tar_xattrs(struct ext4fs_tar *t, const char *src)
+{
+	char key[16 + 256];
+	size_t size = 0, vsize;
+	char *name;
+	int r;
+
+	r = ext4_listxattr(src,NULL,0,&size);
+	if(r != EOK || size == 0)
+		return r;
+	if(size > t->xlist_cap){
+		name = realloc(t->xlist,size);
+		if(name == NULL)
+			return ENOMEM;
+		t->xlist = name;
+		t->xlist_cap = size;
+	}
+	r = ext4_listxattr(src,t->xlist,size,&size);
+	if(r != EOK)
+		return r;
+
+	for(name = t->xlist;name < t->xlist + size;name += strlen(name) + 1){
+		/* a value is at most one fs block */
+		r = ext4_getxattr(src,name,strlen(name),t->data,EXT4FS_STREAM_SIZE,&vsize);
+		if(r != EOK)
+			return r;
+		snprintf(key,sizeof(key),"SCHILY.xattr.%s",name);
+		r = ext4fs_tar_pax(t,key,t->data,vsize);
+		if(r != 0)
+			return r;
+	}
+	return 0;
+}
+
+/* pax header (when needed) and ustar header of one entry */
+static int ext4fs_tar_header(struct ext4fs_tar *t, const char *src, const char *name, char type,
+			     const char *link, struct ext4_inode *inode, uint64_t size)
+{
+	char h[EXT4FS_TAR_BLOCK], x[EXT4FS_TAR_BLOCK], s[32];
+	struct timespec mtime;
+	size_t nlen = strlen(name);
+	const char *slash, *base;
+	uint32_t dev;
+	int r = 0;
+	int i;
+
+	memset(h,0,sizeof(h));
+	t->pax_len = 0;
+
+	/* name,split as prefix/name when longer than 100 */
+	if(nlen <= 100)
+		memcpy(h,name,nlen);
+	else{
+		slash = NULL;
+		for(i = 0;i <= 155 && i < (int)nlen - 1 && slash == NULL;i++)
+			if(name[i] == '/' && nlen - i - 1 <= 100)
+				slash = name + i;
+		if(slash != NULL){
+			memcpy(h + 345,name,slash - name);
+			memcpy(h,slash + 1,nlen - (slash - name) - 1);
+		}
+		else{
+			memcpy(h,name,100);
+			r = ext4fs_tar_pax(t,"path",name,nlen);
+		}
+	}
+	if(link != NULL){
+		memcpy(h + 157,link,strlen(link) > 100 ? 100 : strlen(link));
+		if(r == 0 && strlen(link) > 100)
+			r = ext4fs_tar_pax(t,"linkpath",link,strlen(link));
+	}
+
+	ext4fs_inode_mtime(t->sb,inode,&mtime);
+	ext4fs_tar_octal(h + 100,8,ext4_inode_get_mode(t->sb,inode) & 07777);
+	if(r == 0 && !ext4fs_tar_octal(h + 108,8,ext4_inode_get_uid(inode)))
+		r = ext4fs_tar_pax_num(t,"uid",ext4_inode_get_uid(inode));
+	if(r == 0 && !ext4fs_tar_octal(h + 116,8,ext4_inode_get_gid(inode)))
+		r = ext4fs_tar_pax_num(t,"gid",ext4_inode_get_gid(inode));
+	if(r == 0 && !ext4fs_tar_octal(h + 124,12,size))
+		r = ext4fs_tar_pax_num(t,"size",size);
+	if((mtime.tv_sec < 0 || !ext4fs_tar_octal(h + 136,12,mtime.tv_sec) || mtime.tv_nsec) && r == 0){
+		if(mtime.tv_sec < 0)
+			ext4fs_tar_octal(h + 136,12,0);
+		r = ext4fs_tar_pax(t,"mtime",s,sprintf(s,"%lld.%09ld",(long long)mtime.tv_sec,mtime.tv_nsec));
+	}
+	if(r != 0)
+		return r;
+	h[156] = type;
+	memcpy(h + 257,"ustar",6);
+	memcpy(h + 263,"00",2);
+	if(type == '3' || type == '4'){
+		/* new_encode_dev() layout,the old 16 bit one is a subset of it */
+		dev = ext4_inode_get_dev(inode);
+		ext4fs_tar_octal(h + 329,8,(dev & 0xfff00) >> 8);
+		ext4fs_tar_octal(h + 337,8,(dev & 0xff) | ((dev >> 12) & 0xfff00));
+	}
+	r = ext4fs_tar_xattrs(t,src);
+	if(r != EOK){
+		/* the entry goes out without them */
+		sprd_log("ext4fs_tar_header:xattrs of %s error:%d\n",src,r);
+		t->err = r;
+	}
+
+	if(t->pax_len){
+		memcpy(x,h,sizeof(x));
+		memset(x,0,100);
+		memset(x + 157,0,100);
+		memset(x + 345,0,155);
+		base = strrchr(name,'/');
+		base = (base != NULL && base[1] != '\0') ? base + 1 : name;
+		snprintf(x,100,"PaxHeaders/%.80s",base);
+		ext4fs_tar_octal(x + 100,8,0644);
+		ext4fs_tar_octal(x + 124,12,t->pax_len);
+		x[156] = 'x';
+		ext4fs_tar_chksum(x);
+		if((r = ext4fs_tar_out(t,x,sizeof(x))) != 0 ||
+		   (r = ext4fs_tar_out(t,t->pax,t->pax_len)) != 0 ||
+		   (r = ext4fs_tar_pad(t,EXT4FS_TAR_BLOCK)) != 0)
+			return r;
+	}
+	ext4fs_tar_chksum(h);
+	return ext4fs_tar_out(t,h,sizeof(h));
+}
+
+/* file data,a short read is zero filled so the archive stays consistent */
+static int ext4fs_tar_data(struct ext4fs_tar *t, const char *src, uint64_t size)
+{
+	ext4_file f;
+	uint64_t cnt = 0, n;
+	int r;
+
+	r = ext4_fopen(&f,src,"rb");
+	if(r == EOK){
+		r = ext4_fstream(&f,size,t->data,EXT4FS_STREAM_SIZE,ext4fs_tar_out,t,&cnt);
+		ext4_fclose(&f);
+	}
+	if(t->out_err)
+		return t->out_err;
+	if(r != EOK){
+		sprd_log("ext4fs_tar_data:%s error:%d\n",src,r);
+		t->err = r;
+	}
+	t->data_bytes += cnt;
+	if(cnt < size){
+		memset(t->data,0,EXT4FS_STREAM_SIZE);
+		while(cnt < size){
+			n = size - cnt > EXT4FS_STREAM_SIZE ? EXT4FS_STREAM_SIZE : size - cnt;
+			if(ext4fs_tar_out(t,t->data,n) != 0)
+				return t->out_err;
+			cnt += n;
+		}
+	}
+	return ext4fs_tar_pad(t,EXT4FS_TAR_BLOCK);
+}
+
+/* archive src as name,directories recursively */
+static int ext4fs_tar_entry(struct ext4fs_tar *t, const char *src, const char *name)
+{
+	struct ext4_inode inode;
+	char target[PATH_MAX];
+	const ext4_direntry *de;
+	ext4_dir d;
+	uint32_t ino, i;
+	uint64_t size;
+	size_t rcnt;
+	char *csrc, *cname;
+	int r;
+
+	r = ext4_fill_raw_inode(src,&ino,&inode);
+	if(r != EOK){
+		/* keep going,report at the end */
+		sprd_log("ext4fs_tar_entry:ext4_fill_raw_inode %s error:%d\n",src,r);
+		t->err = r;
+		return 0;
+	}
+
+	switch(ext4_inode_type(t->sb,&inode)){
+	case EXT4_INODE_MODE_DIRECTORY:
+		if(name[0] != '\0'){
+			cname = ext4fs_path_join(name,"",0); //trailing '/'
+			if(cname == NULL)
+				return ENOMEM;
+			r = ext4fs_tar_header(t,src,cname,'5',NULL,&inode,0);
+			free(cname);
+			if(r != 0)
+				return r;
+		}
+		t->dirs++;
+
+		r = ext4_dir_open(&d,src);
+		if(r != EOK){
+			sprd_log("ext4fs_tar_entry:ext4_dir_open %s error:%d\n",src,r);
+			t->err = r;
+			return 0;
+		}
+		while((de = ext4_dir_entry_next(&d)) != NULL){
+			if((de->name_length == 1 && de->name[0] == '.') ||
+			   (de->name_length == 2 && de->name[0] == '.' && de->name[1] == '.'))
+				continue;
+			csrc = ext4fs_path_join(src,(char *)de->name,de->name_length);
+			cname = name[0] ? ext4fs_path_join(name,(char *)de->name,de->name_length)
+					: strndup((char *)de->name,de->name_length);
+			r = (csrc && cname) ? ext4fs_tar_entry(t,csrc,cname) : ENOMEM;
+			free(csrc);
+			free(cname);
+			if(r != 0)
+				break;
+		}
+		ext4_dir_close(&d);
+		return r;
+
+	case EXT4_INODE_MODE_FILE:
+		if(ext4_inode_get_links_cnt(&inode) > 1){
+			for(i = 0;i < t->hl_cnt;i++){
+				if(t->hl[i].ino == ino){
+					t->hardlinks++;
+					return ext4fs_tar_header(t,src,name,'1',t->hl[i].name,&inode,0);
+				}
+			}
+			if(t->hl_cnt == t->hl_cap){
+				uint32_t n = t->hl_cap ? t->hl_cap * 2 : 64;
+				struct ext4fs_tar_link *p = realloc(t->hl,n * sizeof(struct ext4fs_tar_link));
+				if(p == NULL)
+					return ENOMEM;
+				t->hl = p;
+				t->hl_cap = n;
+			}
+			t->hl[t->hl_cnt].ino = ino;
+			t->hl[t->hl_cnt].name = strdup(name);
+			if(t->hl[t->hl_cnt].name == NULL)
+				return ENOMEM;
+			t->hl_cnt++;
+		}
+		size = ext4_inode_get_size(t->sb,&inode);
+		r = ext4fs_tar_header(t,src,name,'0',NULL,&inode,size);
+		if(r != 0)
+			return r;
+		t->files++;
+		return ext4fs_tar_data(t,src,size);
+
+	case EXT4_INODE_MODE_SOFTLINK:
+		r = ext4_readlink(src,target,sizeof(target) - 1,&rcnt);
+		if(r != EOK){
+			sprd_log("ext4fs_tar_entry:ext4_readlink %s error:%d\n",src,r);
+			t->err = r;
+			return 0;
+		}
+		target[rcnt] = '\0';
+		t->links++;
+		return ext4fs_tar_header(t,src,name,'2',target,&inode,0);
+
+	case EXT4_INODE_MODE_CHARDEV:
+		t->nodes++;
+		return ext4fs_tar_header(t,src,name,'3',NULL,&inode,0);
+	case EXT4_INODE_MODE_BLOCKDEV:
+		t->nodes++;
+		return ext4fs_tar_header(t,src,name,'4',NULL,&inode,0);
+	case EXT4_INODE_MODE_FIFO:
+		t->nodes++;
+		return ext4fs_tar_header(t,src,name,'6',NULL,&inode,0);
+	default:
+		/* sockets have no tar representation */
+		t->skipped++;
+		return 0;
+	}
+}
+
+int sprd_tar_ext4fs(char *path, int fd)
+{
+	struct ext4fs_tar t;
+	struct timespec t0, t1;
+	char *path_redirect, *name;
+	size_t len;
+	double sec;
+	uint32_t i;
+	int r;
+
+	memset(&t,0,sizeof(t));
+	t.fd = fd;
+	t.buf = arena_alloc(EXT4FS_TAR_BUF);
+	t.data = arena_alloc(EXT4FS_STREAM_SIZE);
+	if(t.buf == NULL || t.data == NULL){
+		sprd_log("sprd_tar_ext4fs:malloc error\n");
+		arena_free(t.buf);
+		arena_free(t.data);
+		return -1;
+	}
+
+	path_redirect = sprd_mount_ext4fs(path,"sprd_tar_ext4fs");
+	if(path_redirect == NULL){
+		arena_free(t.buf);
+		arena_free(t.data);
+		return -1;
+	}
+	ext4_get_sblock("/",&t.sb);
+
+	/* member names are the path without the leading and trailing '/' */
+	while(*path == '/')
+		path++;
+	name = strdup(path);
+	if(name == NULL){
+		r = ENOMEM;
+		goto out;
+	}
+	for(len = strlen(name);len && name[len-1] == '/';len--)
+		name[len-1] = '\0';
+
+	sprd_log("tar /%s\n",name);
+	clock_gettime(CLOCK_MONOTONIC,&t0);
+
+	r = ext4fs_tar_entry(&t,path_redirect,name);
+	free(name);
+	/* end of archive:two zero blocks,then whole records */
+	if(r == 0){
+		memset(t.data,0,EXT4FS_TAR_BLOCK * 2);
+		r = ext4fs_tar_out(&t,t.data,EXT4FS_TAR_BLOCK * 2);
+	}
+	if(r == 0)
+		r = ext4fs_tar_pad(&t,EXT4FS_TAR_RECORD);
+	if(r == 0 && t.len)
+		r = ext4fs_tar_flush(&t,t.buf,t.len);
+	if(r != 0){
+		sprd_log("sprd_tar_ext4fs:error:%d\n",r);
+		goto out;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC,&t1);
+	sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	sprd_log("%u files,%u dirs,%u symlinks,%u hard links,%u nodes,%llu Bytes data,%llu Bytes archive in %.2fs(%.1f MB/s)\n",
+		t.files,t.dirs,t.links,t.hardlinks,t.nodes,(unsigned long long)t.data_bytes,
+		(unsigned long long)t.bytes,sec,sec > 0 ? t.bytes / sec / 1e6 : 0.0);
+	if(t.skipped)
+		sprd_log("warning:%u sockets not archived\n",t.skipped);
+	r = t.err;
+out:
+	for(i = 0;i < t.hl_cnt;i++)
+		free(t.hl[i].name);
+	free(t.hl);
+	free(t.pax);
+	free(t.xlist);
+	arena_free(t.buf);
+	arena_free(t.data);
+	if(sprd_umount_ext4fs("sprd_tar_ext4fs") != 0)
+		return EXIT_FAILURE;
+	return r;
+}
+
+/* parse size/offset argument,support 0x prefix and 'k/K' 'm/M' 'g/G',
+ * 0:ok,-1:not a size(nothing parsed,sign,unknown suffix,overflow) */
+int sprd_parse_size(const char *str, uint64_t *size)
+{
+	char *end;
+	uint64_t v;
+	int shift = 0;
+
+	if(*str < '0' || *str > '9')
+		return -1;
+	errno = 0;
+	v = strtoull(str,&end,0);
+	if(errno != 0)
+		return -1;
+	switch(*end){
+		case 'g':
+		case 'G':shift += 10;
+			/* fall through */
+		case 'm':
+		case 'M':shift += 10;
+			/* fall through */
+		case 'k':
+		case 'K':shift += 10;
+			end++;
+			break;
+		default:break;
+	}
+	if(*end != '\0' || (shift && v > UINT64_MAX >> shift))
+		return -1;
+	*size = v << shift;
+	return 0;
+}
+
+
+/* ext4fs find/du: metadata only,no file data is read. The tree is walked
+ * breadth first one level at a time:the directories of a level are read
+ * in inode number (block group) order,then the inodes of all their entries
+ * come in batches through ext4_inodes_prefetch,so inode table reads stay
+ * sequential and large */
+#define EXT4FS_WALK_BATCH 16384
+
+struct ext4fs_walk_dir {
+	char *src;		//path in the mount point
+	char *shown;		//path as printed
+	uint32_t ino;
+	uint32_t parent;	//index in dirs
+	uint64_t bytes;		//allocated bytes,du adds the subtree
+};
+
+struct ext4fs_walk_ent {
+	uint32_t dir;
+	uint32_t ino;
+	char *name;
+};
+
+struct ext4fs_walk {
+	struct ext4_sblock *sb;
+	struct ext4fs_walk_dir *dirs;
+	uint32_t dirs_cnt;
+	uint32_t dirs_cap;
+	/* called for every entry (and the start directory,dir == -1) */
+	int (*visit)(struct ext4fs_walk *w, uint32_t dir, const char *name,
+		     const char *shown, uint32_t ino, struct ext4_inode *inode);
+	void *arg;
+	int err;
+};
+
+static int ext4fs_walk_push(struct ext4fs_walk *w, uint32_t parent, const char *src,
+			    const char *shown, uint32_t ino, struct ext4_inode *inode)
+{
+	struct ext4fs_walk_dir *p;
+
+	if(w->dirs_cnt == w->dirs_cap){
+		uint32_t n = w->dirs_cap ? w->dirs_cap * 2 : 256;
+		p = realloc(w->dirs,n * sizeof(struct ext4fs_walk_dir));
+		if(p == NULL)
+			return ENOMEM;
+		w->dirs = p;
+		w->dirs_cap = n;
+	}
+	p = &w->dirs[w->dirs_cnt];
+	p->src = strdup(src);
+	p->shown = strdup(shown);
+	p->ino = ino;
+	p->parent = parent;
+	p->bytes = ext4_inode_get_blocks_count(w->sb,inode) * 512;
+	if(p->src == NULL || p->shown == NULL){
+		free(p->src);
+		free(p->shown);
+		return ENOMEM;
+	}
+	w->dirs_cnt++;
+	return 0;
+}
+
+static int ext4fs_walk_ino_cmp(const void *a, const void *b)
+{
+	const struct ext4fs_walk_ent *ea = a, *eb = b;
+	return ea->ino < eb->ino ? -1 : ea->ino > eb->ino;
+}
+
+/* inodes of ents[0,cnt),visit them,queue the subdirectories */
+static int ext4fs_walk_batch(struct ext4fs_walk *w, struct ext4fs_walk_ent *ents, uint32_t cnt,
+			     uint32_t *inos, struct ext4_inode *inodes)
+{
+	struct ext4fs_walk_dir *d;
+	char *src, *shown;
+	uint32_t i;
+	int r;
+
+	for(i = 0;i < cnt;i++)
+		inos[i] = ents[i].ino;
+	r = ext4_inodes_prefetch("/",inos,cnt,inodes);
+	if(r != EOK){
+		sprd_log("ext4fs_walk_batch:ext4_inodes_prefetch error:%d\n",r);
+		return r;
+	}
+
+	for(i = 0;i < cnt;i++){
+		d = &w->dirs[ents[i].dir];
+		shown = ext4fs_path_join(d->shown,ents[i].name,strlen(ents[i].name));
+		if(shown == NULL)
+			return ENOMEM;
+		r = w->visit(w,ents[i].dir,ents[i].name,shown,ents[i].ino,&inodes[i]);
+		if(r == 0 && ext4_inode_type(w->sb,&inodes[i]) == EXT4_INODE_MODE_DIRECTORY){
+			src = ext4fs_path_join(w->dirs[ents[i].dir].src,ents[i].name,strlen(ents[i].name));
+			r = src ? ext4fs_walk_push(w,ents[i].dir,src,shown,ents[i].ino,&inodes[i]) : ENOMEM;
+			free(src);
+		}
+		free(shown);
+		if(r != 0)
+			return r;
+	}
+	return 0;
+}
+
+static int ext4fs_walk(struct ext4fs_walk *w, const char *src, const char *shown)
+{
+	struct ext4fs_walk_ent *ents = NULL, *order = NULL, *p;
+	struct ext4_inode *inodes = NULL, inode;
+	uint32_t *inos = NULL;
+	uint32_t start, end, i, cnt, cap = 0, ino, done;
+	const char *base;
+	const ext4_direntry *de;
+	ext4_dir d;
+	int r;
+
+	r = ext4_fill_raw_inode(src,&ino,&inode);
+	if(r != EOK){
+		sprd_log("ext4fs_walk:ext4_fill_raw_inode %s error:%d\n",shown,r);
+		return r;
+	}
+	base = strrchr(shown,'/');
+	base = (base != NULL && base[1] != '\0') ? base + 1 : shown;
+	r = w->visit(w,(uint32_t)-1,base,shown,ino,&inode);
+	if(r != 0 || ext4_inode_type(w->sb,&inode) != EXT4_INODE_MODE_DIRECTORY)
+		return r;
+	r = ext4fs_walk_push(w,(uint32_t)-1,src,shown,ino,&inode);
+	if(r != 0)
+		return r;
+
+	inos = malloc(EXT4FS_WALK_BATCH * sizeof(uint32_t));
+	inodes = malloc(EXT4FS_WALK_BATCH * sizeof(struct ext4_inode));
+	if(inos == NULL || inodes == NULL){
+		r = ENOMEM;
+		goto out;
+	}
+
+	for(start = 0;start < w->dirs_cnt && r == 0;start = end){
+		end = w->dirs_cnt;
+
+		/* the level's directories in inode order */
+		free(order);
+		order = malloc((end - start) * sizeof(struct ext4fs_walk_ent));
+		if(order == NULL){
+			r = ENOMEM;
+			break;
+		}
+		for(i = start;i < end;i++){
+			order[i - start].dir = i;
+			order[i - start].ino = w->dirs[i].ino;
+		}
+		qsort(order,end - start,sizeof(struct ext4fs_walk_ent),ext4fs_walk_ino_cmp);
+
+		cnt = 0;
+		for(i = 0;i < end - start && r == 0;i++){
+			r = ext4_dir_open(&d,w->dirs[order[i].dir].src);
+			if(r != EOK){
+				/* reported,the rest of the tree is still walked */
+				sprd_log("ext4fs_walk:ext4_dir_open %s error:%d\n",w->dirs[order[i].dir].shown,r);
+				w->err = r;
+				r = 0;
+				continue;
+			}
+			while((de = ext4_dir_entry_next(&d)) != NULL){
+				if((de->name_length == 1 && de->name[0] == '.') ||
+				   (de->name_length == 2 && de->name[0] == '.' && de->name[1] == '.'))
+					continue;
+				if(cnt == cap){
+					cap = cap ? cap * 2 : 1024;
+					p = realloc(ents,cap * sizeof(struct ext4fs_walk_ent));
+					if(p == NULL){
+						r = ENOMEM;
+						break;
+					}
+					ents = p;
+				}
+				ents[cnt].dir = order[i].dir;
+				ents[cnt].ino = de->inode;
+				ents[cnt].name = strndup((char *)de->name,de->name_length);
+				if(ents[cnt].name == NULL){
+					r = ENOMEM;
+					break;
+				}
+				cnt++;
+			}
+			ext4_dir_close(&d);
+		}
+
+		/* inode table order inside a batch,visit order is not kept */
+		qsort(ents,cnt,sizeof(struct ext4fs_walk_ent),ext4fs_walk_ino_cmp);
+		for(done = 0;done < cnt && r == 0;done += i){
+			i = cnt - done > EXT4FS_WALK_BATCH ? EXT4FS_WALK_BATCH : cnt - done;
+			r = ext4fs_walk_batch(w,ents + done,i,inos,inodes);
+		}
+		for(i = 0;i < cnt;i++)
+			free(ents[i].name);
+	}
+out:
+	free(order);
+	free(ents);
+	free(inos);
+	free(inodes);
+	return r;
+}
+
+static void ext4fs_walk_free(struct ext4fs_walk *w)
+{
+	uint32_t i;
+
+	for(i = 0;i < w->dirs_cnt;i++){
+		free(w->dirs[i].src);
+		free(w->dirs[i].shown);
+	}
+	free(w->dirs);
+}
+
+/* find predicates,all must match */
+static char *ext4fs_find_name = NULL;
+static char *ext4fs_find_size = NULL;
+static char *ext4fs_find_mtime = NULL;
+static char *ext4fs_find_type = NULL;
+
+struct ext4fs_find {
+	int size_cmp;		//-1 less,0 equal,1 greater
+	uint64_t size;
+	int mtime_cmp;
+	int64_t mtime_days;
+	time_t now;
+	uint32_t type;		//EXT4_INODE_MODE_*,0 any
+	uint32_t found;
+};
+
+/* "+N" "-N" "N" */
+static int ext4fs_find_cmp(const char **s)
+{
+	if(**s == '+'){ (*s)++; return 1; }
+	if(**s == '-'){ (*s)++; return -1; }
+	return 0;
+}
+
+static int ext4fs_find_visit(struct ext4fs_walk *w, uint32_t dir, const char *name,
+			     const char *shown, uint32_t ino, struct ext4_inode *inode)
+{
+	struct ext4fs_find *f = w->arg;
+	struct timespec mtime;
+	uint64_t size;
+	int64_t days;
+
+	if(f->type && ext4_inode_type(w->sb,inode) != f->type)
+		return 0;
+	if(ext4fs_find_name != NULL && fnmatch(ext4fs_find_name,name,0) != 0)
+		return 0;
+	if(ext4fs_find_size != NULL){
+		size = ext4_inode_get_size(w->sb,inode);
+		if((f->size_cmp > 0 && size <= f->size) || (f->size_cmp < 0 && size >= f->size) ||
+		   (f->size_cmp == 0 && size != f->size))
+			return 0;
+	}
+	if(ext4fs_find_mtime != NULL){
+		ext4fs_inode_mtime(w->sb,inode,&mtime);
+		days = ((int64_t)f->now - mtime.tv_sec) / 86400;
+		if((f->mtime_cmp > 0 && days <= f->mtime_days) || (f->mtime_cmp < 0 && days >= f->mtime_days) ||
+		   (f->mtime_cmp == 0 && days != f->mtime_days))
+			return 0;
+	}
+	sprd_out("%s\n",shown);
+	f->found++;
+	return 0;
+}
+
+int sprd_find_ext4fs(char *path)
+{
+	static const struct { char c; uint32_t mode; } types[] = {
+		{'f',EXT4_INODE_MODE_FILE},{'d',EXT4_INODE_MODE_DIRECTORY},
+		{'l',EXT4_INODE_MODE_SOFTLINK},{'c',EXT4_INODE_MODE_CHARDEV},
+		{'b',EXT4_INODE_MODE_BLOCKDEV},{'p',EXT4_INODE_MODE_FIFO},
+		{'s',EXT4_INODE_MODE_SOCKET},
+	};
+	struct ext4fs_walk w;
+	struct ext4fs_find f;
+	char *path_redirect;
+	const char *s;
+	uint32_t i;
+	int r;
+
+	memset(&f,0,sizeof(f));
+	f.now = time(NULL);
+	if(ext4fs_find_size != NULL){
+		s = ext4fs_find_size;
+		f.size_cmp = ext4fs_find_cmp(&s);
+		if(sprd_parse_size(s,&f.size) != 0){
+			sprd_log("sprd_find_ext4fs:bad size %s\n",ext4fs_find_size);
+			return -1;
+		}
+	}
+	if(ext4fs_find_mtime != NULL){
+		s = ext4fs_find_mtime;
+		f.mtime_cmp = ext4fs_find_cmp(&s);
+		f.mtime_days = strtoll(s,NULL,0);
+	}
+	if(ext4fs_find_type != NULL){
+		for(i = 0;i < sizeof(types) / sizeof(types[0]);i++)
+			if(ext4fs_find_type[0] == types[i].c && ext4fs_find_type[1] == '\0')
+				f.type = types[i].mode;
+		if(f.type == 0){
+			sprd_log("sprd_find_ext4fs:unknown type %s\n",ext4fs_find_type);
+			return -1;
+		}
+	}
+
+	path_redirect = sprd_mount_ext4fs(path,"sprd_find_ext4fs");
+	if(path_redirect == NULL)
+		return -1;
+
+	memset(&w,0,sizeof(w));
+	ext4_get_sblock("/",&w.sb);
+	w.visit = ext4fs_find_visit;
+	w.arg = &f;
+	r = ext4fs_walk(&w,path_redirect,path);
+	if(r == 0)
+		r = w.err;
+	ext4fs_walk_free(&w);
+
+	if(sprd_umount_ext4fs("sprd_find_ext4fs") != 0)
+		return EXIT_FAILURE;
+	return r;
+}
+
+/* du:allocated size like du,hard linked files counted once */
+static int ext4fs_du_summary = 0;
+
+struct ext4fs_du {
+	uint32_t *seen;		//open addressing set of hard linked inodes
+	uint32_t seen_cnt;
+	uint32_t seen_cap;	//power of two
+};
+
+/* true if ino was not in the set */
+static int ext4fs_du_first(struct ext4fs_du *u, uint32_t ino)
+{
+	uint32_t i, *old, old_cap;
+
+	if(u->seen_cnt * 2 >= u->seen_cap){
+		old = u->seen;
+		old_cap = u->seen_cap;
+		u->seen_cap = old_cap ? old_cap * 2 : 1024;
+		u->seen = calloc(u->seen_cap,sizeof(uint32_t));
+		if(u->seen == NULL){
+			u->seen = old;
+			u->seen_cap = old_cap;
+			return -1;
+		}
+		u->seen_cnt = 0;
+		for(i = 0;i < old_cap;i++)
+			if(old[i])
+				ext4fs_du_first(u,old[i]);
+		free(old);
+	}
+	for(i = (ino * 2654435761u) & (u->seen_cap - 1);u->seen[i];i = (i + 1) & (u->seen_cap - 1))
+		if(u->seen[i] == ino)
+			return 0;
+	u->seen[i] = ino;
+	u->seen_cnt++;
+	return 1;
+}
+
+static int ext4fs_du_visit(struct ext4fs_walk *w, uint32_t dir, const char *name,
+			   const char *shown, uint32_t ino, struct ext4_inode *inode)
+{
+	struct ext4fs_du *u = w->arg;
+	uint64_t bytes = ext4_inode_get_blocks_count(w->sb,inode) * 512;
+	int first;
+
+	/* own blocks of a directory are in its dirs entry */
+	if(ext4_inode_type(w->sb,inode) == EXT4_INODE_MODE_DIRECTORY)
+		return 0;
+	if(ext4_inode_get_links_cnt(inode) > 1){
+		first = ext4fs_du_first(u,ino);
+		if(first < 0)
+			return ENOMEM;
+		if(first == 0)
+			return 0;
+	}
+	if(dir == (uint32_t)-1)
+		sprd_out("%llu\t%s\n",(unsigned long long)(bytes + 1023) / 1024,shown);
+	else
+		w->dirs[dir].bytes += bytes;
+	return 0;
+}
+
+int sprd_du_ext4fs(char *path)
+{
+	struct ext4fs_walk w;
+	struct ext4fs_du u;
+	char *path_redirect;
+	uint32_t i;
+	int r;
+
+	path_redirect = sprd_mount_ext4fs(path,"sprd_du_ext4fs");
+	if(path_redirect == NULL)
+		return -1;
+
+	memset(&w,0,sizeof(w));
+	memset(&u,0,sizeof(u));
+	ext4_get_sblock("/",&w.sb);
+	w.visit = ext4fs_du_visit;
+	w.arg = &u;
+	r = ext4fs_walk(&w,path_redirect,path);
+
+	/* breadth first order:children come after their parent */
+	for(i = w.dirs_cnt;r == 0 && i--;){
+		if(!ext4fs_du_summary || i == 0)
+			sprd_out("%llu\t%s\n",(unsigned long long)(w.dirs[i].bytes + 1023) / 1024,w.dirs[i].shown);
+		if(i)
+			w.dirs[w.dirs[i].parent].bytes += w.dirs[i].bytes;
+	}
+	if(r == 0)
+		r = w.err;
+	ext4fs_walk_free(&w);
+	free(u.seen);
+
+	if(sprd_umount_ext4fs("sprd_du_ext4fs") != 0)
+		return EXIT_FAILURE;
+	return r;
+}
+
+
+/* one ext4fs command(syberusb_ext4fs) */
+int sprd_ext4fs_task(const struct syberusb_ext4fs *o)
+{
+	char *cmd = (char *)o->cmd;
+	char *path = (char *)o->path;
+	int tar_fd = o->tar_fd;
+	int jobs = o->jobs;
+	int r;
+
+	if(cmd == NULL || path == NULL || jobs < 0 || jobs > EXT4FS_JOBS_MAX){
+		sprd_log("param not correct\n");
+		return -1;
+	}
+	ext4fs_image = (char *)o->image;
+	ext4fs_ls_long = o->ls_long;
+	ext4fs_ls_recursive = o->ls_recursive;
+	ext4fs_du_summary = o->du_summary;
+	ext4fs_find_name = (char *)o->find_name;
+	ext4fs_find_size = (char *)o->find_size;
+	ext4fs_find_mtime = (char *)o->find_mtime;
+	ext4fs_find_type = (char *)o->find_type;
+	/* per call:a previous --warmup none must not stick */
+	test_lwext4_mount_warmup(o->warmup == SYBERUSB_WARMUP_DEFAULT ? EXT4_WARMUP_GDT : o->warmup);
+	if(jobs == 0){
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+		if(jobs < 1) jobs = 1;
+		if(jobs > 8) jobs = 8;
+	}
+	/* a trace is a sequence:parallel readers would record(and replay)
+	 * the device reads in a different order every time */
+	if(trace_recording() || trace_replaying())
+		jobs = 1;
+
+	if(strcmp(cmd,"ls")==0){
+		r = sprd_ls_ext4fs(path);
+		if(r != 0)
+			sprd_log("sprd_ls_ext4fs error:%d\n",r);
+	}
+	else if(strcmp(cmd,"get")==0){
+		r = sprd_read_ext4fs(path,o->offset,o->length);
+		if(r != 0)
+			sprd_log("sprd_read_ext4fs error:%d\n",r);
+	}
+	else if(strcmp(cmd,"cat")==0){
+		r = sprd_cat_ext4fs(path,o->offset,o->length);
+		if(r != 0)
+			sprd_log("sprd_cat_ext4fs error:%d\n",r);
+	}
+	else if(strcmp(cmd,"extract")==0){
+		r = sprd_extract_ext4fs(path,(char *)o->dest,jobs);
+		if(r != 0)
+			sprd_log("sprd_extract_ext4fs error:%d\n",r);
+	}
+	else if(strcmp(cmd,"find")==0){
+		r = sprd_find_ext4fs(path);
+		if(r != 0)
+			sprd_log("sprd_find_ext4fs error:%d\n",r);
+	}
+	else if(strcmp(cmd,"du")==0){
+		r = sprd_du_ext4fs(path);
+		if(r != 0)
+			sprd_log("sprd_du_ext4fs error:%d\n",r);
+	}
+	else if(strcmp(cmd,"tar")==0){
+		if(o->dest != NULL){
+			tar_fd = open(o->dest,O_CREAT|O_WRONLY|O_TRUNC,0666);
+			if(tar_fd == -1){
+				sprd_log("sprd_tar_ext4fs:open or create %s error:%d\n",o->dest,errno);
+				return -1;
+			}
+		}
+		r = sprd_tar_ext4fs(path,tar_fd);
+		if(o->dest != NULL)
+			close(tar_fd);
+		if(r != 0)
+			sprd_log("sprd_tar_ext4fs error:%d\n",r);
+	}
+	else{
+		sprd_log("param not correct\n");
+		r = -1;
+	}
+	return r;
+}
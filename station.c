@@ -0,0 +1,463 @@
+/* multi-phone station scheduler,see station.h */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#include <libusb.h>
+
+#include "main.h"
+#include "station.h"
+
+/* child to parent:the bytes moved at most every STATION_REPORT_MS,
+ * then the job result(done set) */
+struct station_msg {
+	uint64_t bytes;
+	int32_t result;
+	int32_t done;
+};
+
+#define STATION_REPORT_MS 100
+
+enum { JOB_QUEUED, JOB_RUNNING, JOB_DONE };
+
+struct station_job {
+	char loc[STATION_LOCATION_LEN];
+	int bus;		/* index in the bus table */
+	int state;
+	pid_t pid;
+	int fd;			/* pipe from the child */
+	uint64_t bytes;
+	uint64_t t0,t1;
+	int result;
+	int reported;		/* result received */
+};
+
+struct station_bus {
+	int number;
+	int jobs;
+	int running;
+	uint64_t bytes;		/* of its jobs,at the last measure */
+	uint64_t last_start;
+	double rate;		/* bytes/s over the last interval */
+	double peak;
+};
+
+static uint64_t station_now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+int station_location(libusb_device *dev, char *buf, size_t len)
+{
+	uint8_t ports[8];
+	int i,n,r;
+
+	n = libusb_get_port_numbers(dev,ports,sizeof(ports));
+	/* 0:a root hub,not a phone */
+	if(n <= 0)
+		return -1;
+	r = snprintf(buf,len,"%d-",libusb_get_bus_number(dev));
+	for(i = 0;i < n && r < (int)len;i++)
+		r += snprintf(buf + r,len - r,i ? ".%d" : "%d",ports[i]);
+	return r < (int)len ? 0 : -1;
+}
+
+static int station_loc_cmp(const void *a, const void *b)
+{
+	return strverscmp(a,b);
+}
+
+int station_list(char (*loc)[STATION_LOCATION_LEN], int max)
+{
+	libusb_context *ctx;
+	libusb_device **list;
+	ssize_t cnt;
+	int i,n = 0,r;
+
+	r = libusb_init(&ctx);
+	if(r < 0)
+		return r;
+	cnt = libusb_get_device_list(ctx,&list);
+	if(cnt < 0){
+		libusb_exit(ctx);
+		return (int)cnt;
+	}
+	for(i = 0;i < cnt && n < max;i++)
+		if(is_sprd_dev(list[i]) == 0 && station_location(list[i],loc[n],STATION_LOCATION_LEN) == 0)
+			n++;
+	libusb_free_device_list(list,1);
+	libusb_exit(ctx);
+	qsort(loc,n,STATION_LOCATION_LEN,station_loc_cmp);
+	return n;
+}
+
+/* child side:the session of one phone */
+static int child_fd = -1;
+static const char *child_loc;
+static syberusb_log_fn child_log;
+static void *child_arg;
+static char child_line[1024];
+static const char *child_what;
+static uint64_t child_base,child_done,child_sent;
+static pthread_mutex_t child_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void station_send(uint64_t bytes, int result, int done)
+{
+	struct station_msg m;
+
+	m.bytes = bytes;
+	m.result = result;
+	m.done = done;
+	/* smaller than PIPE_BUF:never mixed with another message */
+	if(write(child_fd,&m,sizeof(m)) != sizeof(m))
+		return;
+}
+
+/* whole lines,prefixed with the phone:the children share the terminal */
+static void station_child_line(int flush)
+{
+	char out[sizeof(child_line) + STATION_LOCATION_LEN + 4];
+	char *nl,*p = child_line;
+
+	while((nl = strchr(p,'\n')) != NULL || (flush && *p != '\0')){
+		if(nl == NULL)
+			nl = p + strlen(p) - 1;
+		snprintf(out,sizeof(out),"[%s] %.*s\n",child_loc,(int)(nl - p + (*nl != '\n')),p);
+		child_log(child_arg,out);
+		p = nl + 1;
+	}
+	memmove(child_line,p,strlen(p) + 1);
+}
+
+static void station_child_log(void *arg, const char *msg)
+{
+	size_t len;
+
+	pthread_mutex_lock(&child_lock);
+	len = strlen(child_line);
+	if(len + strlen(msg) >= sizeof(child_line))
+		station_child_line(1);
+	len = strlen(child_line);
+	snprintf(child_line + len,sizeof(child_line) - len,"%s",msg);
+	station_child_line(0);
+	pthread_mutex_unlock(&child_lock);
+}
+
+/* a new transfer starts from 0:the bytes of the previous one are kept */
+static int station_child_progress(void *arg, const char *what, uint64_t done, uint64_t total)
+{
+	uint64_t now = station_now();
+
+	pthread_mutex_lock(&child_lock);
+	if(what != child_what || done < child_done)
+		child_base += child_done;
+	child_what = what;
+	child_done = done;
+	if(now - child_sent >= STATION_REPORT_MS * 1000000ULL || done == total){
+		child_sent = now;
+		station_send(child_base + child_done,0,0);
+	}
+	pthread_mutex_unlock(&child_lock);
+	return 0;
+}
+
+static void station_child(const struct syberusb_config *cfg, const char *loc, int fd,
+		syberusb_job_fn job, void *arg)
+{
+	struct syberusb_config c = *cfg;
+	struct syberusb *s;
+	int r;
+
+	child_fd = fd;
+	child_loc = loc;
+	child_log = cfg->log;
+	child_arg = cfg->arg;
+	c.device = loc;
+	c.log = cfg->log != NULL ? station_child_log : NULL;
+	c.progress = station_child_progress;
+	r = syberusb_open(&s,&c);
+	if(r == 0){
+		r = job(s,loc,arg);
+		syberusb_close(s);
+	}
+	if(child_log != NULL)
+		station_child_line(1);
+	station_send(child_base + child_done,r,1);
+	fflush(NULL);
+	_exit(r == 0 ? 0 : 1);
+}
+
+/* the queued job to start:on the bus with the fewest running jobs,then
+ * the lowest rate,among the buses with headroom */
+static int station_pick(struct station_job *jobs, int njobs, struct station_bus *buses,
+		int per_bus, double limit, uint64_t now, uint64_t interval)
+{
+	struct station_bus *b,*best_bus = NULL;
+	int i,best = -1;
+
+	for(i = 0;i < njobs;i++){
+		if(jobs[i].state != JOB_QUEUED)
+			continue;
+		b = &buses[jobs[i].bus];
+		if(b->running >= per_bus)
+			continue;
+		/* an idle bus always has room,a busy one is measured first */
+		if(limit > 0 && b->running > 0 &&
+		   (now < b->last_start + interval || b->rate >= limit))
+			continue;
+		if(best_bus == NULL || b->running < best_bus->running ||
+		   (b->running == best_bus->running && b->rate < best_bus->rate)){
+			best = i;
+			best_bus = b;
+		}
+	}
+	return best;
+}
+
+static void station_start(struct station_job *j, struct station_bus *b, const struct syberusb_config *cfg,
+		syberusb_job_fn job, void *arg, FILE *out)
+{
+	int p[2];
+
+	j->t0 = station_now();
+	j->state = JOB_RUNNING;
+	b->running++;
+	b->last_start = j->t0;
+	if(pipe(p) != 0){
+		j->pid = -1;
+		j->result = errno;
+		goto fail;
+	}
+	/* nothing buffered twice */
+	fflush(NULL);
+	j->pid = fork();
+	if(j->pid == -1){
+		j->result = errno;
+		close(p[0]);
+		close(p[1]);
+		goto fail;
+	}
+	if(j->pid == 0){
+		close(p[0]);
+		station_child(cfg,j->loc,p[1],job,arg);
+	}
+	close(p[1]);
+	j->fd = p[0];
+	return;
+fail:
+	fprintf(out,"station:%s:fork error:%d\n",j->loc,j->result);
+	j->reported = 1;
+	j->state = JOB_DONE;
+	j->t1 = j->t0;
+	b->running--;
+}
+
+static void station_reap(struct station_job *j, struct station_bus *b)
+{
+	int status;
+
+	close(j->fd);
+	j->fd = -1;
+	while(waitpid(j->pid,&status,0) == -1 && errno == EINTR);
+	/* no result:the child died */
+	if(!j->reported)
+		j->result = -1;
+	j->t1 = station_now();
+	j->state = JOB_DONE;
+	b->running--;
+}
+
+static void station_read(struct station_job *j, struct station_bus *b)
+{
+	struct station_msg m[16];
+	ssize_t r;
+	int i;
+
+	r = read(j->fd,m,sizeof(m));
+	if(r == -1 && errno == EINTR)
+		return;
+	if(r <= 0){
+		station_reap(j,b);
+		return;
+	}
+	for(i = 0;i < r / (ssize_t)sizeof(m[0]);i++){
+		j->bytes = m[i].bytes;
+		if(m[i].done){
+			j->result = m[i].result;
+			j->reported = 1;
+		}
+	}
+}
+
+static double station_mb(double bytes)
+{
+	return bytes / (1024 * 1024);
+}
+
+int station_run(const struct syberusb_config *cfg, const struct syberusb_station *st,
+		syberusb_job_fn job, void *arg)
+{
+	static char found[STATION_MAX][STATION_LOCATION_LEN];
+	static struct station_job jobs[STATION_MAX];
+	static struct station_bus buses[STATION_MAX];
+	struct pollfd pfd[STATION_MAX];
+	int pj[STATION_MAX];
+	FILE *out = cfg->out != NULL ? cfg->out : stderr;
+	uint64_t t0,now,next,interval,last,sum,total = 0;
+	double limit = st->bus_limit * 1024.0 * 1024.0;
+	double rate,peak = 0;
+	int per_bus,njobs = 0,nbus = 0,queued,running,failed = 0;
+	int i,k,n,r;
+
+	per_bus = st->per_bus == 0 ? 2 : st->per_bus < 0 ? INT_MAX : st->per_bus;
+	interval = (uint64_t)(st->interval > 0 ? st->interval : 1000) * 1000000;
+	if(st->devices != NULL){
+		for(n = 0;st->devices[n] != NULL && n < STATION_MAX;n++)
+			snprintf(found[n],STATION_LOCATION_LEN,"%s",st->devices[n]);
+	}
+	else {
+		n = station_list(found,STATION_MAX);
+		if(n < 0){
+			fprintf(out,"station:usb error:%d\n",n);
+			return n;
+		}
+	}
+	if(n == 0){
+		fprintf(out,"station:no phone found\n");
+		return -1;
+	}
+
+	memset(jobs,0,sizeof(jobs));
+	memset(buses,0,sizeof(buses));
+	for(i = 0;i < n;i++){
+		struct station_job *j = &jobs[njobs];
+		int number;
+
+		if(sscanf(found[i],"%d-",&number) != 1){
+			fprintf(out,"station:%s is not a usb location(bus-port.port)\n",found[i]);
+			return -1;
+		}
+		memcpy(j->loc,found[i],STATION_LOCATION_LEN);
+		j->fd = -1;
+		for(k = 0;k < nbus && buses[k].number != number;k++);
+		if(k == nbus)
+			buses[nbus++].number = number;
+		buses[k].jobs++;
+		j->bus = k;
+		njobs++;
+	}
+	fprintf(out,"station:%d phones on %d buses,",njobs,nbus);
+	if(per_bus == INT_MAX)
+		fprintf(out,"no cap per bus\n");
+	else if(st->bus_limit)
+		fprintf(out,"up to %d jobs per bus below %u MB/s\n",per_bus,st->bus_limit);
+	else
+		fprintf(out,"up to %d jobs per bus\n",per_bus);
+
+	t0 = last = station_now();
+	next = t0 + interval;
+	for(;;){
+		now = station_now();
+		while((i = station_pick(jobs,njobs,buses,per_bus,limit,now,interval)) >= 0)
+			station_start(&jobs[i],&buses[jobs[i].bus],cfg,job,arg,out);
+
+		queued = running = 0;
+		for(i = 0;i < njobs;i++){
+			if(jobs[i].state == JOB_QUEUED)
+				queued++;
+			else if(jobs[i].state == JOB_RUNNING){
+				pfd[running].fd = jobs[i].fd;
+				pfd[running].events = POLLIN;
+				pj[running++] = i;
+			}
+		}
+		if(running == 0 && queued == 0)
+			break;
+
+		now = station_now();
+		r = poll(pfd,running,next > now ? (int)((next - now + 999999) / 1000000) : 0);
+		if(r == -1 && errno != EINTR){
+			fprintf(out,"station:poll error:%d\n",errno);
+			break;
+		}
+		for(k = 0;r > 0 && k < running;k++)
+			if(pfd[k].revents)
+				station_read(&jobs[pj[k]],&buses[jobs[pj[k]].bus]);
+
+		now = station_now();
+		if(now < next)
+			continue;
+		/* measure every bus over the last interval */
+		total = 0;
+		rate = 0;
+		fprintf(out,"station %.1fs:",(now - t0) / 1e9);
+		for(k = 0;k < nbus;k++){
+			struct station_bus *b = &buses[k];
+
+			sum = 0;
+			for(i = 0;i < njobs;i++)
+				if(jobs[i].bus == k)
+					sum += jobs[i].bytes;
+			b->rate = (sum - b->bytes) * 1e9 / (now - last);
+			b->bytes = sum;
+			if(b->rate > b->peak)
+				b->peak = b->rate;
+			rate += b->rate;
+			total += sum;
+			fprintf(out,"bus %d %d running %.1f MB/s,",b->number,b->running,station_mb(b->rate));
+		}
+		if(rate > peak)
+			peak = rate;
+		queued = 0;
+		n = 0;
+		for(i = 0;i < njobs;i++){
+			queued += jobs[i].state == JOB_QUEUED;
+			n += jobs[i].state == JOB_DONE;
+		}
+		fprintf(out,"total %.1f MB/s,%d queued,%d/%d done\n",station_mb(rate),queued,n,njobs);
+		fflush(out);
+		last = now;
+		next += interval;
+		if(next <= now)
+			next = now + interval;
+	}
+
+	/* summary */
+	now = station_now();
+	total = 0;
+	fprintf(out,"%-16s %4s %7s %10s %8s %8s\n","location","bus","result","MB","s","MB/s");
+	for(i = 0;i < njobs;i++){
+		struct station_job *j = &jobs[i];
+		double s = (j->t1 - j->t0) / 1e9;
+
+		fprintf(out,"%-16s %4d %7d %10.1f %8.1f %8.1f\n",j->loc,buses[j->bus].number,j->result,
+			station_mb(j->bytes),s,s > 0 ? station_mb(j->bytes) / s : 0);
+		total += j->bytes;
+		if(j->result != 0)
+			failed++;
+	}
+	for(k = 0;k < nbus;k++){
+		sum = 0;
+		for(i = 0;i < njobs;i++)
+			if(jobs[i].bus == k)
+				sum += jobs[i].bytes;
+		fprintf(out,"bus %d:%d phones,%.1f MB,peak %.1f MB/s\n",buses[k].number,buses[k].jobs,
+			station_mb(sum),station_mb(buses[k].peak));
+	}
+	fprintf(out,"station:%d phones,%d failed,%.1f MB in %.1f s,%.1f MB/s aggregate,peak %.1f MB/s\n",
+		njobs,failed,station_mb(total),(now - t0) / 1e9,
+		now > t0 ? station_mb(total) * 1e9 / (now - t0) : 0,station_mb(peak));
+	fflush(out);
+	return failed ? -1 : 0;
+}
@@ -0,0 +1,36 @@
+#ifndef __STATION_H
+#define __STATION_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <libusb.h>
+
+#include "syberusb.h"
+
+/* Multi-phone station(syber_usb station).
+ * The engine has one session per process,so every phone gets a child
+ * process with its own session,opened by usb location:
+ *   bus-port[.port...]		as /sys/bus/usb/devices
+ * Phones on one bus share its root hub and host controller bandwidth.
+ * Jobs are queued in location order and started on the bus with the
+ * fewest running jobs while it has headroom:fewer than per_bus jobs and,
+ * with a bus limit,a measured rate below it(one interval after the last
+ * start,so the new job is in the measure).
+ * Children report the bytes moved over a pipe,the parent measures each
+ * bus every interval and prints the station status and a summary. */
+
+#define STATION_LOCATION_LEN SYBERUSB_LOCATION_LEN
+#define STATION_MAX 64
+
+/* "bus-port.port" of dev */
+int station_location(libusb_device *dev, char *buf, size_t len);
+/* sprd phones attached,their locations in loc,count or a libusb error */
+int station_list(char (*loc)[STATION_LOCATION_LEN], int max);
+
+/* the jobs of st,see syberusb_station() */
+int station_run(const struct syberusb_config *cfg, const struct syberusb_station *st,
+		syberusb_job_fn job, void *arg);
+
+#endif /* __STATION_H */
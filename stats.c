@@ -0,0 +1,160 @@
+/* per phase latency histograms,see stats.h */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+
+#ifdef SYBER_USB_STATS
+
+#define STATS_SUB_BITS 5
+#define STATS_SUB (1 << STATS_SUB_BITS)
+#define STATS_BUCKETS ((64 - STATS_SUB_BITS + 1) * STATS_SUB)
+
+struct stats_hist {
+	uint64_t count;
+	uint64_t sum;		/* ns */
+	uint64_t max;
+	uint64_t bytes;
+	uint64_t bucket[STATS_BUCKETS];
+};
+
+static const char *stats_names[STATS_PHASES] = {
+	"send","first_byte","receive","escape","checksum","file_write","file_read"
+};
+
+int stats_enabled;
+static int stats_mode;
+static uint64_t stats_t0;
+static struct stats_hist hist[STATS_PHASES];
+
+uint64_t stats_now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/* values below STATS_SUB exact,above:the top STATS_SUB_BITS+1 bits */
+static int stats_bucket(uint64_t v)
+{
+	int shift;
+
+	if(v < STATS_SUB)
+		return v;
+	shift = 63 - __builtin_clzll(v) - STATS_SUB_BITS;
+	return (shift + 1) * STATS_SUB + (int)(v >> shift) - STATS_SUB;
+}
+
+/* largest value of a bucket */
+static uint64_t stats_bucket_top(int idx)
+{
+	int shift;
+
+	if(idx < STATS_SUB)
+		return idx;
+	shift = idx / STATS_SUB - 1;
+	return (((uint64_t)(STATS_SUB + idx % STATS_SUB) + 1) << shift) - 1;
+}
+
+void stats_record(int phase, uint64_t t0, uint64_t bytes)
+{
+	struct stats_hist *h = &hist[phase];
+	uint64_t v = stats_now() - t0;
+	uint64_t max = __atomic_load_n(&h->max,__ATOMIC_RELAXED);
+
+	__atomic_add_fetch(&h->bucket[stats_bucket(v)],1,__ATOMIC_RELAXED);
+	__atomic_add_fetch(&h->count,1,__ATOMIC_RELAXED);
+	__atomic_add_fetch(&h->sum,v,__ATOMIC_RELAXED);
+	if(bytes)
+		__atomic_add_fetch(&h->bytes,bytes,__ATOMIC_RELAXED);
+	while(v > max && !__atomic_compare_exchange_n(&h->max,&max,v,1,__ATOMIC_RELAXED,__ATOMIC_RELAXED))
+		;
+}
+
+static uint64_t stats_percentile(struct stats_hist *h, double p)
+{
+	uint64_t want = (uint64_t)(h->count * p + 0.999999);
+	uint64_t seen = 0;
+	uint64_t v;
+	int i;
+
+	if(want == 0)
+		want = 1;
+	for(i = 0;i < STATS_BUCKETS;i++){
+		seen += h->bucket[i];
+		if(seen >= want)
+			break;
+	}
+	v = stats_bucket_top(i);
+	return v > h->max ? h->max : v;
+}
+
+int stats_enable(int mode)
+{
+	stats_mode = mode;
+	stats_t0 = stats_now();
+	stats_enabled = 1;
+	return 0;
+}
+
+void stats_report(FILE *fp, const char *op)
+{
+	double sec = (stats_now() - stats_t0) / 1e9;
+	uint64_t bytes;
+	int i,first = 1;
+
+	if(!stats_enabled)
+		return;
+	/* payload over usb,or the local files with --image */
+	bytes = hist[STATS_RECV].bytes + hist[STATS_SEND].bytes;
+	if(bytes == 0)
+		bytes = hist[STATS_FILE_WRITE].bytes;
+
+	if(stats_mode == STATS_JSON){
+		fprintf(fp,"{\"op\":\"%s\",\"seconds\":%.3f,\"bytes\":%llu,\"mb_per_s\":%.2f,\"phases\":{",
+			op,sec,(unsigned long long)bytes,sec > 0 ? bytes / 1e6 / sec : 0.0);
+		for(i = 0;i < STATS_PHASES;i++){
+			struct stats_hist *h = &hist[i];
+			if(!h->count)
+				continue;
+			fprintf(fp,"%s\"%s\":{\"count\":%llu,\"bytes\":%llu,\"mean_us\":%.1f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}",
+				first ? "" : ",",stats_names[i],(unsigned long long)h->count,
+				(unsigned long long)h->bytes,h->sum / 1e3 / h->count,
+				stats_percentile(h,0.50) / 1e3,stats_percentile(h,0.99) / 1e3,h->max / 1e3);
+			first = 0;
+		}
+		fprintf(fp,"}}\n");
+		return;
+	}
+
+	fprintf(fp,"stats:%s,%llu Bytes in %.2fs(%.2f MB/s)\n",op,(unsigned long long)bytes,sec,
+		sec > 0 ? bytes / 1e6 / sec : 0.0);
+	fprintf(fp,"  %-10s %10s %12s %10s %10s %10s %10s\n","phase","count","total ms","p50 us","p99 us","max us","MB/s");
+	for(i = 0;i < STATS_PHASES;i++){
+		struct stats_hist *h = &hist[i];
+		if(!h->count)
+			continue;
+		fprintf(fp,"  %-10s %10llu %12.1f %10.1f %10.1f %10.1f",stats_names[i],
+			(unsigned long long)h->count,h->sum / 1e6,
+			stats_percentile(h,0.50) / 1e3,stats_percentile(h,0.99) / 1e3,h->max / 1e3);
+		if(h->bytes && h->sum)
+			fprintf(fp," %10.1f\n",h->bytes * 1e3 / h->sum);
+		else
+			fprintf(fp," %10s\n","-");
+	}
+}
+
+#else
+
+int stats_enable(int mode)
+{
+	return -1;
+}
+
+void stats_report(FILE *fp, const char *op)
+{
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef __STATS_H
+#define __STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Per phase latency histograms of the transfer loops(--stats).
+ * Log-linear buckets as HdrHistogram:every power of two split in 32,
+ * so a percentile is within 3% of the real value,fixed size,no
+ * allocation,lock free(atomic counters,extract workers write files
+ * in parallel).
+ * Built without SYBER_USB_STATS(make STATS=0) the macros are empty
+ * and nothing is measured;built with it,an idle --stats costs one
+ * branch per phase. */
+
+enum stats_phase {
+	STATS_SEND,		/* request out(bulk OUT transfer) */
+	STATS_FIRST_BYTE,	/* request sent to first reply bytes */
+	STATS_RECV,		/* request sent to whole reply frame */
+	STATS_ESCAPE,		/* sprd_frame_exchange,both directions */
+	STATS_CHECKSUM,		/* frame checksum,build or verify */
+	STATS_FILE_WRITE,	/* local file write */
+	STATS_FILE_READ,	/* local file read(write command) */
+	STATS_PHASES
+};
+
+#define STATS_TEXT 1
+#define STATS_JSON 2
+
+#ifdef SYBER_USB_STATS
+
+extern int stats_enabled;
+
+uint64_t stats_now(void);
+void stats_record(int phase, uint64_t t0, uint64_t bytes);
+
+/* t0 of a phase,0 when not measuring */
+#define STATS_T0(t) uint64_t t = stats_enabled ? stats_now() : 0
+#define STATS_SET(t) do{ if(stats_enabled) t = stats_now(); }while(0)
+#define STATS_ADD(phase,t,bytes) do{ if(stats_enabled) stats_record(phase,t,bytes); }while(0)
+
+#else
+
+#define STATS_T0(t) do{}while(0)
+#define STATS_SET(t) do{}while(0)
+#define STATS_ADD(phase,t,bytes) do{}while(0)
+
+#endif
+
+/* mode:STATS_TEXT or STATS_JSON,-1 if not built in */
+int stats_enable(int mode);
+/* percentiles per phase and effective MB/s since stats_enable */
+void stats_report(FILE *fp, const char *op);
+
+#endif /* __STATS_H */
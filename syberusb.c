@@ -0,0 +1,502 @@
+/* libsyberusb session:device setup,callbacks and the operations of
+ * syberusb.h over the transfer engine(sprd.c) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <libusb.h>
+
+#include "main.h"
+#include "checksum.h"
+#include "arena.h"
+#include "stats.h"
+#include "trace.h"
+#include "backup.h"
+#include "frames.h"
+#include "station.h"
+#include "trim.h"
+#include "verify.h"
+#include "test_lwext4.h"
+#include "syberusb.h"
+
+struct syberusb {
+	struct syberusb_config cfg;
+	int usb;		/* libusb initialized */
+	pthread_t thread;
+	int running;		/* started,not waited for */
+	struct syberusb_op op;
+	int result;
+	int cancel;
+};
+
+/* the engine works on static storage:one session at a time */
+static struct syberusb *session;
+/* set on the thread of syberusb_start,its op calls the blocking entries */
+static __thread int session_thread;
+
+/* a blocking call while an op runs on the session thread would drive the
+ * engine from two threads */
+static int syberusb_busy(struct syberusb *s)
+{
+	return !session_thread && __atomic_load_n(&s->running,__ATOMIC_ACQUIRE);
+}
+
+int sprd_log(const char *fmt, ...)
+{
+	char msg[1024];
+	va_list ap;
+	int n;
+
+	if(session == NULL || session->cfg.log == NULL)
+		return 0;
+	va_start(ap,fmt);
+	n = vsnprintf(msg,sizeof(msg),fmt,ap);
+	va_end(ap);
+	session->cfg.log(session->cfg.arg,msg);
+	return n;
+}
+
+int sprd_out(const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	if(session == NULL || session->cfg.out == NULL)
+		return 0;
+	va_start(ap,fmt);
+	n = vfprintf(session->cfg.out,fmt,ap);
+	va_end(ap);
+	return n;
+}
+
+/* raw data to the output stream(ext4fs cat),after what was printed */
+int sprd_out_fd(void)
+{
+	if(session == NULL || session->cfg.out == NULL)
+		return -1;
+	fflush(session->cfg.out);
+	return fileno(session->cfg.out);
+}
+
+int sprd_progress(const char *what, uint64_t done, uint64_t total)
+{
+	if(session == NULL)
+		return 0;
+	if(__atomic_load_n(&session->cancel,__ATOMIC_RELAXED))
+		return 1;
+	if(session->cfg.progress == NULL)
+		return 0;
+	return session->cfg.progress(session->cfg.arg,what,done,total);
+}
+
+static void syberusb_usb_exit(struct syberusb *s)
+{
+	sprd_usb_buf_release();
+	if(sprd_handle != NULL){
+		libusb_release_interface(sprd_handle,SPRD_INTERFACE);
+		libusb_close(sprd_handle);
+		sprd_handle = NULL;
+	}
+	if(devs != NULL){
+		libusb_free_device_list(devs,1);
+		devs = NULL;
+	}
+	sprd_dev = NULL;
+	if(s->usb){
+		libusb_exit(NULL);
+		s->usb = 0;
+	}
+}
+
+/* find the sprd device,open it and claim its interface */
+static int syberusb_usb_init(struct syberusb *s)
+{
+	char loc[STATION_LOCATION_LEN];
+	ssize_t cnt;
+	int i,r;
+
+	r = libusb_init(NULL);
+	if(r < 0)
+		return r;
+	s->usb = 1;
+
+	cnt = libusb_get_device_list(NULL,&devs);
+	if(cnt < 0){
+		devs = NULL;
+		return (int)cnt;
+	}
+	for(i = 0; i < cnt; i++){
+		/* a station opens its phone by location */
+		if(s->cfg.device != NULL &&
+		   (station_location(devs[i],loc,sizeof(loc)) != 0 || strcmp(loc,s->cfg.device) != 0))
+			continue;
+		if(is_sprd_dev(devs[i]) != 0)
+			continue;
+		sprd_dev = devs[i];
+		break;
+	}
+	if(sprd_dev == NULL){
+		if(s->cfg.device != NULL)
+			sprd_log("sprd_dev is null(not find the device at %s)\n",s->cfg.device);
+		else
+			sprd_log("sprd_dev is null(not find the device)\n");
+		return -1;
+	}
+
+	/* print descriptor */
+	r = print_descriptor(sprd_dev);
+	if(r != 0)
+		return -1;
+	/* open & operate */
+	r = libusb_open(sprd_dev,&sprd_handle);
+	if(r != 0){
+		sprd_log("open sprd_dev error(please run as root):%d\n",r);
+		sprd_handle = NULL;
+		return -1;
+	}
+	r = libusb_claim_interface(sprd_handle,SPRD_INTERFACE);//interface 0
+	if(r != 0)
+		sprd_log("claim interface error:%d\n",r);
+	return 0;
+}
+
+int syberusb_open(struct syberusb **sp, const struct syberusb_config *cfg)
+{
+	struct syberusb *s;
+	int r = 0;
+
+	if(session != NULL)
+		return EBUSY;
+	s = calloc(1,sizeof(*s));
+	if(s == NULL)
+		return ENOMEM;
+	s->cfg = *cfg;
+	session = s;
+	if(cfg->stats && stats_enable(cfg->stats) != 0)
+		sprd_log("--stats:not built in(make STATS=1)\n");
+	test_lwext4_set_printf(sprd_log);
+	frames_enable(cfg->flags & SYBERUSB_FRAME_CACHE);
+	checksum_type = TYPE_CRC;
+
+	if(cfg->record != NULL && cfg->replay != NULL){
+		sprd_log("--record and --replay together\n");
+		r = -1;
+	}
+	else if(cfg->record != NULL)
+		r = trace_record_open(cfg->record);
+	else if(cfg->replay != NULL)
+		r = trace_replay_open(cfg->replay);
+	/* a recorded session needs no device */
+	if(r == 0 && !(cfg->flags & SYBERUSB_NO_DEVICE) && !trace_replaying())
+		r = syberusb_usb_init(s);
+	if(r != 0){
+		syberusb_usb_exit(s);
+		trace_close();
+		session = NULL;
+		free(s);
+		return r;
+	}
+	*sp = s;
+	return 0;
+}
+
+void syberusb_close(struct syberusb *s)
+{
+	if(s == NULL)
+		return;
+	if(s->running)
+		syberusb_wait(s);
+	syberusb_usb_exit(s);
+	trace_close();
+	/* lwext4 is unmounted after every command,the usb buffers are back:
+	 * a long lived host does not keep the pools at their peak */
+	if(arena_fini() != 0)
+		sprd_log("arena:buffers still in use,pools kept\n");
+	test_lwext4_set_printf(printf);
+	session = NULL;
+	free(s);
+}
+
+void syberusb_stats_report(struct syberusb *s, FILE *fp, const char *op)
+{
+	stats_report(fp,op);
+}
+
+int syberusb_trace_dump(const char *file, FILE *fp)
+{
+	return trace_dump(file,fp);
+}
+
+int syberusb_station(const struct syberusb_config *cfg, const struct syberusb_station *st,
+		syberusb_job_fn job, void *arg)
+{
+	/* the children open their own sessions */
+	if(session != NULL)
+		return EBUSY;
+	return station_run(cfg,st,job,arg);
+}
+
+int syberusb_list(char (*loc)[SYBERUSB_LOCATION_LEN], int max)
+{
+	return station_list(loc,max);
+}
+
+int syberusb_partition_valid(const char *part)
+{
+	int i;
+
+	for(i = 0;part_table[i][0] != '\0';i++)
+		if(strcmp(part,part_table[i]) == 0)
+			return 1;
+	return 0;
+}
+
+int syberusb_parse_size(const char *str, uint64_t *size)
+{
+	return sprd_parse_size(str,size);
+}
+
+void syberusb_ext4fs_init(struct syberusb_ext4fs *o)
+{
+	memset(o,0,sizeof(*o));
+	o->length = UINT64_MAX;
+	o->tar_fd = -1;
+	o->warmup = SYBERUSB_WARMUP_DEFAULT;
+}
+
+int syberusb_ready(struct syberusb *s)
+{
+	int r;
+
+	if(syberusb_busy(s))
+		return EBUSY;
+	//read task:fdl1,fdl2 enter
+	checksum_type = TYPE_CRC;
+	r = sprd_task_bootrom();
+	if(r != 0){
+		sprd_log("sprd_task_bootrom() error:%d\n",r);
+		return r;
+	}
+	checksum_type = TYPE_IPSUM;
+	r = sprd_task_fdl1();
+	if(r != 0)
+		sprd_log("srpd_task_fdl1() error:%d\n",r);
+	return r;
+}
+
+int syberusb_reset(struct syberusb *s)
+{
+	int r;
+
+	if(syberusb_busy(s))
+		return EBUSY;
+	checksum_type = TYPE_IPSUM;
+	r = sprd_normal_reset();
+	if(r != 0)
+		sprd_log("sprd_normal_reset() error:%d\n",r);
+	return r;
+}
+
+int syberusb_shutdown(struct syberusb *s)
+{
+	int r;
+
+	if(syberusb_busy(s))
+		return EBUSY;
+	checksum_type = TYPE_IPSUM;
+	r = sprd_power_down();
+	if(r != 0)
+		sprd_log("sprd_power_down() error:%d\n",r);
+	return r;
+}
+
+int syberusb_read(struct syberusb *s, const char *part, uint64_t size, const char *file)
+{
+	int r;
+
+	if(syberusb_busy(s))
+		return EBUSY;
+	checksum_type = TYPE_IPSUM;
+	if(!syberusb_partition_valid(part)){
+		sprd_log("partition name %s error\n",part);
+		return -1;
+	}
+	if(size == 0 || size > UINT32_MAX){
+		sprd_log("size %llu error\n",(unsigned long long)size);
+		return -1;
+	}
+	r = sprd_upload((char *)part,size,SPRD_READ_WINDOW,(char *)file);//12K
+	if(r != 0)
+		sprd_log("sprd_upload error:%d\n",r);
+	return r;
+}
+
+int syberusb_write(struct syberusb *s, const char *part, const char *file)
+{
+	int r;
+
+	if(syberusb_busy(s))
+		return EBUSY;
+	checksum_type = TYPE_IPSUM;
+	if(!syberusb_partition_valid(part)){
+		sprd_log("partition name %s error\n",part);
+		return -1;
+	}
+	r = sprd_download_partition((char *)part,file,get_file_size(file),0x5000);//20K
+	if(r != 0)
+		sprd_log("sprd_download partition error:%d\n",r);
+	return r;
+}
+
+int syberusb_write_trim(struct syberusb *s, const char *part, const char *file)
+{
+	int r;
+
+	if(syberusb_busy(s))
+		return EBUSY;
+	checksum_type = TYPE_IPSUM;
+	if(!syberusb_partition_valid(part)){
+		sprd_log("partition name %s error\n",part);
+		return -1;
+	}
+	r = sprd_write_trimmed(part,file,0x5000);//20K
+	if(r != 0)
+		sprd_log("sprd_write_trimmed error:%d\n",r);
+	return r;
+}
+
+int syberusb_verify(struct syberusb *s, const char *part, const char *file, int flags)
+{
+	if(syberusb_busy(s))
+		return EBUSY;
+	checksum_type = TYPE_IPSUM;
+	if(!syberusb_partition_valid(part)){
+		sprd_log("partition name %s error\n",part);
+		return -1;
+	}
+	return sprd_verify(part,file,flags & SYBERUSB_VERIFY_FIRST ? VERIFY_FIRST : 0);
+}
+
+int syberusb_camera(struct syberusb *s)
+{
+	int r;
+
+	if(syberusb_busy(s))
+		return EBUSY;
+	checksum_type = TYPE_IPSUM;
+	r = sprd_read_camera();
+	if(r != 0)
+		sprd_log("sprd_read_camera error:%d\n",r);
+	return r;
+}
+
+int syberusb_ext4fs(struct syberusb *s, const struct syberusb_ext4fs *o)
+{
+	if(syberusb_busy(s))
+		return EBUSY;
+	checksum_type = TYPE_IPSUM;
+	if(o->image == NULL && sprd_handle == NULL && !trace_replaying()){
+		sprd_log("ext4fs:no device(--image?)\n");
+		return -1;
+	}
+	return sprd_ext4fs_task(o);
+}
+
+int syberusb_backup(struct syberusb *s, const char *dir, const char *const *parts)
+{
+	int r;
+
+	if(syberusb_busy(s))
+		return EBUSY;
+	checksum_type = TYPE_IPSUM;
+	r = sprd_backup(dir,parts);
+	if(r != 0)
+		sprd_log("sprd_backup error:%d\n",r);
+	return r;
+}
+
+int syberusb_restore(struct syberusb *s, const char *manifest, const char *const *parts)
+{
+	int r;
+
+	if(syberusb_busy(s))
+		return EBUSY;
+	checksum_type = TYPE_IPSUM;
+	r = sprd_restore(manifest,parts);
+	if(r != 0)
+		sprd_log("sprd_restore error:%d\n",r);
+	return r;
+}
+
+static int syberusb_run(struct syberusb *s, const struct syberusb_op *op)
+{
+	switch(op->type){
+	case SYBERUSB_OP_READY:
+		return syberusb_ready(s);
+	case SYBERUSB_OP_RESET:
+		return syberusb_reset(s);
+	case SYBERUSB_OP_SHUTDOWN:
+		return syberusb_shutdown(s);
+	case SYBERUSB_OP_READ:
+		return syberusb_read(s,op->part,op->size,op->file);
+	case SYBERUSB_OP_WRITE:
+		return syberusb_write(s,op->part,op->file);
+	case SYBERUSB_OP_WRITE_TRIM:
+		return syberusb_write_trim(s,op->part,op->file);
+	case SYBERUSB_OP_VERIFY:
+		return syberusb_verify(s,op->part,op->file,op->flags);
+	case SYBERUSB_OP_CAMERA:
+		return syberusb_camera(s);
+	case SYBERUSB_OP_EXT4FS:
+		return syberusb_ext4fs(s,&op->ext4fs);
+	case SYBERUSB_OP_BACKUP:
+		return syberusb_backup(s,op->file,op->parts);
+	case SYBERUSB_OP_RESTORE:
+		return syberusb_restore(s,op->file,op->parts);
+	}
+	return -1;
+}
+
+static void *syberusb_thread(void *arg)
+{
+	struct syberusb *s = arg;
+
+	session_thread = 1;
+	s->result = syberusb_run(s,&s->op);
+	return NULL;
+}
+
+int syberusb_start(struct syberusb *s, const struct syberusb_op *op)
+{
+	if(s->running)
+		return EBUSY;
+	s->op = *op;
+	s->result = 0;
+	__atomic_store_n(&s->cancel,0,__ATOMIC_RELAXED);
+	__atomic_store_n(&s->running,1,__ATOMIC_RELEASE);
+	if(pthread_create(&s->thread,NULL,syberusb_thread,s) != 0){
+		__atomic_store_n(&s->running,0,__ATOMIC_RELEASE);
+		return EAGAIN;
+	}
+	return 0;
+}
+
+int syberusb_wait(struct syberusb *s)
+{
+	if(!s->running)
+		return EINVAL;
+	pthread_join(s->thread,NULL);
+	__atomic_store_n(&s->running,0,__ATOMIC_RELEASE);
+	__atomic_store_n(&s->cancel,0,__ATOMIC_RELAXED);
+	return s->result;
+}
+
+void syberusb_cancel(struct syberusb *s)
+{
+	__atomic_store_n(&s->cancel,1,__ATOMIC_RELAXED);
+}
@@ -0,0 +1,174 @@
+#ifndef __SYBERUSB_H
+#define __SYBERUSB_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* libsyberusb:the sprd usb download protocol,partition read/write and
+ * the ext4fs/FatFs access of syber_usb as a library(libsyberusb.a,
+ * libsyberusb.so),syber_usb itself is a command line over it.
+ *
+ * Nothing goes to stdout:messages are passed to the log callback,
+ * listings(ext4fs ls/find/du) and ext4fs cat data are written to the
+ * output stream,progress goes to the progress callback,which may cancel.
+ * Callbacks run on the thread of the operation(extract workers may log
+ * concurrently).
+ *
+ * One session per process:the transfer engine keeps the device handle
+ * and its buffers in static storage.An operation runs on the calling
+ * thread,or on a session thread with syberusb_start()/syberusb_wait():
+ * until then the blocking calls return EBUSY.
+ *
+ * Return values are those of the engine:0 ok,libusb error codes,-1,or
+ * errno values(ECANCELED after a cancel). */
+
+struct syberusb;
+
+/* msg:one printf style message,usually ending with '\n' */
+typedef void (*syberusb_log_fn)(void *arg, const char *msg);
+/* what:"upload"/"download" for partitions,NULL for files(total 0:empty
+ * file),non zero return cancels the operation */
+typedef int (*syberusb_progress_fn)(void *arg, const char *what, uint64_t done, uint64_t total);
+
+#define SYBERUSB_NO_DEVICE 0x01	/* ext4fs on partition dumps only */
+#define SYBERUSB_FRAME_CACHE 0x02	/* write/restore from {image}.frames */
+
+struct syberusb_config {
+	uint32_t flags;
+	syberusb_log_fn log;		/* NULL:messages dropped */
+	syberusb_progress_fn progress;	/* NULL:no progress */
+	void *arg;			/* passed to the callbacks */
+	FILE *out;			/* listings and cat data,NULL:discarded */
+	const char *record;		/* save every usb transfer to this trace */
+	const char *replay;		/* run on this trace instead of the device */
+	int stats;			/* SYBERUSB_STATS_*:time the transfer phases */
+	const char *device;		/* usb location(syberusb_list),NULL:the first phone */
+};
+
+#define SYBERUSB_STATS_TEXT 1
+#define SYBERUSB_STATS_JSON 2
+
+#define SYBERUSB_WARMUP_DEFAULT (-1)
+#define SYBERUSB_WARMUP_NONE 0
+#define SYBERUSB_WARMUP_GDT 0x01	/* superblock and group descriptors */
+#define SYBERUSB_WARMUP_ITABLE 0x02	/* head of the group 0 inode table */
+
+/* ext4fs command,zero filled then:length UINT64_MAX,tar_fd -1,
+ * warmup SYBERUSB_WARMUP_DEFAULT(syberusb_ext4fs_init) */
+struct syberusb_ext4fs {
+	const char *cmd;	/* ls get cat extract tar find du */
+	const char *path;	/* /syberfs/.. or /data/.. */
+	const char *dest;	/* extract directory,tar archive(NULL:tar_fd) */
+	int tar_fd;
+	uint64_t offset;	/* get/cat byte range */
+	uint64_t length;
+	int jobs;		/* extract threads,0:cpu count up to 8 */
+	int ls_long;
+	int ls_recursive;
+	int du_summary;
+	const char *find_name;	/* find predicates,NULL:any */
+	const char *find_size;
+	const char *find_mtime;
+	const char *find_type;
+	int warmup;
+	const char *image;	/* partition dump instead of the device */
+};
+
+void syberusb_ext4fs_init(struct syberusb_ext4fs *o);
+
+/* find and open the phone(not with SYBERUSB_NO_DEVICE or replay) */
+int syberusb_open(struct syberusb **s, const struct syberusb_config *cfg);
+/* waits for a started operation */
+void syberusb_close(struct syberusb *s);
+
+int syberusb_ready(struct syberusb *s);		/* bootrom,fdl1,fdl2 */
+int syberusb_reset(struct syberusb *s);		/* reboot to normal */
+int syberusb_shutdown(struct syberusb *s);
+int syberusb_read(struct syberusb *s, const char *part, uint64_t size, const char *file);
+int syberusb_write(struct syberusb *s, const char *part, const char *file);
+/* erase the partition,write file up to its last non zero byte,read back
+ * samples of the skipped zero tail */
+int syberusb_write_trim(struct syberusb *s, const char *part, const char *file);
+#define SYBERUSB_VERIFY_FIRST 0x01	/* stop at the first mismatch */
+/* read part back and compare it with the size of file bytes,mismatching
+ * ranges are logged,-1 if any */
+int syberusb_verify(struct syberusb *s, const char *part, const char *file, int flags);
+int syberusb_camera(struct syberusb *s);	/* /DCIM/Camera to ./syberos_camera */
+int syberusb_ext4fs(struct syberusb *s, const struct syberusb_ext4fs *o);
+/* partitions to {dir}/{partition}.img and {dir}/manifest(after ready),
+ * parts:NULL terminated "name","name=size" or "-name"(all but name),
+ * NULL:every partition */
+int syberusb_backup(struct syberusb *s, const char *dir, const char *const *parts);
+/* write the partitions of a backup manifest(after ready),parts:NULL
+ * terminated names,NULL:every partition of the manifest */
+int syberusb_restore(struct syberusb *s, const char *manifest, const char *const *parts);
+
+/* asynchronous operations */
+enum syberusb_op_type {
+	SYBERUSB_OP_READY,
+	SYBERUSB_OP_RESET,
+	SYBERUSB_OP_SHUTDOWN,
+	SYBERUSB_OP_READ,
+	SYBERUSB_OP_WRITE,
+	SYBERUSB_OP_CAMERA,
+	SYBERUSB_OP_EXT4FS,
+	SYBERUSB_OP_BACKUP,	/* file:dir */
+	SYBERUSB_OP_RESTORE,	/* file:manifest */
+	SYBERUSB_OP_WRITE_TRIM,
+	SYBERUSB_OP_VERIFY,	/* flags:SYBERUSB_VERIFY_* */
+};
+
+/* copied by syberusb_start,the strings must stay valid until syberusb_wait */
+struct syberusb_op {
+	enum syberusb_op_type type;
+	const char *part;
+	const char *file;
+	uint64_t size;
+	const char *const *parts;
+	struct syberusb_ext4fs ext4fs;
+	int flags;
+};
+
+/* run op on the session thread,EBUSY if one is running */
+int syberusb_start(struct syberusb *s, const struct syberusb_op *op);
+/* result of the started operation */
+int syberusb_wait(struct syberusb *s);
+/* ask the running operation to stop at its next progress point */
+void syberusb_cancel(struct syberusb *s);
+
+/* Multi-phone station:a job per phone,each in a child process with
+ * its own session(cfg with device set).Jobs start on the usb bus with
+ * the fewest running jobs while it has headroom,the bytes the jobs move
+ * are measured per bus every interval.Called without an open session;
+ * status lines and the summary go to cfg->out(NULL:stderr),the children
+ * log through cfg->log with a "[location] " prefix,cfg->progress is
+ * not called.0 if every job returned 0. */
+typedef int (*syberusb_job_fn)(struct syberusb *s, const char *location, void *arg);
+
+struct syberusb_station {
+	const char *const *devices;	/* NULL terminated locations,NULL:every phone */
+	int per_bus;		/* jobs at once on a bus,0:2,-1:no cap(control only jobs) */
+	uint32_t bus_limit;	/* MB/s,no new job on a busy bus measured above it,0:none */
+	int interval;		/* ms between measures and status lines,0:1000 */
+};
+
+int syberusb_station(const struct syberusb_config *cfg, const struct syberusb_station *st,
+		syberusb_job_fn job, void *arg);
+
+/* usb location of a phone:"bus-port[.port...]" as /sys/bus/usb/devices */
+#define SYBERUSB_LOCATION_LEN 32
+/* sprd phones attached,sorted,count or a libusb error */
+int syberusb_list(char (*loc)[SYBERUSB_LOCATION_LEN], int max);
+
+/* p50/p99/max of the transfer phases since syberusb_open(config stats),
+ * op:name in the report */
+void syberusb_stats_report(struct syberusb *s, FILE *fp, const char *op);
+/* list the transfers of a --record trace */
+int syberusb_trace_dump(const char *file, FILE *fp);
+
+/* partition name of the phone's table */
+int syberusb_partition_valid(const char *part);
+/* 4096,0x1000,4k,12m,2g into size,0:ok,-1:not a size */
+int syberusb_parse_size(const char *str, uint64_t *size);
+
+#endif /* __SYBERUSB_H */
@@ -0,0 +1,292 @@
+/* binary usb session trace,see trace.h */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <libusb.h>
+
+#include "main.h"
+#include "trace.h"
+
+/* recorder buffer,written out when full */
+#define TRACE_BUF_SIZE (1024 * 1024)
+
+static int rec_fd = -1;
+static char *rec_buf;
+static size_t rec_len;
+static uint64_t rec_t0;
+static pthread_mutex_t rec_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const uint8_t *rp_map;
+static size_t rp_size;
+static size_t rp_off;
+static uint64_t rp_count;
+static int rp_diverged;
+
+static uint64_t trace_now(int clock)
+{
+	struct timespec t;
+	clock_gettime(clock,&t);
+	return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static int trace_write(const void *data, size_t len)
+{
+	const char *p = data;
+	ssize_t r;
+
+	while(len){
+		r = write(rec_fd,p,len);
+		if(r == -1){
+			if(errno == EINTR) continue;
+			sprd_log("trace_write:write error:%d\n",errno);
+			return -1;
+		}
+		p += r;
+		len -= r;
+	}
+	return 0;
+}
+
+int trace_record_open(const char *file)
+{
+	struct trace_hdr h;
+
+	rec_fd = open(file,O_CREAT|O_WRONLY|O_TRUNC,0666);
+	if(rec_fd == -1){
+		sprd_log("trace_record_open:open or create %s error:%d\n",file,errno);
+		return -1;
+	}
+	rec_buf = malloc(TRACE_BUF_SIZE);
+	if(rec_buf == NULL){
+		close(rec_fd);
+		rec_fd = -1;
+		return -1;
+	}
+	memset(&h,0,sizeof(h));
+	memcpy(h.magic,TRACE_MAGIC,sizeof(h.magic));
+	h.version = TRACE_VERSION;
+	h.start = trace_now(CLOCK_REALTIME);
+	rec_t0 = trace_now(CLOCK_MONOTONIC);
+	memcpy(rec_buf,&h,sizeof(h));
+	rec_len = sizeof(h);
+	atexit(trace_close);
+	return 0;
+}
+
+int trace_recording(void)
+{
+	return rec_fd != -1;
+}
+
+void trace_record(uint8_t ep, const void *data, int len, int status)
+{
+	struct trace_rec r;
+
+	if(len < 0)
+		len = 0;
+	r.ns = trace_now(CLOCK_MONOTONIC) - rec_t0;
+	r.len = len;
+	r.ep = ep;
+	r.status = status;
+	r.reserved = 0;
+
+	pthread_mutex_lock(&rec_lock);
+	if(rec_fd == -1)
+		goto out;
+	if(rec_len + sizeof(r) + len > TRACE_BUF_SIZE){
+		if(trace_write(rec_buf,rec_len) != 0)
+			goto fail;
+		rec_len = 0;
+	}
+	memcpy(rec_buf + rec_len,&r,sizeof(r));
+	rec_len += sizeof(r);
+	if(sizeof(r) + len > TRACE_BUF_SIZE){
+		/* bigger than the buffer:straight to the file */
+		if(trace_write(rec_buf,rec_len) != 0 || trace_write(data,len) != 0)
+			goto fail;
+		rec_len = 0;
+		goto out;
+	}
+	memcpy(rec_buf + rec_len,data,len);
+	rec_len += len;
+	goto out;
+fail:
+	/* a broken trace is useless,stop recording */
+	close(rec_fd);
+	rec_fd = -1;
+out:
+	pthread_mutex_unlock(&rec_lock);
+}
+
+void trace_close(void)
+{
+	pthread_mutex_lock(&rec_lock);
+	if(rec_fd != -1){
+		trace_write(rec_buf,rec_len);
+		close(rec_fd);
+		rec_fd = -1;
+	}
+	free(rec_buf);
+	rec_buf = NULL;
+	rec_len = 0;
+	pthread_mutex_unlock(&rec_lock);
+}
+
+static const uint8_t *trace_map(const char *file, size_t *size)
+{
+	struct trace_hdr h;
+	struct stat sb;
+	void *p;
+	int fd;
+
+	fd = open(file,O_RDONLY);
+	if(fd == -1){
+		sprd_log("trace:open %s error:%d\n",file,errno);
+		return NULL;
+	}
+	if(fstat(fd,&sb) != 0 || sb.st_size < (off_t)sizeof(h)){
+		sprd_log("trace:%s is not a trace\n",file);
+		close(fd);
+		return NULL;
+	}
+	p = mmap(NULL,sb.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+	if(p == MAP_FAILED){
+		sprd_log("trace:mmap %s error:%d\n",file,errno);
+		return NULL;
+	}
+	memcpy(&h,p,sizeof(h));
+	if(memcmp(h.magic,TRACE_MAGIC,sizeof(h.magic)) != 0 || h.version != TRACE_VERSION){
+		sprd_log("trace:%s is not a version %d trace\n",file,TRACE_VERSION);
+		munmap(p,sb.st_size);
+		return NULL;
+	}
+	madvise(p,sb.st_size,MADV_SEQUENTIAL);
+	*size = sb.st_size;
+	return p;
+}
+
+/* the record at *off,NULL at the end or on a cut record */
+static const uint8_t *trace_next(const uint8_t *map, size_t size, size_t *off, struct trace_rec *r)
+{
+	const uint8_t *payload;
+
+	if(*off + sizeof(*r) > size)
+		return NULL;
+	memcpy(r,map + *off,sizeof(*r));
+	if(*off + sizeof(*r) + r->len > size)
+		return NULL;
+	payload = map + *off + sizeof(*r);
+	*off += sizeof(*r) + r->len;
+	return payload;
+}
+
+int trace_replay_open(const char *file)
+{
+	rp_map = trace_map(file,&rp_size);
+	if(rp_map == NULL)
+		return -1;
+	rp_off = sizeof(struct trace_hdr);
+	return 0;
+}
+
+int trace_replaying(void)
+{
+	return rp_map != NULL;
+}
+
+int trace_replay(uint8_t ep, void *data, int len, int *transferred)
+{
+	struct trace_rec r;
+	const uint8_t *payload;
+	int i;
+
+	*transferred = 0;
+	if(rp_diverged)
+		return LIBUSB_ERROR_IO;
+	payload = trace_next(rp_map,rp_size,&rp_off,&r);
+	if(payload == NULL){
+		sprd_log("replay:end of trace after %llu transfers\n",(unsigned long long)rp_count);
+		rp_diverged = 1;
+		return LIBUSB_ERROR_NO_DEVICE;
+	}
+	rp_count++;
+	if(r.ep != ep){
+		sprd_log("replay:transfer %llu:endpoint 0x%02x,recorded 0x%02x\n",
+			(unsigned long long)rp_count,ep,r.ep);
+		rp_diverged = 1;
+		return LIBUSB_ERROR_IO;
+	}
+	if(!(ep & 0x80)){
+		/* the request must be the recorded one */
+		if(r.len != len || memcmp(payload,data,len) != 0){
+			for(i = 0;i < len && i < r.len && payload[i] == ((uint8_t *)data)[i];i++);
+			sprd_log("replay:transfer %llu:request differs at byte %d(%d bytes,recorded %u)\n",
+				(unsigned long long)rp_count,i,len,r.len);
+			rp_diverged = 1;
+			return LIBUSB_ERROR_IO;
+		}
+		*transferred = len;
+		return r.status;
+	}
+	if(r.len > len){
+		sprd_log("replay:transfer %llu:%u bytes recorded,room for %d\n",
+			(unsigned long long)rp_count,r.len,len);
+		rp_diverged = 1;
+		return LIBUSB_ERROR_OVERFLOW;
+	}
+	memcpy(data,payload,r.len);
+	*transferred = r.len;
+	return r.status;
+}
+
+int trace_dump(const char *file, FILE *fp)
+{
+	struct trace_hdr h;
+	struct trace_rec r;
+	const uint8_t *map,*payload;
+	size_t size,off = sizeof(h);
+	uint64_t n = 0,n_in = 0,n_out = 0,b_in = 0,b_out = 0,errs = 0,ns = 0;
+
+	map = trace_map(file,&size);
+	if(map == NULL)
+		return -1;
+	memcpy(&h,map,sizeof(h));
+	fprintf(fp,"%8s %12s %4s %8s %6s %4s\n","#","ms","ep","bytes","status","type");
+	while((payload = trace_next(map,size,&off,&r)) != NULL){
+		n++;
+		fprintf(fp,"%8llu %12.3f 0x%02x %8u %6d",(unsigned long long)n,r.ns / 1e6,r.ep,r.len,r.status);
+		/* frame type,the byte after 0x7e 0x00 */
+		if(r.len >= 3 && payload[0] == 0x7e)
+			fprintf(fp," 0x%02x\n",payload[2]);
+		else
+			fprintf(fp,"\n");
+		if(r.ep & 0x80){
+			n_in++;
+			b_in += r.len;
+		}
+		else {
+			n_out++;
+			b_out += r.len;
+		}
+		if(r.status != 0)
+			errs++;
+		ns = r.ns;
+	}
+	fprintf(fp,"%llu transfers in %.3f s:%llu out(%llu Bytes),%llu in(%llu Bytes),%llu errors/timeouts\n",
+		(unsigned long long)n,ns / 1e9,(unsigned long long)n_out,(unsigned long long)b_out,
+		(unsigned long long)n_in,(unsigned long long)b_in,(unsigned long long)errs);
+	if(off != size)
+		fprintf(fp,"warning:%zu bytes at the end are a cut record\n",size - off);
+	munmap((void *)map,size);
+	return 0;
+}
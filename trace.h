@@ -0,0 +1,51 @@
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Binary usb session trace(--record/--replay).
+ * A file header then one record per bulk transfer,as it went over the
+ * wire(escaped frames):
+ *   struct trace_rec,payload(len bytes,what was sent or received)
+ * little endian,no padding between records.Records are buffered and
+ * written in big blocks,a transfer costs a memcpy.
+ * Replay serves the recorded IN data to the same code(frame decoder,
+ * lwext4,FatFs) without a device:every OUT transfer must match the
+ * recorded request,the first difference stops the replay. */
+
+#define TRACE_MAGIC "SPRDUSBT"
+#define TRACE_VERSION 1
+
+struct trace_hdr {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t start;		/* CLOCK_REALTIME ns of the first record */
+};
+
+struct trace_rec {
+	uint64_t ns;		/* since start,CLOCK_MONOTONIC */
+	uint32_t len;		/* payload bytes(transferred count) */
+	uint8_t ep;		/* endpoint,bit 7 set:IN */
+	int8_t status;		/* libusb_bulk_transfer return */
+	uint16_t reserved;
+};
+
+int trace_record_open(const char *file);
+int trace_replay_open(const char *file);
+int trace_recording(void);
+int trace_replaying(void);
+
+/* recorder:one finished transfer */
+void trace_record(uint8_t ep, const void *data, int len, int status);
+/* replay:the transfer the caller would have made,returns its status */
+int trace_replay(uint8_t ep, void *data, int len, int *transferred);
+
+/* flush and close the recording */
+void trace_close(void);
+
+/* list the records of a trace file */
+int trace_dump(const char *file, FILE *fp);
+
+#endif /* __TRACE_H */
@@ -0,0 +1,182 @@
+/* erase,then write the data prefix of an image,see trim.h */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "main.h"
+#include "protocol.h"
+#include "trim.h"
+
+/* scanned backwards a chunk at a time,the next one read ahead */
+#define TRIM_CHUNK (8 * 1024 * 1024)
+
+/* end of the last data extent,holes of a sparse file are zero */
+static uint64_t trim_data_limit(int fd, uint64_t size)
+{
+	off_t off = 0,data,hole;
+	uint64_t end = 0;
+
+	for(;;){
+		data = lseek(fd,off,SEEK_DATA);
+		if(data == -1)
+			break;
+		hole = lseek(fd,data,SEEK_HOLE);
+		if(hole == -1)
+			return size;
+		end = hole;
+		off = hole;
+	}
+	/* no SEEK_DATA here:everything is data */
+	if(errno != ENXIO)
+		return size;
+	return end < size ? end : size;
+}
+
+/* offset after the last non zero byte of p[0..len),p 64 byte aligned */
+static uint64_t trim_last_nonzero(const uint8_t *p, uint64_t len)
+{
+	uint64_t end = len;
+
+	while(end % 64){
+		if(p[end - 1])
+			return end;
+		end--;
+	}
+#ifdef __SSE2__
+	while(end){
+		const __m128i *q = (const __m128i *)(p + end - 64);
+		__m128i v = _mm_or_si128(_mm_or_si128(_mm_load_si128(q),_mm_load_si128(q + 1)),
+			_mm_or_si128(_mm_load_si128(q + 2),_mm_load_si128(q + 3)));
+		if(_mm_movemask_epi8(_mm_cmpeq_epi8(v,_mm_setzero_si128())) != 0xffff)
+			break;
+		end -= 64;
+	}
+#else
+	while(end){
+		const uint64_t *q = (const uint64_t *)(p + end - 64);
+		if(q[0] | q[1] | q[2] | q[3] | q[4] | q[5] | q[6] | q[7])
+			break;
+		end -= 64;
+	}
+#endif
+	while(end && p[end - 1] == 0)
+		end--;
+	return end;
+}
+
+int64_t trim_data_end(int fd, uint64_t size)
+{
+	const uint8_t *map;
+	uint64_t len,limit,lo,end = 0;
+
+	len = limit = trim_data_limit(fd,size);
+	if(len == 0)
+		return 0;
+	map = mmap(NULL,len,PROT_READ,MAP_SHARED,fd,0);
+	if(map == MAP_FAILED){
+		sprd_log("trim:mmap error:%d\n",errno);
+		return -1;
+	}
+	while(limit){
+		lo = limit > TRIM_CHUNK ? (limit - 1) / TRIM_CHUNK * TRIM_CHUNK : 0;
+		if(lo >= TRIM_CHUNK)
+			madvise((void *)(map + lo - TRIM_CHUNK),TRIM_CHUNK,MADV_WILLNEED);
+		end = trim_last_nonzero(map + lo,limit - lo);
+		if(end){
+			end += lo;
+			break;
+		}
+		limit = lo;
+	}
+	munmap((void *)map,len);
+	return end;
+}
+
+/* windows of the skipped tail[from,size) read back,all zero */
+static int trim_verify(const char *part, uint64_t from, uint64_t size)
+{
+	uint64_t span = size - from,off;
+	uint32_t win = span < SPRD_READ_WINDOW ? span : SPRD_READ_WINDOW;
+	const uint8_t *p = data_buffer + SPRD_FRAME_DATA_OFF;
+	int i,n,r;
+	uint32_t j;
+
+	n = (span + win - 1) / win < TRIM_SAMPLES ? (span + win - 1) / win : TRIM_SAMPLES;
+	r = sprd_read_start(part);
+	if(r != 0)
+		return r;
+	for(i = 0;i < n;i++){
+		/* the first window after the prefix,the last of the image,evenly between */
+		off = n > 1 ? from + (span - win) * i / (n - 1) : from;
+		if(off > from)
+			off -= off % TRIM_ALIGN;
+		r = sprd_read_flash(NULL,win,off);
+		if(r != 0){
+			sprd_log("trim:read back at 0x%llx error:%d\n",(unsigned long long)off,r);
+			sprd_read_end();
+			return r;
+		}
+		for(j = 0;j < win && p[j] == 0;j++);
+		if(j != win){
+			sprd_log("trim:'%s' at 0x%llx reads 0x%02x after the erase,not zero:write the whole image\n",
+				part,(unsigned long long)(off + j),p[j]);
+			sprd_read_end();
+			return -1;
+		}
+	}
+	r = sprd_read_end();
+	if(r == 0)
+		sprd_log("trim:%d windows of the skipped tail read back zero\n",n);
+	return r;
+}
+
+int sprd_write_trimmed(const char *part_name, const char *file_name, uint32_t win_size)
+{
+	struct stat sb;
+	int64_t end;
+	uint64_t prefix;
+	int fd,r;
+
+	fd = open(file_name,O_RDONLY);
+	if(fd == -1){
+		sprd_log("file '%s' not exist\n",file_name);
+		return -1;
+	}
+	if(fstat(fd,&sb) != 0 || (sb.st_mode & S_IFMT) != S_IFREG ||
+	   sb.st_size == 0 || sb.st_size > UINT32_MAX){
+		sprd_log("file '%s' is not a regular file of 1 Byte..4 GB\n",file_name);
+		close(fd);
+		return -1;
+	}
+	end = trim_data_end(fd,sb.st_size);
+	close(fd);
+	if(end < 0)
+		return -1;
+	prefix = (end + TRIM_ALIGN - 1) / TRIM_ALIGN * TRIM_ALIGN;
+	if(prefix > (uint64_t)sb.st_size)
+		prefix = sb.st_size;
+	sprd_log("trim:'%s' data ends at 0x%llx,writing 0x%llx of 0x%llx Bytes after an erase\n",
+		file_name,(unsigned long long)end,(unsigned long long)prefix,(unsigned long long)sb.st_size);
+
+	r = sprd_erase_partition(part_name);
+	if(r != 0)
+		return r;
+	if(prefix){
+		r = sprd_download_partition((char *)part_name,file_name,prefix,win_size);
+		if(r != 0)
+			return r;
+	}
+	if(prefix < (uint64_t)sb.st_size)
+		r = trim_verify(part_name,prefix,sb.st_size);
+	return r;
+}
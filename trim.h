@@ -0,0 +1,25 @@
+#ifndef __TRIM_H
+#define __TRIM_H
+
+#include <stdint.h>
+
+/* Trimmed write(syber_usb write --trim).
+ * cache,userdata and the like are mostly a filesystem head and hundreds
+ * of MB of zeros:the image is scanned backwards for its last non zero
+ * byte(holes of a sparse image skipped with SEEK_DATA/SEEK_HOLE,the data
+ * compared 64 bytes a step),the partition is erased(ERASE_FLASH) and only
+ * the prefix,rounded up to TRIM_ALIGN,is written.
+ * The skipped tail is not sent:TRIM_SAMPLES windows spread over it are
+ * read back and must be zero,a flash that erases to 0xff(raw nand) fails
+ * the write instead of leaving a corrupt image. */
+
+#define TRIM_ALIGN 4096
+#define TRIM_SAMPLES 16
+
+/* offset after the last non zero byte of fd(size bytes),0:all zero,
+ * -1:read error */
+int64_t trim_data_end(int fd, uint64_t size);
+
+int sprd_write_trimmed(const char *part, const char *file, uint32_t win_size);
+
+#endif /* __TRIM_H */
@@ -0,0 +1,260 @@
+/* read a partition back and compare it with its image,see verify.h */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "main.h"
+#include "verify.h"
+
+#define VERIFY_CHUNK (SPRD_READ_WINDOW * 64)	//768k
+#define VERIFY_DEPTH 4
+#define VERIFY_BLOCK 4096			//memcmp unit
+#define VERIFY_LIST 64				//ranges listed,then counted
+
+struct verify_chunk {
+	uint8_t *buf;
+	uint32_t off;
+	uint32_t len;
+};
+
+struct verify_part {
+	const char *name;
+	const uint8_t *image;
+	uint32_t size;
+	int flags;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct verify_chunk ring[VERIFY_DEPTH];
+	int head,tail,cnt;
+	int done;		/* no more chunks */
+	int mismatch;		/* worker:a difference was found */
+	/* worker results */
+	uint64_t bad;		/* bytes that differ */
+	uint32_t ranges;
+	uint32_t r_start,r_end;	/* open range,r_end 0:none */
+	uint32_t r_bad;
+};
+
+static double verify_now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void verify_close_range(struct verify_part *p)
+{
+	if(p->r_end == 0)
+		return;
+	if(p->ranges < VERIFY_LIST)
+		sprd_log("verify:%s 0x%08x-0x%08x differs(%u Bytes)\n",p->name,p->r_start,p->r_end - 1,p->r_bad);
+	else if(p->ranges == VERIFY_LIST)
+		sprd_log("verify:%s more ranges differ,not listed\n",p->name);
+	p->ranges++;
+	p->r_end = 0;
+}
+
+/* the differing bytes of a block,the open range grows over it */
+static void verify_block(struct verify_part *p, const uint8_t *a, const uint8_t *b, uint32_t off, uint32_t n)
+{
+	uint32_t i,first = n,last = 0,bad = 0;
+
+	for(i = 0;i < n;i++){
+		if(a[i] != b[i]){
+			if(first == n)
+				first = i;
+			last = i;
+			bad++;
+		}
+	}
+	if(p->r_end == 0){
+		p->r_start = off + first;
+		p->r_bad = 0;
+	}
+	p->r_end = off + last + 1;
+	p->r_bad += bad;
+	p->bad += bad;
+}
+
+static void verify_chunk_cmp(struct verify_part *p, struct verify_chunk *c)
+{
+	const uint8_t *img = p->image + c->off;
+	uint32_t i,n;
+
+	for(i = 0;i < c->len;i += n){
+		n = c->len - i < VERIFY_BLOCK ? c->len - i : VERIFY_BLOCK;
+		if(memcmp(c->buf + i,img + i,n) == 0){
+			verify_close_range(p);
+			continue;
+		}
+		verify_block(p,c->buf + i,img + i,c->off + i,n);
+	}
+}
+
+static void *verify_worker(void *arg)
+{
+	struct verify_part *p = arg;
+	struct verify_chunk *c;
+	uint64_t bad;
+
+	for(;;){
+		pthread_mutex_lock(&p->lock);
+		while(p->cnt == 0 && !p->done)
+			pthread_cond_wait(&p->cond,&p->lock);
+		if(p->cnt == 0){
+			pthread_mutex_unlock(&p->lock);
+			break;
+		}
+		c = &p->ring[p->tail];
+		pthread_mutex_unlock(&p->lock);
+
+		bad = p->bad;
+		verify_chunk_cmp(p,c);
+
+		pthread_mutex_lock(&p->lock);
+		if(p->bad != bad)
+			p->mismatch = 1;
+		p->tail = (p->tail + 1) % VERIFY_DEPTH;
+		p->cnt--;
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->lock);
+	}
+	verify_close_range(p);
+	return NULL;
+}
+
+/* usb side:windows into free chunks,full chunks to the worker */
+static int verify_read(struct verify_part *p, uint32_t *read)
+{
+	struct verify_chunk *c;
+	uint32_t off = 0,len,w,i;
+	int r = 0,stop;
+
+	while(off < p->size){
+		pthread_mutex_lock(&p->lock);
+		while(p->cnt == VERIFY_DEPTH && !(p->mismatch && (p->flags & VERIFY_FIRST)))
+			pthread_cond_wait(&p->cond,&p->lock);
+		stop = p->mismatch && (p->flags & VERIFY_FIRST);
+		c = &p->ring[p->head];
+		pthread_mutex_unlock(&p->lock);
+		if(stop)
+			break;
+
+		len = p->size - off < VERIFY_CHUNK ? p->size - off : VERIFY_CHUNK;
+		for(i = 0;i < len;i += w){
+			w = len - i < SPRD_READ_WINDOW ? len - i : SPRD_READ_WINDOW;
+			r = sprd_read_flash(c->buf + i,w,off + i);
+			if(r != 0){
+				sprd_log("verify:%s read flash error:%d\n",p->name,r);
+				return r;
+			}
+		}
+		c->off = off;
+		c->len = len;
+		off += len;
+
+		pthread_mutex_lock(&p->lock);
+		p->head = (p->head + 1) % VERIFY_DEPTH;
+		p->cnt++;
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->lock);
+
+		if(sprd_progress("verify",off,p->size) != 0){
+			sprd_log("verify:canceled\n");
+			return ECANCELED;
+		}
+	}
+	*read = off;
+	return r;
+}
+
+int sprd_verify(const char *part, const char *image, int flags)
+{
+	struct verify_part p;
+	struct stat sb;
+	pthread_t th;
+	uint32_t read = 0;
+	double t0,sec;
+	int fd,i,r,r2;
+
+	fd = open(image,O_RDONLY);
+	if(fd == -1){
+		sprd_log("file '%s' not exist\n",image);
+		return -1;
+	}
+	if(fstat(fd,&sb) != 0 || (sb.st_mode & S_IFMT) != S_IFREG ||
+	   sb.st_size == 0 || sb.st_size > UINT32_MAX){
+		sprd_log("file '%s' is not a regular file of 1 Byte..4 GB\n",image);
+		close(fd);
+		return -1;
+	}
+	memset(&p,0,sizeof(p));
+	p.name = part;
+	p.size = sb.st_size;
+	p.flags = flags;
+	p.image = mmap(NULL,p.size,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if(p.image == MAP_FAILED){
+		sprd_log("verify:mmap %s error:%d\n",image,errno);
+		return -1;
+	}
+	madvise((void *)p.image,p.size,MADV_SEQUENTIAL);
+	for(i = 0;i < VERIFY_DEPTH;i++){
+		p.ring[i].buf = malloc(VERIFY_CHUNK);
+		if(p.ring[i].buf == NULL){
+			while(i--)
+				free(p.ring[i].buf);
+			munmap((void *)p.image,p.size);
+			return ENOMEM;
+		}
+	}
+	pthread_mutex_init(&p.lock,NULL);
+	pthread_cond_init(&p.cond,NULL);
+
+	sprd_log("Verifying partition:'%s'(size=0x%x) against '%s'\n",part,p.size,image);
+	r = sprd_read_start(part);
+	t0 = verify_now();
+	if(r == 0){
+		r = pthread_create(&th,NULL,verify_worker,&p);
+		if(r == 0){
+			r = verify_read(&p,&read);
+			pthread_mutex_lock(&p.lock);
+			p.done = 1;
+			pthread_cond_broadcast(&p.cond);
+			pthread_mutex_unlock(&p.lock);
+			pthread_join(th,NULL);
+		}
+		r2 = sprd_read_end();
+		if(r == 0)
+			r = r2;
+	}
+	sec = verify_now() - t0;
+	for(i = 0;i < VERIFY_DEPTH;i++)
+		free(p.ring[i].buf);
+	pthread_mutex_destroy(&p.lock);
+	pthread_cond_destroy(&p.cond);
+	munmap((void *)p.image,p.size);
+	if(r != 0)
+		return r;
+
+	sprd_log("%u Bytes in %.2fs(%.2f MB/s)\n",read,sec,sec > 0 ? read / 1e6 / sec : 0.0);
+	if(p.bad == 0){
+		sprd_log("verify:'%s' matches '%s'\n",part,image);
+		return 0;
+	}
+	if(read < p.size)
+		sprd_log("verify:'%s' differs from '%s',stopped at 0x%x:%u ranges,%llu Bytes\n",
+			part,image,read,p.ranges,(unsigned long long)p.bad);
+	else
+		sprd_log("verify:'%s' differs from '%s':%u ranges,%llu Bytes\n",
+			part,image,p.ranges,(unsigned long long)p.bad);
+	return -1;
+}
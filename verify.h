@@ -0,0 +1,21 @@
+#ifndef __VERIFY_H
+#define __VERIFY_H
+
+#include <stdint.h>
+
+/* Partition against image(syber_usb verify,write --verify).
+ * The partition is read back through READ_FLASH_MIDST in chunks of
+ * windows,the usb thread only reads:a worker compares each full chunk
+ * with the mapped image(memcmp a 4k block at a time,the differing bytes
+ * located inside a differing block) while the next chunks are read.
+ * Differing blocks in a row are one range(first to last differing
+ * byte),ranges are listed as they close.With VERIFY_FIRST the reader
+ * stops once the worker has found a difference,within VERIFY_DEPTH
+ * chunks of it. */
+
+#define VERIFY_FIRST 0x01	/* stop at the first mismatch */
+
+/* 0:partition matches the first size of image bytes,-1:mismatch */
+int sprd_verify(const char *part, const char *image, int flags);
+
+#endif /* __VERIFY_H */